@@ -21,8 +21,9 @@
 namespace foleys
 {
 
-AudioFifo::AudioFifo (int size) : audioBuffer (2, size), audioFifo (size)
+AudioFifo::AudioFifo (int size, int numChannels) : audioBuffer (numChannels, size), audioFifo (size)
 {
+    writePointers.resize (size_t (numChannels), nullptr);
 }
 
 void AudioFifo::pushSamples (const juce::AudioBuffer<float>& samples)
@@ -45,7 +46,7 @@ void AudioFifo::pushSamples (const juce::AudioBuffer<float>& samples)
 void AudioFifo::setNumSamples (int samples)
 {
     audioFifo.setTotalSize (samples);
-    audioBuffer.setSize (2, samples);
+    audioBuffer.setSize (audioBuffer.getNumChannels(), samples);
 }
 
 void AudioFifo::pullSamples (const juce::AudioSourceChannelInfo& info)
@@ -59,7 +60,7 @@ void AudioFifo::pullSamples (const juce::AudioSourceChannelInfo& info)
 
     if (ready)
     {
-        for (int channel=0; channel<audioBuffer.getNumChannels(); ++channel)
+        for (int channel=0; channel<info.buffer->getNumChannels(); ++channel)
         {
             const auto sourceChannel = channel % audioBuffer.getNumChannels();
             info.buffer->copyFrom (channel, info.startSample, audioBuffer.getReadPointer (sourceChannel, read.startIndex1), read.blockSize1);
@@ -71,6 +72,24 @@ void AudioFifo::pullSamples (const juce::AudioSourceChannelInfo& info)
     readPosition.fetch_add (read.blockSize1 + read.blockSize2);
 }
 
+float* const* AudioFifo::getWritePointers (int& numSamples)
+{
+    int start1, size1, start2, size2;
+    audioFifo.prepareToWrite (audioFifo.getFreeSpace(), start1, size1, start2, size2);
+
+    for (int c=0; c<audioBuffer.getNumChannels(); ++c)
+        writePointers [size_t (c)] = audioBuffer.getWritePointer (c, start1);
+
+    numSamples = size1;
+    return writePointers.data();
+}
+
+void AudioFifo::finishedWrite (int numSamples)
+{
+    audioFifo.finishedWrite (numSamples);
+    writePosition.fetch_add (numSamples);
+}
+
 void AudioFifo::pushSilence (int numSamples)
 {
     jassert (numSamples  <  audioFifo.getFreeSpace());
@@ -85,7 +104,8 @@ void AudioFifo::pushSilence (int numSamples)
 
 void AudioFifo::skipSamples (int numSamples)
 {
-    audioFifo.read (numSamples);
+    auto read = audioFifo.read (numSamples);
+    readPosition.fetch_add (read.blockSize1 + read.blockSize2);
 }
 
 void AudioFifo::setPosition (const int64_t position)
@@ -115,9 +135,20 @@ int AudioFifo::getAvailableSamples() const
     return audioFifo.getNumReady();
 }
 
+int AudioFifo::getSize() const
+{
+    return audioFifo.getTotalSize();
+}
+
 void AudioFifo::setNumChannels (int numChannels)
 {
     audioBuffer.setSize (numChannels, audioBuffer.getNumSamples());
+    writePointers.resize (size_t (numChannels), nullptr);
+}
+
+int AudioFifo::getNumChannels() const
+{
+    return audioBuffer.getNumChannels();
 }
 
 void AudioFifo::setSampleRate (double sampleRateToUse)
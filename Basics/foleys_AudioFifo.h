@@ -30,12 +30,27 @@ namespace foleys
 class AudioFifo final
 {
 public:
-    AudioFifo (int size = 48000);
+    AudioFifo (int size = 48000, int numChannels = 2);
 
     void pushSamples (const juce::AudioBuffer<float>& samples);
 
+    /**
+     Copies samples into info. If info has more channels than the fifo, the fifo channels
+     are repeated, e.g. a mono stream is played on both channels of a stereo buffer.
+     */
     void pullSamples (const juce::AudioSourceChannelInfo& info);
 
+    /**
+     Returns one pointer per channel to the contiguous free space at the write position, so a
+     converter can write straight into the fifo. numSamples returns the number of samples
+     available there, which can be less than getFreeSpace(), if the space wraps around the end.
+     Call finishedWrite() with the number of samples actually written.
+     */
+    float* const* getWritePointers (int& numSamples);
+
+    /** Advances the write position after writing into the pointers from getWritePointers() */
+    void finishedWrite (int numSamples);
+
     void pushSilence (int numSamples);
 
     void skipSamples (int numSamples);
@@ -51,7 +66,12 @@ public:
     int getFreeSpace() const;
     int getAvailableSamples() const;
 
+    /** Returns the total number of samples the fifo can hold */
+    int getSize() const;
+
     void setNumChannels (int numChannels);
+    int  getNumChannels() const;
+
     void setSampleRate (double sampleRate);
 
     void setNumSamples (int samples);
@@ -64,6 +84,7 @@ private:
 
     juce::AudioBuffer<float> audioBuffer;
     juce::AbstractFifo       audioFifo;
+    std::vector<float*>      writePointers;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (AudioFifo)
 };
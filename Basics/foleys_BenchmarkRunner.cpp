@@ -0,0 +1,518 @@
+/*
+ ==============================================================================
+
+ Copyright (c) 2019 - 2021, Foleys Finest Audio - Daniel Walz
+ All rights reserved.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ ==============================================================================
+ */
+
+#if FOLEYS_ENABLE_BENCHMARKS
+
+namespace foleys
+{
+
+namespace
+{
+    /** A cheap but real processor, so the mixer benchmark includes running a processor chain */
+    class BenchmarkFilter : public juce::AudioProcessor
+    {
+    public:
+        BenchmarkFilter (int numChannels) : filters (size_t (numChannels)) {}
+
+        const juce::String getName() const override { return "Benchmark Filter"; }
+
+        void prepareToPlay (double sampleRate, int) override
+        {
+            for (auto& filter : filters)
+            {
+                filter.setCoefficients (juce::IIRCoefficients::makeLowPass (sampleRate, 5000.0));
+                filter.reset();
+            }
+        }
+
+        void releaseResources() override {}
+
+        void processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer&) override
+        {
+            for (int channel = 0; channel < std::min (buffer.getNumChannels(), int (filters.size())); ++channel)
+                filters [size_t (channel)].processSamples (buffer.getWritePointer (channel), buffer.getNumSamples());
+        }
+
+        double getTailLengthSeconds() const override { return 0.0; }
+        bool acceptsMidi() const override { return false; }
+        bool producesMidi() const override { return false; }
+
+        juce::AudioProcessorEditor* createEditor() override { return nullptr; }
+        bool hasEditor() const override { return false; }
+
+        int getNumPrograms() override { return 1; }
+        int getCurrentProgram() override { return 0; }
+        void setCurrentProgram (int) override {}
+        const juce::String getProgramName (int) override { return {}; }
+        void changeProgramName (int, const juce::String&) override {}
+
+        void getStateInformation (juce::MemoryBlock&) override {}
+        void setStateInformation (const void*, int) override {}
+
+    private:
+        std::vector<juce::IIRFilter> filters;
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (BenchmarkFilter)
+    };
+}
+
+BenchmarkRunner::BenchmarkRunner (VideoEngine& engineToUse)
+  : BenchmarkRunner (engineToUse, Options())
+{
+}
+
+BenchmarkRunner::BenchmarkRunner (VideoEngine& engineToUse, Options optionsToUse)
+  : engine (engineToUse),
+    options (std::move (optionsToUse))
+{
+}
+
+juce::var BenchmarkRunner::runAll()
+{
+    results.clear();
+
+    auto folder = options.workingDirectory == juce::File() ? juce::File::getSpecialLocation (juce::File::tempDirectory)
+                                                           : options.workingDirectory;
+    folder.createDirectory();
+
+    const auto media = folder.getChildFile ("foleys_benchmark_source.mp4");
+
+    const auto start = juce::Time::getMillisecondCounterHiRes();
+    const auto generated = generateMedia (media);
+    addResult ("generate_media", juce::var(), (juce::Time::getMillisecondCounterHiRes() - start) / 1000.0, "s");
+
+    if (generated)
+        benchmarkDecode (media);
+
+    benchmarkVideoFifo();
+    benchmarkCompose();
+    benchmarkAudioMixer();
+    benchmarkColourCurve();
+
+    if (generated)
+        benchmarkExport (media);
+
+    auto* system = new juce::DynamicObject();
+    system->setProperty ("os",      juce::SystemStats::getOperatingSystemName());
+    system->setProperty ("cpu",     juce::SystemStats::getCpuModel());
+    system->setProperty ("numCpus", juce::SystemStats::getNumCpus());
+    system->setProperty ("memory",  juce::SystemStats::getMemorySizeInMegabytes());
+
+    auto* settings = new juce::DynamicObject();
+    settings->setProperty ("frameSize",  options.frameSize.toString());
+    settings->setProperty ("frameRate",  options.frameRate);
+    settings->setProperty ("sampleRate", options.sampleRate);
+    settings->setProperty ("duration",   options.duration);
+    settings->setProperty ("iterations", options.iterations);
+
+    auto* root = new juce::DynamicObject();
+    root->setProperty ("engineVersion", FOLEYS_ENGINE_VERSION);
+    root->setProperty ("juceVersion",   juce::SystemStats::getJUCEVersion());
+    root->setProperty ("date",          juce::Time::getCurrentTime().toISO8601 (true));
+    root->setProperty ("system",        juce::var (system));
+    root->setProperty ("options",       juce::var (settings));
+    root->setProperty ("results",       results);
+
+    return juce::var (root);
+}
+
+bool BenchmarkRunner::writeResults (const juce::var& results, const juce::File& file)
+{
+    return file.replaceWithText (juce::JSON::toString (results));
+}
+
+juce::Image BenchmarkRunner::createTestPattern (Size size, int64_t frameNumber)
+{
+    juce::Image image (juce::Image::ARGB, size.width, size.height, true);
+    juce::Graphics g (image);
+
+    const juce::Colour bars[] = { juce::Colours::white, juce::Colours::yellow, juce::Colours::cyan, juce::Colours::lime,
+                                  juce::Colours::magenta, juce::Colours::red, juce::Colours::blue };
+    const auto numBars = int (std::size (bars));
+    const auto barWidth = float (size.width) / numBars;
+
+    for (int i = 0; i < numBars; ++i)
+    {
+        g.setColour (bars [i]);
+        g.fillRect (i * barWidth, 0.0f, barWidth, size.height * 0.75f);
+    }
+
+    g.setGradientFill (juce::ColourGradient::horizontal (juce::Colours::black, 0.0f, juce::Colours::white, float (size.width)));
+    g.fillRect (0.0f, size.height * 0.75f, float (size.width), size.height * 0.25f);
+
+    g.setColour (juce::Colours::black);
+    g.fillRect (float ((frameNumber * 8) % std::max (1, size.width)), 0.0f, 16.0f, float (size.height));
+
+    g.setColour (juce::Colours::black);
+    g.setFont (size.height * 0.1f);
+    g.drawFittedText (juce::String (frameNumber), 0, 0, size.width, size.height / 2, juce::Justification::centred, 1);
+
+    return image;
+}
+
+bool BenchmarkRunner::generateMedia (const juce::File& file)
+{
+    file.deleteFile();
+
+    auto writer = engine.getFormatManager().createClipWriter (file);
+    if (writer == nullptr || writer->isOpenedOk() == false)
+        return false;
+
+    const auto videoSettings = getVideoSettings();
+    const auto audioSettings = getAudioSettings();
+
+    writer->addVideoStream (videoSettings);
+    writer->addAudioStream (audioSettings);
+
+    if (writer->startWriting() == false)
+        return false;
+
+    const auto numFrames = int64_t (options.duration * options.frameRate);
+    const auto frequency = 440.0 * juce::MathConstants<double>::twoPi / options.sampleRate;
+
+    juce::AudioBuffer<float> buffer (audioSettings.numChannels, audioSettings.defaultNumSamples);
+    int64_t samplePosition = 0;
+
+    for (int64_t frame = 0; frame < numFrames; ++frame)
+    {
+        const auto frameEnd = int64_t ((frame + 1) * options.sampleRate / options.frameRate);
+        while (samplePosition < frameEnd)
+        {
+            for (int i = 0; i < buffer.getNumSamples(); ++i)
+            {
+                const auto sample = float (0.25 * std::sin (frequency * double (samplePosition + i)));
+                for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+                    buffer.setSample (channel, i, sample);
+            }
+
+            writer->pushSamples (buffer);
+            samplePosition += buffer.getNumSamples();
+        }
+
+        writer->pushImage (frame * videoSettings.defaultDuration, createTestPattern (options.frameSize, frame));
+    }
+
+    writer->finishWriting();
+    return file.existsAsFile();
+}
+
+void BenchmarkRunner::benchmarkDecode (const juce::File& media)
+{
+    auto reader = engine.createReaderFor (media);
+    if (reader == nullptr || reader->isOpenedOk() == false || reader->hasVideo() == false)
+        return;
+
+    reader->setOutputSampleRate (options.sampleRate);
+
+    const auto settings = reader->getVideoSettings (0);
+    VideoFifo videoFifo (8);
+    videoFifo.setVideoSettings (settings);
+
+    AudioFifo audioFifo (juce::roundToInt (options.sampleRate));
+    audioFifo.setNumChannels (reader->numChannels);
+    audioFifo.setSampleRate (options.sampleRate);
+
+    // give up, when the reader doesn't produce frames anymore, e.g. at the end of the file
+    const int maxReadsWithoutProgress = 1000;
+
+    int64_t numFrames = 0;
+    int     readsWithoutProgress = 0;
+    auto    lastTime = reader->getLastDecodedVideoTime();
+
+    const auto start = juce::Time::getMillisecondCounterHiRes();
+
+    while (readsWithoutProgress < maxReadsWithoutProgress)
+    {
+        reader->readNewData (videoFifo, audioFifo);
+        audioFifo.setPosition (audioFifo.getWritePosition());
+
+        const auto decoded = reader->getLastDecodedVideoTime();
+        if (decoded != lastTime)
+        {
+            ++numFrames;
+            lastTime = decoded;
+            readsWithoutProgress = 0;
+        }
+        else
+        {
+            ++readsWithoutProgress;
+        }
+    }
+
+    const auto seconds = (juce::Time::getMillisecondCounterHiRes() - start) / 1000.0;
+
+    auto* parameters = new juce::DynamicObject();
+    parameters->setProperty ("frameSize", settings.frameSize.toString());
+    parameters->setProperty ("frames", numFrames);
+
+    addResult ("decode", juce::var (parameters), seconds > 0.0 ? numFrames / seconds : 0.0, "fps");
+}
+
+void BenchmarkRunner::benchmarkVideoFifo()
+{
+    const int numFrames = 30;
+    const int numLookups = options.iterations * 1000;
+
+    const auto settings = getVideoSettings();
+    VideoFifo fifo (numFrames);
+    fifo.setVideoSettings (settings);
+
+    for (int i = 0; i < numFrames - 1; ++i)
+    {
+        auto& frame = fifo.getWritingFrame();
+        frame.timecode = i * settings.defaultDuration;
+        fifo.finishWriting();
+    }
+
+    int64_t checksum = 0;
+    const auto frameDuration = settings.getFrameDurationSeconds();
+    const auto start = juce::Time::getMillisecondCounterHiRes();
+
+    for (int i = 0; i < numLookups; ++i)
+        checksum += fifo.getFrameSeconds ((i % (numFrames - 1)) * frameDuration + frameDuration * 0.5).timecode;
+
+    const auto milliseconds = juce::Time::getMillisecondCounterHiRes() - start;
+
+    auto* parameters = new juce::DynamicObject();
+    parameters->setProperty ("fifoSize", numFrames);
+    parameters->setProperty ("checksum", checksum);
+
+    addResult ("videofifo_lookup", juce::var (parameters), milliseconds * 1.0e6 / numLookups, "ns");
+}
+
+void BenchmarkRunner::benchmarkCompose()
+{
+    const auto pattern = createTestPattern (options.frameSize, 0);
+
+    for (auto numLayers : options.layerCounts)
+    {
+        auto composed = std::make_shared<ComposedClip>(engine);
+        engine.manageLifeTime (composed);
+        composed->prepareToPlay (getAudioSettings().defaultNumSamples, options.sampleRate);
+
+        for (int i = 0; i < numLayers; ++i)
+        {
+            auto image = std::make_shared<ImageClip>(engine);
+            engine.manageLifeTime (image);
+            image->setImage (pattern);
+            composed->addClip (image, { 0.0, options.duration, 0.0 });
+        }
+
+        const auto frameDuration = 1.0 / options.frameRate;
+        const auto start = juce::Time::getMillisecondCounterHiRes();
+
+        for (int i = 0; i < options.iterations; ++i)
+            composed->getFrame (i * frameDuration);
+
+        const auto seconds = (juce::Time::getMillisecondCounterHiRes() - start) / 1000.0;
+
+        auto* parameters = new juce::DynamicObject();
+        parameters->setProperty ("layers", numLayers);
+        parameters->setProperty ("frameSize", options.frameSize.toString());
+
+        addResult ("compose", juce::var (parameters), seconds > 0.0 ? options.iterations / seconds : 0.0, "fps");
+    }
+}
+
+void BenchmarkRunner::benchmarkAudioMixer()
+{
+    const auto audioSettings = getAudioSettings();
+    const auto numBlocks = options.iterations * 10;
+    const auto numSourceSamples = numBlocks * audioSettings.defaultNumSamples;
+
+    // a sine tone in memory, long enough for all blocks, so the clips read real audio without touching the disk
+    juce::MemoryBlock source;
+    {
+        juce::AudioBuffer<float> tone (audioSettings.numChannels, numSourceSamples);
+        const auto frequency = 440.0 * juce::MathConstants<double>::twoPi / options.sampleRate;
+        for (int i = 0; i < numSourceSamples; ++i)
+            for (int channel = 0; channel < tone.getNumChannels(); ++channel)
+                tone.setSample (channel, i, float (0.25 * std::sin (frequency * i)));
+
+        juce::WavAudioFormat format;
+        std::unique_ptr<juce::AudioFormatWriter> writer (format.createWriterFor (new juce::MemoryOutputStream (source, false),
+                                                                                 options.sampleRate, juce::uint32 (audioSettings.numChannels), 16, {}, 0));
+        if (writer == nullptr)
+            return;
+
+        writer->writeFromAudioSampleBuffer (tone, 0, numSourceSamples);
+    }
+
+    const auto length = numSourceSamples / options.sampleRate;
+
+    for (auto numClips : options.clipCounts)
+    {
+        auto composed = std::make_shared<ComposedClip>(engine);
+        engine.manageLifeTime (composed);
+        composed->prepareToPlay (audioSettings.defaultNumSamples, options.sampleRate);
+
+        std::vector<std::shared_ptr<AudioClip>> audioClips;
+        for (int i = 0; i < numClips; ++i)
+        {
+            juce::WavAudioFormat format;
+            auto clip = std::make_shared<AudioClip>(engine);
+            clip->setAudioFormatReader (format.createReaderFor (new juce::MemoryInputStream (source, false), true));
+
+            // offline the samples are read when they are mixed, so no block is mixed from an empty fifo
+            clip->setOfflineMode (true);
+            engine.manageLifeTime (clip);
+            audioClips.push_back (clip);
+
+            auto descriptor = composed->addClip (clip, { 0.0, length, 0.0 });
+            for (int p = 0; p < options.processorsPerClip; ++p)
+                descriptor->addAudioProcessor (std::make_unique<BenchmarkFilter>(audioSettings.numChannels));
+        }
+
+        composed->setNextReadPosition (0);
+
+        DefaultAudioMixer mixer;
+        mixer.setup (audioSettings.numChannels, options.sampleRate, audioSettings.defaultNumSamples);
+
+        juce::AudioBuffer<float> buffer (audioSettings.numChannels, audioSettings.defaultNumSamples);
+        juce::AudioSourceChannelInfo info (&buffer, 0, buffer.getNumSamples());
+        const auto clips = composed->getClips();
+
+        const auto start = juce::Time::getMillisecondCounterHiRes();
+
+        for (int i = 0; i < numBlocks; ++i)
+        {
+            const auto position = int64_t (i) * buffer.getNumSamples();
+            info.clearActiveBufferRegion();
+            mixer.mixAudio (info, position, position / options.sampleRate, clips);
+        }
+
+        const auto milliseconds = juce::Time::getMillisecondCounterHiRes() - start;
+
+        // the readers point into the source, the engine might release the clips later
+        for (auto& clip : audioClips)
+            clip->setAudioFormatReader (nullptr);
+
+        auto* parameters = new juce::DynamicObject();
+        parameters->setProperty ("clips", numClips);
+        parameters->setProperty ("processorsPerClip", options.processorsPerClip);
+        parameters->setProperty ("blockSize", audioSettings.defaultNumSamples);
+
+        addResult ("audio_mixer", juce::var (parameters), milliseconds * 1000.0 / numBlocks, "us_per_block");
+    }
+}
+
+void BenchmarkRunner::benchmarkColourCurve()
+{
+    ColourCurveVideoProcessor processor;
+    for (auto* parameter : processor.getParameters())
+        *parameter->getRawParameterValue() = parameter->unNormaliseValue (0.7);
+
+    const auto settings = getVideoSettings();
+    const auto pattern  = createTestPattern (options.frameSize, 0);
+
+    const auto start = juce::Time::getMillisecondCounterHiRes();
+
+    for (int i = 0; i < options.iterations; ++i)
+    {
+        auto frame = pattern.createCopy();
+        processor.processFrame (frame, i, settings, options.duration);
+    }
+
+    const auto seconds = (juce::Time::getMillisecondCounterHiRes() - start) / 1000.0;
+    const auto megaPixels = double (options.frameSize.width) * options.frameSize.height * options.iterations / 1.0e6;
+
+    auto* parameters = new juce::DynamicObject();
+    parameters->setProperty ("frameSize", options.frameSize.toString());
+
+    addResult ("colour_curve", juce::var (parameters), seconds > 0.0 ? megaPixels / seconds : 0.0, "megapixels_per_s");
+}
+
+void BenchmarkRunner::benchmarkExport (const juce::File& media)
+{
+    auto clip = engine.createClipFromFile (juce::URL (media));
+    if (clip == nullptr)
+        return;
+
+    const auto target = media.getSiblingFile ("foleys_benchmark_export.mp4");
+    target.deleteFile();
+
+    ClipRenderer renderer (engine);
+    renderer.setOutputFile (target);
+    renderer.setClipToRender (clip);
+    renderer.setVideoSettings (getVideoSettings());
+    renderer.setAudioSettings (getAudioSettings());
+
+    juce::WaitableEvent finished;
+    std::atomic<bool>   success { false };
+
+    renderer.onRenderingFinished = [&](bool ok)
+    {
+        success = ok;
+        finished.signal();
+    };
+
+    const auto start = juce::Time::getMillisecondCounterHiRes();
+    renderer.startRendering (true);
+
+    const auto timeout = juce::roundToInt (std::max (60.0, options.duration * 20.0) * 1000.0);
+    if (finished.wait (timeout) == false)
+        renderer.cancelRendering();
+
+    // cancelling is asynchronous, the job still uses the renderer until it returns
+    while (renderer.isRendering())
+        juce::Thread::sleep (10);
+
+    const auto seconds = (juce::Time::getMillisecondCounterHiRes() - start) / 1000.0;
+
+    auto* parameters = new juce::DynamicObject();
+    parameters->setProperty ("duration", options.duration);
+    parameters->setProperty ("success", success.load());
+
+    addResult ("export", juce::var (parameters), seconds > 0.0 ? options.duration / seconds : 0.0, "x_realtime");
+}
+
+void BenchmarkRunner::addResult (const juce::String& name, juce::var parameters, double value, const juce::String& unit)
+{
+    auto* result = new juce::DynamicObject();
+    result->setProperty ("name", name);
+    result->setProperty ("parameters", parameters);
+    result->setProperty ("value", value);
+    result->setProperty ("unit", unit);
+    results.add (juce::var (result));
+
+    FOLEYS_LOG ("Benchmark " << name << ": " << value << " " << unit);
+}
+
+VideoStreamSettings BenchmarkRunner::getVideoSettings() const
+{
+    VideoStreamSettings settings;
+    settings.frameSize = options.frameSize;
+    settings.timebase = juce::roundToInt (options.frameRate * 1000.0);
+    settings.defaultDuration = 1000;
+    return settings;
+}
+
+AudioStreamSettings BenchmarkRunner::getAudioSettings() const
+{
+    AudioStreamSettings settings;
+    settings.numChannels = 2;
+    settings.timebase = juce::roundToInt (options.sampleRate);
+    settings.defaultNumSamples = 1024;
+    return settings;
+}
+
+} // foleys
+
+#endif // FOLEYS_ENABLE_BENCHMARKS
@@ -0,0 +1,101 @@
+/*
+ ==============================================================================
+
+ Copyright (c) 2019 - 2021, Foleys Finest Audio - Daniel Walz
+ All rights reserved.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ ==============================================================================
+ */
+
+#pragma once
+
+#if FOLEYS_ENABLE_BENCHMARKS
+
+namespace foleys
+{
+
+/**
+ @class BenchmarkRunner
+
+ Measures the throughput of the main stages of the engine with synthetic media, so
+ releases can be compared against each other. It doesn't need any GUI, call it from
+ a console application:
+
+ @code
+ juce::ScopedJuceInitialiser_GUI juce;
+ foleys::VideoEngine engine;
+ foleys::BenchmarkRunner runner (engine);
+ runner.writeResults (runner.runAll(), juce::File ("results.json"));
+ @endcode
+
+ The results are a JSON object with the system information and a list of results,
+ each having a name, the parameters, a value and its unit.
+ */
+class BenchmarkRunner
+{
+public:
+    struct Options
+    {
+        Size             frameSize   { 1280, 720 };
+        double           frameRate   = 25.0;
+        double           sampleRate  = 48000.0;
+        double           duration    = 10.0;   /**< Length of the generated media in seconds */
+        int              iterations  = 100;    /**< Number of repetitions for the in-memory benchmarks */
+        std::vector<int> layerCounts { 1, 2, 4, 8 };
+        std::vector<int> clipCounts  { 1, 4, 16, 64 };
+        int              processorsPerClip = 2; /**< Number of audio processors on each clip in the mixer benchmark */
+
+        /** The folder for the generated media, the temp folder if not set */
+        juce::File       workingDirectory;
+    };
+
+    BenchmarkRunner (VideoEngine& engine);
+    BenchmarkRunner (VideoEngine& engine, Options options);
+
+    /** Runs all benchmarks and returns the results. This takes a while, don't call it from the message thread */
+    juce::var runAll();
+
+    /** Writes the results as JSON */
+    static bool writeResults (const juce::var& results, const juce::File& file);
+
+    /** Creates a test pattern similar to FFmpeg's testsrc: colour bars, a moving bar and the frame number */
+    static juce::Image createTestPattern (Size size, int64_t frameNumber);
+
+    /** Generate a video file with the test pattern and a sine tone */
+    bool generateMedia (const juce::File& file);
+
+    void benchmarkDecode (const juce::File& media);
+    void benchmarkVideoFifo();
+    void benchmarkCompose();
+    void benchmarkAudioMixer();
+    void benchmarkColourCurve();
+    void benchmarkExport (const juce::File& media);
+
+private:
+    void addResult (const juce::String& name, juce::var parameters, double value, const juce::String& unit);
+
+    VideoStreamSettings getVideoSettings() const;
+    AudioStreamSettings getAudioSettings() const;
+
+    VideoEngine& engine;
+    Options      options;
+
+    juce::Array<juce::var> results;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (BenchmarkRunner)
+};
+
+} // foleys
+
+#endif // FOLEYS_ENABLE_BENCHMARKS
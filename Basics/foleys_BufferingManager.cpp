@@ -0,0 +1,151 @@
+/*
+ ==============================================================================
+
+ Copyright (c) 2019 - 2021, Foleys Finest Audio - Daniel Walz
+ All rights reserved.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ ==============================================================================
+ */
+
+namespace foleys
+{
+
+BufferingManager::BufferingManager()
+  : memoryLimit (size_t (juce::SystemStats::getMemorySizeInMegabytes()) * 1024 * 1024 / 4)
+{
+    startTimer (100);
+}
+
+BufferingManager::~BufferingManager()
+{
+    stopTimer();
+}
+
+void BufferingManager::addClip (std::shared_ptr<AVClip> clip)
+{
+    juce::ScopedLock sl (clipsLock);
+    clips.push_back (clip);
+}
+
+void BufferingManager::removeClip (AVClip* clip)
+{
+    juce::ScopedLock sl (clipsLock);
+    clips.erase (std::remove_if (clips.begin(), clips.end(), [clip](const auto& candidate)
+    {
+        auto locked = candidate.lock();
+        return locked == nullptr || locked.get() == clip;
+    }), clips.end());
+}
+
+void BufferingManager::setMemoryLimit (size_t bytes)
+{
+    memoryLimit.store (bytes);
+}
+
+size_t BufferingManager::getMemoryLimit() const
+{
+    return memoryLimit.load();
+}
+
+void BufferingManager::setReadAheadTime (ReadAheadState state, double seconds)
+{
+    readAheadTimes [size_t (state)].store (std::max (0.0, seconds));
+}
+
+double BufferingManager::getReadAheadTime (ReadAheadState state) const
+{
+    return readAheadTimes [size_t (state)].load();
+}
+
+size_t BufferingManager::getBufferedBytes() const
+{
+    size_t bytes = 0;
+
+    juce::ScopedLock sl (clipsLock);
+    for (const auto& candidate : clips)
+        if (auto clip = candidate.lock())
+            bytes += clip->getBufferedBytes();
+
+    return bytes;
+}
+
+void BufferingManager::updateBudgets()
+{
+    struct Entry
+    {
+        std::shared_ptr<AVClip> clip;
+        ReadAheadState          state;
+        double                  bytesPerSecond;
+    };
+
+    std::vector<Entry> entries;
+
+    {
+        juce::ScopedLock sl (clipsLock);
+        entries.reserve (clips.size());
+
+        for (auto it = clips.begin(); it != clips.end();)
+        {
+            if (auto clip = it->lock())
+            {
+                entries.push_back ({ clip, clip->getReadAheadState(), double (clip->getReadAheadBytesPerSecond()) });
+                ++it;
+            }
+            else
+            {
+                it = clips.erase (it);
+            }
+        }
+    }
+
+    // serve the playing clips first, then the upcoming, and the idle ones get the rest
+    auto remaining = double (memoryLimit.load());
+
+    for (auto state : { ReadAheadState::Playing, ReadAheadState::Upcoming, ReadAheadState::Idle })
+    {
+        const auto seconds = getReadAheadTime (state);
+
+        double wanted = 0.0;
+        for (const auto& entry : entries)
+            if (entry.state == state)
+                wanted += entry.bytesPerSecond * seconds;
+
+        const auto factor = (wanted > remaining && wanted > 0.0) ? remaining / wanted : 1.0;
+
+        for (auto& entry : entries)
+        {
+            if (entry.state != state)
+                continue;
+
+            ReadAheadBudget budget;
+            budget.seconds  = seconds * factor;
+            budget.maxBytes = entry.bytesPerSecond > 0.0 ? size_t (entry.bytesPerSecond * budget.seconds)
+                                                         : std::numeric_limits<size_t>::max();
+            entry.clip->setReadAheadBudget (budget);
+        }
+
+        remaining = std::max (0.0, remaining - wanted * factor);
+    }
+
+    for (auto& entry : entries)
+        if (entry.state == ReadAheadState::Suspended)
+            entry.clip->setReadAheadBudget ({ 0.0, 0 });
+}
+
+void BufferingManager::timerCallback()
+{
+    updateBudgets();
+}
+
+} // foleys
@@ -0,0 +1,77 @@
+/*
+ ==============================================================================
+
+ Copyright (c) 2019 - 2021, Foleys Finest Audio - Daniel Walz
+ All rights reserved.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ ==============================================================================
+ */
+
+#pragma once
+
+namespace foleys
+{
+
+class AVClip;
+
+/**
+ @class BufferingManager
+
+ The BufferingManager distributes the read ahead memory between all clips managed
+ by the VideoEngine. Each clip gets a ReadAheadBudget in seconds and bytes, depending
+ on its ReadAheadState: clips that are playing are served first, then the clips that
+ are about to start, and the idle clips get what is left. Suspended clips get no budget.
+
+ The sum of all budgets is limited to the memory limit. The budgets are recalculated
+ periodically on the message thread.
+ */
+class BufferingManager  : private juce::Timer
+{
+public:
+    BufferingManager();
+    ~BufferingManager() override;
+
+    /** Add a clip to be supplied with a ReadAheadBudget. This is done by VideoEngine::manageLifeTime() */
+    void addClip (std::shared_ptr<AVClip> clip);
+
+    /** Remove a clip from the budget calculation */
+    void removeClip (AVClip* clip);
+
+    /** Set the total number of bytes all clips together may use for reading ahead */
+    void setMemoryLimit (size_t bytes);
+    size_t getMemoryLimit() const;
+
+    /** Set the time a clip in that state should read ahead, if the memory limit allows */
+    void setReadAheadTime (ReadAheadState state, double seconds);
+    double getReadAheadTime (ReadAheadState state) const;
+
+    /** Returns the number of bytes currently held in the read ahead buffers of all clips */
+    size_t getBufferedBytes() const;
+
+    /** Recalculate the budgets now. This is called periodically, but you can call it to apply changes immediately */
+    void updateBudgets();
+
+private:
+    void timerCallback() override;
+
+    juce::CriticalSection                clipsLock;
+    std::vector<std::weak_ptr<AVClip>>   clips;
+
+    std::atomic<size_t> memoryLimit;
+    std::atomic<double> readAheadTimes[4] { {1.0}, {0.5}, {0.1}, {0.0} };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (BufferingManager)
+};
+
+} // foleys
@@ -0,0 +1,297 @@
+/*
+ ==============================================================================
+
+ Copyright (c) 2019 - 2021, Foleys Finest Audio - Daniel Walz
+ All rights reserved.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ ==============================================================================
+ */
+
+namespace foleys
+{
+
+namespace
+{
+    thread_local PerformanceCounters* currentCounters = nullptr;
+
+    int getBucket (uint64_t micros)
+    {
+        int bucket = 0;
+        while (micros > 0 && bucket < StageStatistics::numBuckets - 1)
+        {
+            micros >>= 1;
+            ++bucket;
+        }
+        return bucket;
+    }
+}
+
+const char* getPerformanceStageName (PerformanceStage stage)
+{
+    switch (stage)
+    {
+        case PerformanceStage::Demux:       return "demux";
+        case PerformanceStage::Decode:      return "decode";
+        case PerformanceStage::Conversion:  return "conversion";
+        case PerformanceStage::Processors:  return "processors";
+        case PerformanceStage::Compose:     return "compose";
+        case PerformanceStage::Encode:      return "encode";
+        case PerformanceStage::Wait:        return "wait";
+        case PerformanceStage::NumStages:
+        default: break;
+    }
+
+    return "unknown";
+}
+
+double StageStatistics::getPercentileMilliseconds (double percentile) const
+{
+    const auto target = uint64_t (std::ceil (juce::jlimit (0.0, 1.0, percentile) * double (count)));
+    uint64_t sum = 0;
+
+    for (int i = 0; i < numBuckets; ++i)
+    {
+        sum += histogram [size_t (i)];
+        if (sum >= target && sum > 0)
+            return double (uint64_t (1) << i) / 1000.0;
+    }
+
+    return maxMilliseconds;
+}
+
+StageStatistics& StageStatistics::operator+= (const StageStatistics& other)
+{
+    count += other.count;
+    totalMilliseconds += other.totalMilliseconds;
+    maxMilliseconds = std::max (maxMilliseconds, other.maxMilliseconds);
+
+    for (size_t i = 0; i < histogram.size(); ++i)
+        histogram [i] += other.histogram [i];
+
+    return *this;
+}
+
+//==============================================================================
+
+TraceBuffer::TraceBuffer (size_t numEvents)
+  : events (std::max (size_t (1), numEvents))
+{
+}
+
+void TraceBuffer::add (PerformanceStage stage, int sourceId, double start, double duration)
+{
+    if (! enabled.load())
+        return;
+
+    auto& event = events [size_t (writeIndex.fetch_add (1) % events.size())];
+    event.stage    = stage;
+    event.sourceId = sourceId;
+    event.threadId = juce::Thread::getCurrentThreadId();
+    event.start    = start;
+    event.duration = duration;
+}
+
+std::vector<TraceBuffer::Event> TraceBuffer::getEvents() const
+{
+    const auto end   = writeIndex.load();
+    const auto begin = end > events.size() ? end - events.size() : 0;
+
+    std::vector<Event> copy;
+    copy.reserve (size_t (end - begin));
+
+    for (auto i = begin; i < end; ++i)
+        copy.push_back (events [size_t (i % events.size())]);
+
+    return copy;
+}
+
+void TraceBuffer::clear()
+{
+    writeIndex.store (0);
+}
+
+//==============================================================================
+
+PerformanceCounters::PerformanceCounters (int sourceIdToUse, const juce::String& nameToUse, std::shared_ptr<TraceBuffer> traceToUse)
+  : sourceId (sourceIdToUse),
+    trace (std::move (traceToUse)),
+    name (nameToUse)
+{
+}
+
+void PerformanceCounters::add (PerformanceStage stage, double startMilliseconds, double durationMilliseconds)
+{
+    auto& counter = counters [size_t (stage)];
+    const auto micros = uint64_t (std::max (0.0, durationMilliseconds * 1000.0));
+
+    counter.count.fetch_add (1, std::memory_order_relaxed);
+    counter.totalMicros.fetch_add (micros, std::memory_order_relaxed);
+    counter.histogram [getBucket (micros)].fetch_add (1, std::memory_order_relaxed);
+
+    auto previousMax = counter.maxMicros.load (std::memory_order_relaxed);
+    while (micros > previousMax && ! counter.maxMicros.compare_exchange_weak (previousMax, micros, std::memory_order_relaxed))
+        ;
+
+    if (trace)
+        trace->add (stage, sourceId, startMilliseconds, durationMilliseconds);
+}
+
+StageStatistics PerformanceCounters::getStatistics (PerformanceStage stage) const
+{
+    const auto& counter = counters [size_t (stage)];
+
+    StageStatistics statistics;
+    statistics.count = counter.count.load();
+    statistics.totalMilliseconds = double (counter.totalMicros.load()) / 1000.0;
+    statistics.maxMilliseconds   = double (counter.maxMicros.load()) / 1000.0;
+
+    for (size_t i = 0; i < statistics.histogram.size(); ++i)
+        statistics.histogram [i] = counter.histogram [i].load();
+
+    return statistics;
+}
+
+void PerformanceCounters::reset()
+{
+    for (auto& counter : counters)
+    {
+        counter.count = 0;
+        counter.totalMicros = 0;
+        counter.maxMicros = 0;
+
+        for (auto& bucket : counter.histogram)
+            bucket = 0;
+    }
+}
+
+void PerformanceCounters::setName (const juce::String& nameToUse)
+{
+    juce::ScopedLock sl (nameLock);
+    name = nameToUse;
+}
+
+juce::String PerformanceCounters::getName() const
+{
+    juce::ScopedLock sl (nameLock);
+    return name;
+}
+
+PerformanceCounters* PerformanceCounters::getCurrent()
+{
+    return currentCounters;
+}
+
+PerformanceCounters::ScopedSource::ScopedSource (PerformanceCounters* counters)
+  : previous (currentCounters)
+{
+    currentCounters = counters;
+}
+
+PerformanceCounters::ScopedSource::~ScopedSource()
+{
+    currentCounters = previous;
+}
+
+//==============================================================================
+
+PerformanceMonitor::PerformanceMonitor()
+  : trace (std::make_shared<TraceBuffer>())
+{
+}
+
+std::shared_ptr<PerformanceCounters> PerformanceMonitor::createCounters (const juce::String& name)
+{
+    juce::ScopedLock sl (countersLock);
+
+    counters.erase (std::remove_if (counters.begin(), counters.end(), [](const auto& candidate) { return candidate.expired(); }),
+                    counters.end());
+
+    auto newCounters = std::make_shared<PerformanceCounters>(nextSourceId++, name, trace);
+    counters.push_back (newCounters);
+    return newCounters;
+}
+
+std::vector<std::shared_ptr<PerformanceCounters>> PerformanceMonitor::getCounters() const
+{
+    std::vector<std::shared_ptr<PerformanceCounters>> alive;
+
+    juce::ScopedLock sl (countersLock);
+    for (const auto& candidate : counters)
+        if (auto locked = candidate.lock())
+            alive.push_back (locked);
+
+    return alive;
+}
+
+StageStatistics PerformanceMonitor::getTotalStatistics (PerformanceStage stage) const
+{
+    StageStatistics total;
+    for (const auto& source : getCounters())
+        total += source->getStatistics (stage);
+
+    return total;
+}
+
+void PerformanceMonitor::reset()
+{
+    for (const auto& source : getCounters())
+        source->reset();
+
+    trace->clear();
+}
+
+void PerformanceMonitor::setTracingEnabled (bool shouldTrace)
+{
+    trace->setEnabled (shouldTrace);
+}
+
+bool PerformanceMonitor::isTracingEnabled() const
+{
+    return trace->isEnabled();
+}
+
+juce::String PerformanceMonitor::createChromeTrace() const
+{
+    std::map<int, juce::String> names;
+    for (const auto& source : getCounters())
+        names [source->getSourceId()] = source->getName();
+
+    juce::Array<juce::var> traceEvents;
+
+    for (const auto& event : trace->getEvents())
+    {
+        auto* object = new juce::DynamicObject();
+        object->setProperty ("name", getPerformanceStageName (event.stage));
+        object->setProperty ("cat",  names.count (event.sourceId) > 0 ? names [event.sourceId] : "Clip #" + juce::String (event.sourceId));
+        object->setProperty ("ph",   "X");
+        object->setProperty ("ts",   event.start * 1000.0);
+        object->setProperty ("dur",  event.duration * 1000.0);
+        object->setProperty ("pid",  1);
+        object->setProperty ("tid",  int (juce::pointer_sized_int (event.threadId) & 0x7fffffff));
+        traceEvents.add (juce::var (object));
+    }
+
+    auto* root = new juce::DynamicObject();
+    root->setProperty ("traceEvents", traceEvents);
+    root->setProperty ("displayTimeUnit", "ms");
+
+    return juce::JSON::toString (juce::var (root));
+}
+
+bool PerformanceMonitor::writeChromeTrace (const juce::File& file) const
+{
+    return file.replaceWithText (createChromeTrace());
+}
+
+} // foleys
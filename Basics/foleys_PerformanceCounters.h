@@ -0,0 +1,233 @@
+/*
+ ==============================================================================
+
+ Copyright (c) 2019 - 2021, Foleys Finest Audio - Daniel Walz
+ All rights reserved.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ ==============================================================================
+ */
+
+#pragma once
+
+namespace foleys
+{
+
+/** The stages of the engine, that are measured by the PerformanceCounters */
+enum class PerformanceStage
+{
+    Demux = 0,      /**< Reading packets from the container */
+    Decode,         /**< Decoding audio and video packets */
+    Conversion,     /**< Pixel format conversion (sws_scale) and resampling */
+    Processors,     /**< Audio and video processors of a clip */
+    Compose,        /**< Mixing and compositing in a ComposedClip, this includes the processors of the clips */
+    Encode,         /**< Encoding and writing packets */
+    Wait,           /**< Waiting for a clip to have data available */
+    NumStages
+};
+
+/** Returns a short name of the stage, e.g. for the trace export */
+const char* getPerformanceStageName (PerformanceStage stage);
+
+/** A copy of the counters of a single stage */
+struct StageStatistics
+{
+    static constexpr int numBuckets = 24;
+
+    uint64_t count = 0;
+    double   totalMilliseconds = 0.0;
+    double   maxMilliseconds = 0.0;
+
+    /** Bucket i counts the measurements between 2^(i-1) and 2^i microseconds */
+    std::array<uint64_t, numBuckets> histogram {};
+
+    double getAverageMilliseconds() const { return count > 0 ? totalMilliseconds / double (count) : 0.0; }
+
+    /** Returns the upper bound in milliseconds of the histogram bucket, that contains the percentile (0..1) */
+    double getPercentileMilliseconds (double percentile) const;
+
+    StageStatistics& operator+= (const StageStatistics& other);
+};
+
+/** A fixed size ring buffer of timed events, that can be exported as Chrome trace JSON */
+class TraceBuffer
+{
+public:
+    struct Event
+    {
+        PerformanceStage       stage    = PerformanceStage::Demux;
+        int                    sourceId = 0;
+        juce::Thread::ThreadID threadId = nullptr;
+        double                 start    = 0.0;
+        double                 duration = 0.0;
+    };
+
+    TraceBuffer (size_t numEvents = 65536);
+
+    void setEnabled (bool shouldRecord) { enabled.store (shouldRecord); }
+    bool isEnabled() const              { return enabled.load(); }
+
+    void add (PerformanceStage stage, int sourceId, double start, double duration);
+
+    /** Returns the recorded events in order. Events written while copying may be garbled, so
+        preferrably stop recording before reading them */
+    std::vector<Event> getEvents() const;
+
+    void clear();
+
+private:
+    std::vector<Event>    events;
+    std::atomic<uint64_t> writeIndex { 0 };
+    std::atomic<bool>     enabled    { false };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (TraceBuffer)
+};
+
+/**
+ @class PerformanceCounters
+
+ Counts the time spent in each PerformanceStage for a single source, usually a clip.
+ All counters are lock-free atomics, so they can be updated from any thread, including
+ the audio thread.
+
+ The code being measured doesn't need to know the clip: the ScopedSource sets the counters
+ for the current thread, and FOLEYS_MEASURE_STAGE adds the time to those counters.
+ */
+class PerformanceCounters
+{
+public:
+    PerformanceCounters (int sourceId, const juce::String& name, std::shared_ptr<TraceBuffer> trace);
+
+    void add (PerformanceStage stage, double startMilliseconds, double durationMilliseconds);
+
+    StageStatistics getStatistics (PerformanceStage stage) const;
+
+    void reset();
+
+    int getSourceId() const { return sourceId; }
+
+    void setName (const juce::String& name);
+    juce::String getName() const;
+
+    /** Returns the counters set for the current thread, or nullptr */
+    static PerformanceCounters* getCurrent();
+
+    /** Sets the counters to be used by FOLEYS_MEASURE_STAGE on this thread while this object exists */
+    class ScopedSource
+    {
+    public:
+        ScopedSource (PerformanceCounters* counters);
+        ~ScopedSource();
+    private:
+        PerformanceCounters* previous = nullptr;
+        JUCE_DECLARE_NON_COPYABLE (ScopedSource)
+    };
+
+private:
+    struct Counter
+    {
+        std::atomic<uint64_t> count        { 0 };
+        std::atomic<uint64_t> totalMicros  { 0 };
+        std::atomic<uint64_t> maxMicros    { 0 };
+        std::atomic<uint64_t> histogram [StageStatistics::numBuckets] {};
+    };
+
+    const int                    sourceId;
+    std::shared_ptr<TraceBuffer> trace;
+
+    juce::CriticalSection nameLock;
+    juce::String          name;
+
+    Counter counters [size_t (PerformanceStage::NumStages)];
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PerformanceCounters)
+};
+
+/** Measures the time until the end of the scope and adds it to the current thread's PerformanceCounters */
+class ScopedStageTimer
+{
+public:
+    ScopedStageTimer (PerformanceStage stageToMeasure)
+      : counters (PerformanceCounters::getCurrent()),
+        stage (stageToMeasure),
+        start (counters != nullptr ? juce::Time::getMillisecondCounterHiRes() : 0.0)
+    {
+    }
+
+    ~ScopedStageTimer()
+    {
+        if (counters != nullptr)
+            counters->add (stage, start, juce::Time::getMillisecondCounterHiRes() - start);
+    }
+
+private:
+    PerformanceCounters*   counters = nullptr;
+    const PerformanceStage stage;
+    const double           start;
+
+    JUCE_DECLARE_NON_COPYABLE (ScopedStageTimer)
+};
+
+/**
+ @class PerformanceMonitor
+
+ The PerformanceMonitor of the VideoEngine creates the PerformanceCounters for each clip
+ and allows to query them, or to export the recorded trace to be viewed in chrome://tracing
+ or Perfetto.
+ */
+class PerformanceMonitor
+{
+public:
+    PerformanceMonitor();
+
+    /** Creates counters for a new source. This is done by VideoEngine::manageLifeTime() */
+    std::shared_ptr<PerformanceCounters> createCounters (const juce::String& name);
+
+    /** Returns the counters of all sources, that are still alive */
+    std::vector<std::shared_ptr<PerformanceCounters>> getCounters() const;
+
+    /** Returns the statistics of one stage summed over all sources */
+    StageStatistics getTotalStatistics (PerformanceStage stage) const;
+
+    /** Reset all counters and clear the trace */
+    void reset();
+
+    /** Switch recording the individual events for the trace export. The counters are always active */
+    void setTracingEnabled (bool shouldTrace);
+    bool isTracingEnabled() const;
+
+    /** Returns the recorded events in Chrome trace event format */
+    juce::String createChromeTrace() const;
+
+    /** Writes the recorded events in Chrome trace event format */
+    bool writeChromeTrace (const juce::File& file) const;
+
+private:
+    std::shared_ptr<TraceBuffer> trace;
+
+    juce::CriticalSection                           countersLock;
+    std::vector<std::weak_ptr<PerformanceCounters>> counters;
+    int                                             nextSourceId = 1;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PerformanceMonitor)
+};
+
+} // foleys
+
+#if FOLEYS_ENABLE_PROFILING
+#define FOLEYS_MEASURE_STAGE(stage)  const foleys::ScopedStageTimer JUCE_JOIN_MACRO (foleysStageTimer_, __LINE__) (foleys::PerformanceStage::stage)
+#define FOLEYS_PERFORMANCE_SOURCE(counters)  const foleys::PerformanceCounters::ScopedSource JUCE_JOIN_MACRO (foleysPerformanceSource_, __LINE__) (counters)
+#else
+#define FOLEYS_MEASURE_STAGE(stage)
+#define FOLEYS_PERFORMANCE_SOURCE(counters)
+#endif
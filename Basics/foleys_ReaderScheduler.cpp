@@ -0,0 +1,203 @@
+/*
+ ==============================================================================
+
+ Copyright (c) 2019 - 2021, Foleys Finest Audio - Daniel Walz
+ All rights reserved.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ ==============================================================================
+ */
+
+namespace foleys
+{
+
+ReaderScheduler::ReaderScheduler (int numWorkers)
+{
+    for (int i = 0; i < std::max (1, numWorkers); ++i)
+        workers.push_back (std::make_unique<Worker>(*this, i));
+
+    for (auto& worker : workers)
+        worker->startThread();
+}
+
+ReaderScheduler::~ReaderScheduler()
+{
+    for (auto& worker : workers)
+        worker->signalThreadShouldExit();
+
+    for (auto& worker : workers)
+    {
+        worker->wakeUp.signal();
+        worker->stopThread (500);
+    }
+}
+
+void ReaderScheduler::addJob (juce::TimeSliceClient* job, AVClip* clip)
+{
+    if (job == nullptr)
+        return;
+
+    auto* target = workers.front().get();
+    auto  minDepth = std::numeric_limits<size_t>::max();
+
+    for (auto& worker : workers)
+    {
+        juce::ScopedLock sl (worker->queueLock);
+        if (worker->queue.size() < minDepth)
+        {
+            minDepth = worker->queue.size();
+            target = worker.get();
+        }
+    }
+
+    {
+        juce::ScopedLock sl (target->queueLock);
+        target->queue.push_back ({ job, clip, juce::Time::getMillisecondCounterHiRes() });
+    }
+
+    target->wakeUp.signal();
+}
+
+void ReaderScheduler::removeJob (juce::TimeSliceClient* job)
+{
+    // holding all callback locks makes sure no worker is executing or moving the job.
+    // Workers only ever hold their own callback lock, so locking in order can't deadlock
+    std::vector<std::unique_ptr<juce::ScopedLock>> callbackLocks;
+    for (auto& worker : workers)
+        callbackLocks.push_back (std::make_unique<juce::ScopedLock>(worker->callbackLock));
+
+    for (auto& worker : workers)
+    {
+        juce::ScopedLock sl (worker->queueLock);
+        worker->queue.erase (std::remove_if (worker->queue.begin(), worker->queue.end(),
+                                             [job](const auto& entry) { return entry.job == job; }),
+                             worker->queue.end());
+    }
+}
+
+ReaderScheduler::Metrics ReaderScheduler::getMetrics() const
+{
+    Metrics metrics;
+    metrics.numWorkers  = int (workers.size());
+    metrics.numExecuted = numExecuted.load();
+    metrics.numStolen   = numStolen.load();
+
+    const auto now = juce::Time::getMillisecondCounterHiRes();
+
+    for (auto& worker : workers)
+    {
+        juce::ScopedLock sl (worker->queueLock);
+        metrics.queueDepths.push_back (int (worker->queue.size()));
+        metrics.numJobs += int (worker->queue.size());
+        metrics.numDueJobs += int (std::count_if (worker->queue.begin(), worker->queue.end(),
+                                                  [now](const auto& entry) { return entry.nextCallTime <= now; }));
+    }
+
+    return metrics;
+}
+
+int ReaderScheduler::getNumWorkers() const
+{
+    return int (workers.size());
+}
+
+bool ReaderScheduler::popMostUrgentJob (Worker& worker, Entry& entry, double now, double& waitTime)
+{
+    juce::ScopedLock sl (worker.queueLock);
+
+    auto best = worker.queue.end();
+    auto bestDeadline = std::numeric_limits<double>::max();
+
+    for (auto it = worker.queue.begin(); it != worker.queue.end(); ++it)
+    {
+        if (it->nextCallTime > now)
+        {
+            waitTime = std::min (waitTime, it->nextCallTime - now);
+            continue;
+        }
+
+        const auto deadline = it->clip != nullptr ? it->clip->getSecondsToDeadline() : std::numeric_limits<double>::max();
+        if (best == worker.queue.end() || deadline < bestDeadline)
+        {
+            best = it;
+            bestDeadline = deadline;
+        }
+    }
+
+    if (best == worker.queue.end())
+        return false;
+
+    entry = *best;
+    worker.queue.erase (best);
+    return true;
+}
+
+//==============================================================================
+
+ReaderScheduler::Worker::Worker (ReaderScheduler& ownerToUse, int indexToUse)
+  : juce::Thread ("Reading Thread #" + juce::String (indexToUse)),
+    owner (ownerToUse),
+    index (indexToUse)
+{
+}
+
+void ReaderScheduler::Worker::run()
+{
+    // how long an idle worker waits before it looks for work to steal
+    const double maxWaitTime = 20.0;
+
+    while (! threadShouldExit())
+    {
+        auto waitTime = maxWaitTime;
+
+        {
+            juce::ScopedLock cl (callbackLock);
+
+            const auto now = juce::Time::getMillisecondCounterHiRes();
+            Entry entry;
+            auto found = owner.popMostUrgentJob (*this, entry, now, waitTime);
+
+            if (! found)
+            {
+                const auto numWorkers = int (owner.workers.size());
+                for (int i = 1; i < numWorkers && ! found; ++i)
+                {
+                    auto ignored = maxWaitTime;
+                    found = owner.popMostUrgentJob (*owner.workers [size_t ((index + i) % numWorkers)], entry, now, ignored);
+                    if (found)
+                        ++owner.numStolen;
+                }
+            }
+
+            if (found)
+            {
+                const auto msUntilNextCall = entry.job->useTimeSlice();
+                ++owner.numExecuted;
+
+                if (msUntilNextCall >= 0)
+                {
+                    entry.nextCallTime = juce::Time::getMillisecondCounterHiRes() + msUntilNextCall;
+
+                    juce::ScopedLock sl (queueLock);
+                    queue.push_back (entry);
+                }
+
+                continue;
+            }
+        }
+
+        wakeUp.wait (juce::jlimit (1, int (maxWaitTime), int (waitTime)));
+    }
+}
+
+} // foleys
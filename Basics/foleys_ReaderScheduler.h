@@ -0,0 +1,109 @@
+/*
+ ==============================================================================
+
+ Copyright (c) 2019 - 2021, Foleys Finest Audio - Daniel Walz
+ All rights reserved.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ ==============================================================================
+ */
+
+#pragma once
+
+namespace foleys
+{
+
+class AVClip;
+
+/**
+ @class ReaderScheduler
+
+ The ReaderScheduler runs the background reading jobs of the clips on a pool of
+ worker threads. Each worker has its own queue, but a worker that runs out of due
+ jobs steals from the other workers, so an expensive clip doesn't block the cheap
+ clips that happen to share its thread.
+
+ When several jobs are due, the one with the earliest deadline runs first. The deadline
+ is the time until the clip runs out of buffered data, see AVClip::getSecondsToDeadline().
+
+ The jobs are juce::TimeSliceClients: the return value of useTimeSlice() is the time in
+ milliseconds until the job wants to be called again, a negative value removes the job.
+ */
+class ReaderScheduler
+{
+public:
+    /** Snapshot of the scheduler's state, e.g. to display in a performance monitor */
+    struct Metrics
+    {
+        int              numWorkers  = 0;
+        int              numJobs     = 0;
+        int              numDueJobs  = 0;    /**< Jobs waiting to be executed right now */
+        std::vector<int> queueDepths;        /**< Number of jobs in each worker's queue */
+        int64_t          numExecuted = 0;
+        int64_t          numStolen   = 0;
+    };
+
+    ReaderScheduler (int numWorkers);
+    ~ReaderScheduler();
+
+    /** Add a job to the worker with the shortest queue.
+        @param job the job to be called
+        @param clip the clip the job reads for, used to get the deadline. Can be nullptr */
+    void addJob (juce::TimeSliceClient* job, AVClip* clip = nullptr);
+
+    /** Remove the job. When this returns, the job is not executed and won't be called again */
+    void removeJob (juce::TimeSliceClient* job);
+
+    Metrics getMetrics() const;
+
+    int getNumWorkers() const;
+
+private:
+    struct Entry
+    {
+        juce::TimeSliceClient* job  = nullptr;
+        AVClip*                clip = nullptr;
+        double                 nextCallTime = 0.0;
+    };
+
+    class Worker : public juce::Thread
+    {
+    public:
+        Worker (ReaderScheduler& owner, int index);
+        void run() override;
+
+        juce::CriticalSection callbackLock;
+        juce::CriticalSection queueLock;
+        std::vector<Entry>    queue;
+        juce::WaitableEvent   wakeUp;
+
+    private:
+        ReaderScheduler& owner;
+        const int        index;
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (Worker)
+    };
+
+    /** Removes and returns the most urgent due job from the worker's queue.
+        @param waitTime is reduced to the time until the next job in this queue is due */
+    bool popMostUrgentJob (Worker& worker, Entry& entry, double now, double& waitTime);
+
+    std::vector<std::unique_ptr<Worker>> workers;
+
+    std::atomic<int64_t> numExecuted { 0 };
+    std::atomic<int64_t> numStolen   { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ReaderScheduler)
+};
+
+} // foleys
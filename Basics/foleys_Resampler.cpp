@@ -0,0 +1,206 @@
+/*
+ ==============================================================================
+
+ Copyright (c) 2019 - 2021, Foleys Finest Audio - Daniel Walz
+ All rights reserved.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ ==============================================================================
+ */
+
+namespace foleys
+{
+
+namespace
+{
+    int getNumTaps (Resampler::Quality quality)
+    {
+        switch (quality)
+        {
+            case Resampler::Quality::Draft:  return 8;
+            case Resampler::Quality::Normal: return 16;
+            case Resampler::Quality::Best:   return 64;
+            case Resampler::Quality::High:
+            default: break;
+        }
+
+        return 32;
+    }
+}
+
+Resampler::Resampler (Quality qualityToUse)
+  : quality (qualityToUse),
+    numTaps (getNumTaps (qualityToUse))
+{
+}
+
+void Resampler::prepare (int numChannelsToUse, double ratioToUse)
+{
+    jassert (numChannelsToUse > 0 && ratioToUse > 0.0);
+
+    numChannels = numChannelsToUse;
+    ratio = ratioToUse;
+
+    createFilterTable();
+
+    input.setSize (numChannels, 4096);
+    inputPointers.resize (size_t (numChannels), nullptr);
+    kernel.resize (size_t (numTaps));
+
+    reset();
+}
+
+void Resampler::createFilterTable()
+{
+    numTaps = getNumTaps (quality);
+
+    const auto half   = numTaps / 2;
+    const auto cutoff = 0.97 * std::min (1.0, 1.0 / ratio);
+
+    coefficients.resize (size_t ((numPhases + 1) * numTaps));
+    deltas.resize (size_t (numPhases * numTaps));
+
+    for (int phase = 0; phase <= numPhases; ++phase)
+    {
+        auto* row = coefficients.data() + phase * numTaps;
+        const auto fraction = phase / double (numPhases);
+        double sum = 0.0;
+
+        for (int tap = 0; tap < numTaps; ++tap)
+        {
+            // distance of the input sample to the output position
+            const auto x = (tap - half + 1) - fraction;
+            const auto t = x / half;
+
+            if (std::abs (t) >= 1.0)
+            {
+                row [tap] = 0.0f;
+                continue;
+            }
+
+            const auto window = 0.42 + 0.5 * std::cos (juce::MathConstants<double>::pi * t)
+                                     + 0.08 * std::cos (juce::MathConstants<double>::twoPi * t);
+            const auto arg = juce::MathConstants<double>::pi * cutoff * x;
+            const auto sinc = (x == 0.0) ? 1.0 : std::sin (arg) / arg;
+
+            row [tap] = float (cutoff * sinc * window);
+            sum += row [tap];
+        }
+
+        // unity gain for DC in every phase
+        if (sum > 0.0)
+            juce::FloatVectorOperations::multiply (row, float (1.0 / sum), numTaps);
+    }
+
+    for (int phase = 0; phase < numPhases; ++phase)
+        juce::FloatVectorOperations::subtract (deltas.data() + phase * numTaps,
+                                               coefficients.data() + (phase + 1) * numTaps,
+                                               coefficients.data() + phase * numTaps,
+                                               numTaps);
+}
+
+void Resampler::reset (double fractionalOffset)
+{
+    numInput = 0;
+    position = getHistorySize() + fractionalOffset;
+}
+
+int Resampler::getHistorySize() const
+{
+    return numTaps / 2 - 1;
+}
+
+int Resampler::getNumInputSamplesNeeded (int numOutput) const
+{
+    if (numOutput <= 0)
+        return 0;
+
+    // one extra sample to cover rounding of the accumulated position
+    const auto lastIndex = int (position + (numOutput - 1) * ratio);
+    return std::max (lastIndex + numTaps / 2 + 2 - numInput, 0);
+}
+
+float* const* Resampler::getInputWritePointers (int numSamples)
+{
+    if (input.getNumSamples() < numInput + numSamples)
+        input.setSize (numChannels, numInput + numSamples, true, false, true);
+
+    for (int c = 0; c < numChannels; ++c)
+        inputPointers [size_t (c)] = input.getWritePointer (c) + numInput;
+
+    return inputPointers.data();
+}
+
+void Resampler::finishedInput (int numSamples)
+{
+    jassert (numInput + numSamples <= input.getNumSamples());
+    numInput += numSamples;
+}
+
+int Resampler::process (juce::AudioBuffer<float>& output, int startSample, int numSamples)
+{
+    if (numChannels == 0)
+    {
+        output.clear (startSample, numSamples);
+        return 0;
+    }
+
+    const auto half = numTaps / 2;
+    const auto numProcessed = std::min (numChannels, output.getNumChannels());
+    int produced = 0;
+
+    while (produced < numSamples)
+    {
+        const auto index = int (position);
+        if (index + half >= numInput)
+            break;
+
+        const auto phase = (position - index) * numPhases;
+        const auto row   = std::min (int (phase), numPhases - 1);
+        const auto alpha = float (phase - row);
+
+        juce::FloatVectorOperations::copy (kernel.data(), coefficients.data() + row * numTaps, numTaps);
+        juce::FloatVectorOperations::addWithMultiply (kernel.data(), deltas.data() + row * numTaps, alpha, numTaps);
+
+        for (int c = 0; c < numProcessed; ++c)
+            output.setSample (c, startSample + produced,
+                              VectorMath::dotProduct (input.getReadPointer (c, index - half + 1), kernel.data(), numTaps));
+
+        position += ratio;
+        ++produced;
+    }
+
+    for (int c = numProcessed; c < output.getNumChannels(); ++c)
+        output.copyFrom (c, startSample, output, c % numProcessed, startSample, produced);
+
+    if (produced < numSamples)
+        output.clear (startSample + produced, numSamples - produced);
+
+    // drop the input, that is no longer needed as history
+    const auto consumed = std::min (int (position) - getHistorySize(), numInput);
+    if (consumed > 0)
+    {
+        for (int c = 0; c < numChannels; ++c)
+        {
+            auto* data = input.getWritePointer (c);
+            std::memmove (data, data + consumed, size_t (numInput - consumed) * sizeof (float));
+        }
+
+        numInput -= consumed;
+        position -= consumed;
+    }
+
+    return produced;
+}
+
+} // foleys
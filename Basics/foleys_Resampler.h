@@ -0,0 +1,102 @@
+/*
+ ==============================================================================
+
+ Copyright (c) 2019 - 2021, Foleys Finest Audio - Daniel Walz
+ All rights reserved.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ ==============================================================================
+ */
+
+#pragma once
+
+namespace foleys
+{
+
+/**
+ A polyphase windowed sinc resampler for any ratio. The quality sets the length of
+ the filter and with that the CPU cost. Adjacent phases of the filter table are
+ interpolated, so the ratio doesn't need to be a fraction of small numbers.
+
+ The input is appended with getInputWritePointers() and finishedInput(), so a reader
+ can decode straight into the resampler.
+ */
+class Resampler final
+{
+public:
+    enum class Quality
+    {
+        Draft = 0,  /**< 8 taps, for previews and scrubbing */
+        Normal,     /**< 16 taps */
+        High,       /**< 32 taps, the default */
+        Best        /**< 64 taps, for the final render */
+    };
+
+    Resampler (Quality quality = Quality::High);
+
+    /** Prepares the filter. The ratio is the input sample rate divided by the output sample rate */
+    void prepare (int numChannels, double ratio);
+
+    /**
+     Clears the input. The first getHistorySize() input samples are only used as history for
+     the filter, the first output sample is aligned to the sample after that, plus the
+     fractional offset.
+     */
+    void reset (double fractionalOffset = 0.0);
+
+    /** The number of input samples before the position of the first output sample */
+    int getHistorySize() const;
+
+    /** Returns the number of input samples, that need to be appended to produce numOutput samples */
+    int getNumInputSamplesNeeded (int numOutput) const;
+
+    /** Returns one pointer per channel to append numSamples of input. Call finishedInput() afterwards */
+    float* const* getInputWritePointers (int numSamples);
+
+    /** Appends the samples written into the pointers from getInputWritePointers() */
+    void finishedInput (int numSamples);
+
+    /**
+     Resamples into output. If output has more channels than the input, the input channels
+     are repeated. Returns the number of samples produced, which is less than numSamples
+     if there was not enough input.
+     */
+    int process (juce::AudioBuffer<float>& output, int startSample, int numSamples);
+
+    Quality getQuality() const { return quality; }
+    double getRatio() const { return ratio; }
+
+private:
+    void createFilterTable();
+
+    static constexpr int numPhases = 256;
+
+    Quality quality = Quality::High;
+    int     numTaps = 32;
+    int     numChannels = 0;
+    double  ratio = 1.0;
+    double  position = 0.0;
+    int     numInput = 0;
+
+    juce::AudioBuffer<float> input;
+    std::vector<float*>      inputPointers;
+
+    /** numPhases + 1 rows of numTaps coefficients, and the differences to the next row for interpolation */
+    std::vector<float> coefficients;
+    std::vector<float> deltas;
+    std::vector<float> kernel;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (Resampler)
+};
+
+} // foleys
@@ -72,6 +72,75 @@ struct AudioStreamSettings final
     [[nodiscard]] int getSampleSize() const { return (bitsPerSample / 8); }
 };
 
+/** Options for the encoder of a video stream. Empty values leave the choice to the encoder */
+struct VideoEncoderSettings final
+{
+    enum class Threading
+    {
+        Auto = 0,   /**< Let the encoder use frame and slice threading */
+        Frame,      /**< Encode several frames in parallel, faster but adds latency */
+        Slice       /**< Split each frame into slices that are encoded in parallel */
+    };
+
+    juce::String codec;              /**< Name of the encoder, e.g. "libx264". Empty chooses by the file extension */
+    int          bitRate     = 0;    /**< Target bit rate in bits per second, 0 to encode by quality (crf) */
+    int          crf         = -1;   /**< Constant rate factor for quality based encoding, -1 for the encoder's default */
+    int          gopSize     = 0;    /**< Maximum distance between key frames, 0 for the encoder's default */
+    juce::String preset      { "medium" }; /**< Only used by encoders that have a preset, e.g. libx264 */
+    juce::String tune;
+    juce::String profile;
+    int          threadCount = 0;    /**< Number of encoder threads, 0 to choose automatically */
+    Threading    threading   = Threading::Auto;
+
+    /** Additional options passed to the encoder, e.g. "x264-params" */
+    juce::StringPairArray options;
+
+    /** Fast settings for preview renders */
+    static VideoEncoderSettings preview()
+    {
+        VideoEncoderSettings settings;
+        settings.preset = "ultrafast";
+        settings.crf = 28;
+        return settings;
+    }
+};
+
+/** Describes how urgently a clip needs to read ahead. The BufferingManager uses this to distribute the buffer memory */
+enum class ReadAheadState
+{
+    Playing = 0, /**< The clip is currently played back */
+    Upcoming,    /**< The clip will start playing soon, e.g. the next clip in a ComposedClip */
+    Idle,        /**< The clip is not expected to play any time soon */
+    Suspended    /**< The clip is not needed, e.g. it finished playing in a ComposedClip. It won't read ahead at all */
+};
+
+/** The amount of data a clip is allowed to buffer ahead of the playhead */
+struct ReadAheadBudget final
+{
+    double seconds  = 1.0;
+    size_t maxBytes = std::numeric_limits<size_t>::max();
+};
+
+/** How far a reader may go to catch up, if decoding the video falls behind the playhead */
+enum class CatchUpMode
+{
+    Off = 0,            /**< Decode and convert every frame */
+    SkipConversion,     /**< Decode all frames, but don't convert frames that are already too late to be shown */
+    SkipNonReference,   /**< Additionally let the decoder discard frames, that are not referenced by other frames */
+    SkipToKeyFrame      /**< Additionally drop all video packets until the next key frame */
+};
+
+/** Reports how closely the audio of a reader follows the timestamps in the stream */
+struct AudioSyncStatistics final
+{
+    double  currentError       = 0.0; /**< Last measured offset in seconds, positive if the timestamps are ahead of the decoded samples */
+    double  maximumError       = 0.0; /**< Largest absolute offset in seconds since the reader was opened */
+    int64_t insertedSamples    = 0;   /**< Samples of silence inserted to fill gaps in the stream */
+    int64_t trimmedSamples     = 0;   /**< Samples dropped, because they overlapped samples already written */
+    int64_t compensatedSamples = 0;   /**< Samples added or removed by slightly stretching the audio */
+    int     discontinuities    = 0;   /**< Timestamp jumps too big to be corrected, the stream was resynchronised instead */
+};
+
 /** Convert a time in seconds in frame counts, using the time base and duration in VideoStreamSettings */
 static inline int64_t convertTimecode (double pts, const VideoStreamSettings& settings)
 {
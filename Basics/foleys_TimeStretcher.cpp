@@ -0,0 +1,240 @@
+/*
+ ==============================================================================
+
+ Copyright (c) 2019 - 2021, Foleys Finest Audio - Daniel Walz
+ All rights reserved.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ ==============================================================================
+ */
+
+namespace foleys
+{
+
+namespace
+{
+    /** Cross correlation normalised by the energy of the candidate, so louder passages don't win over similar ones */
+    float getWaveformSimilarity (const float* reference, const float* candidate, int numSamples, int stride)
+    {
+        const auto energy = VectorMath::sumOfSquares (candidate, numSamples, stride);
+        return VectorMath::dotProduct (reference, candidate, numSamples, stride) / std::sqrt (energy + 1.0e-9f);
+    }
+}
+
+void TimeStretcher::prepare (int numChannelsToUse, double sampleRate, int maximumBlockSize)
+{
+    jassert (numChannelsToUse > 0 && sampleRate > 0.0);
+
+    numChannels = numChannelsToUse;
+    hopSize     = std::max (64, juce::roundToInt (sampleRate * 0.02));
+    grainSize   = 2 * hopSize;
+    searchRange = juce::roundToInt (sampleRate * 0.01);
+
+    // a periodic hann window sums up to one at half overlap
+    window.resize (size_t (grainSize));
+    for (int i = 0; i < grainSize; ++i)
+        window [size_t (i)] = float (0.5 - 0.5 * std::cos (juce::MathConstants<double>::twoPi * i / grainSize));
+
+    input.setSize (numChannels, grainSize + 2 * searchRange + 4 * (maximumBlockSize + hopSize));
+    overlap.setSize (numChannels, grainSize);
+    queue.setSize (numChannels, maximumBlockSize + hopSize);
+    inputPointers.resize (size_t (numChannels), nullptr);
+    mono.resize (size_t (3 * searchRange + 5 * hopSize));
+
+    reset();
+}
+
+void TimeStretcher::reset()
+{
+    numInput  = 0;
+    numQueued = 0;
+    analysisPosition = 0.0;
+    previousGrain = -1;
+    overlap.clear();
+}
+
+void TimeStretcher::setRate (double rateToUse)
+{
+    rate = juce::jlimit (0.25, 4.0, rateToUse);
+}
+
+int TimeStretcher::getNumInputSamplesNeeded (int numOutput) const
+{
+    const auto missing = numOutput - numQueued;
+    if (missing <= 0 || hopSize == 0)
+        return 0;
+
+    const auto numGrains = (missing + hopSize - 1) / hopSize;
+    const auto last = int (analysisPosition + (numGrains - 1) * hopSize * rate);
+    return std::max (last + searchRange + grainSize - numInput, 0);
+}
+
+float* const* TimeStretcher::getInputWritePointers (int numSamples)
+{
+    if (input.getNumSamples() < numInput + numSamples)
+        input.setSize (numChannels, numInput + numSamples, true, false, true);
+
+    for (int c = 0; c < numChannels; ++c)
+        inputPointers [size_t (c)] = input.getWritePointer (c) + numInput;
+
+    return inputPointers.data();
+}
+
+void TimeStretcher::finishedInput (int numSamples)
+{
+    jassert (numInput + numSamples <= input.getNumSamples());
+    numInput += numSamples;
+}
+
+bool TimeStretcher::canProcessGrain() const
+{
+    return int (analysisPosition) + searchRange + grainSize <= numInput;
+}
+
+int TimeStretcher::findBestGrainPosition (int nominal)
+{
+    if (previousGrain < 0)
+        return std::max (nominal, 0);
+
+    // at the original speed the natural continuation is always the best match
+    const auto natural = previousGrain + hopSize;
+    if (rate == 1.0)
+        return natural;
+
+    const auto first = std::max (nominal - searchRange, 0);
+    const auto last  = nominal + searchRange;
+
+    // mix the region down once, so the search costs the same for any number of channels
+    const auto regionStart  = std::min (first, natural);
+    const auto regionLength = std::max (last, natural) + hopSize - regionStart;
+    if (int (mono.size()) < regionLength)
+        mono.resize (size_t (regionLength));
+
+    juce::FloatVectorOperations::copy (mono.data(), input.getReadPointer (0, regionStart), regionLength);
+    for (int c = 1; c < numChannels; ++c)
+        juce::FloatVectorOperations::add (mono.data(), input.getReadPointer (c, regionStart), regionLength);
+
+    const auto* reference = mono.data() + (natural - regionStart);
+
+    // coarse search on every 4th position and sample, then refine around the best match
+    const int coarseStep = 4;
+    auto best = juce::jlimit (first, last, nominal);
+    auto bestSimilarity = std::numeric_limits<float>::lowest();
+
+    for (auto position = nominal - (searchRange / coarseStep) * coarseStep; position <= last; position += coarseStep)
+    {
+        if (position < first)
+            continue;
+
+        const auto similarity = getWaveformSimilarity (reference, mono.data() + (position - regionStart), hopSize, coarseStep);
+        if (similarity > bestSimilarity)
+        {
+            bestSimilarity = similarity;
+            best = position;
+        }
+    }
+
+    const auto coarseBest = best;
+    bestSimilarity = std::numeric_limits<float>::lowest();
+
+    for (auto position = std::max (first, coarseBest - coarseStep + 1); position <= std::min (last, coarseBest + coarseStep - 1); ++position)
+    {
+        const auto similarity = getWaveformSimilarity (reference, mono.data() + (position - regionStart), hopSize, 1);
+        if (similarity > bestSimilarity)
+        {
+            bestSimilarity = similarity;
+            best = position;
+        }
+    }
+
+    return best;
+}
+
+void TimeStretcher::processGrain()
+{
+    const auto grain = findBestGrainPosition (int (analysisPosition));
+
+    for (int c = 0; c < numChannels; ++c)
+    {
+        auto* sum = overlap.getWritePointer (c);
+        juce::FloatVectorOperations::addWithMultiply (sum, input.getReadPointer (c, grain), window.data(), grainSize);
+
+        // the first half has seen both grains, it is complete
+        queue.copyFrom (c, numQueued, sum, hopSize);
+        std::memmove (sum, sum + hopSize, size_t (grainSize - hopSize) * sizeof (float));
+        juce::FloatVectorOperations::clear (sum + grainSize - hopSize, hopSize);
+    }
+
+    numQueued += hopSize;
+    previousGrain = grain;
+    analysisPosition += hopSize * rate;
+}
+
+int TimeStretcher::process (juce::AudioBuffer<float>& output, int startSample, int numSamples)
+{
+    if (numChannels == 0)
+    {
+        output.clear (startSample, numSamples);
+        return 0;
+    }
+
+    if (queue.getNumSamples() < numSamples + hopSize)
+        queue.setSize (numChannels, numSamples + hopSize, true, true, true);
+
+    while (numQueued < numSamples && canProcessGrain())
+        processGrain();
+
+    const auto produced = std::min (numSamples, numQueued);
+    const auto numProcessed = std::min (numChannels, output.getNumChannels());
+
+    for (int c = 0; c < numProcessed; ++c)
+        output.copyFrom (c, startSample, queue, c, 0, produced);
+
+    for (int c = numProcessed; c < output.getNumChannels(); ++c)
+        output.copyFrom (c, startSample, output, c % numProcessed, startSample, produced);
+
+    if (produced < numSamples)
+        output.clear (startSample + produced, numSamples - produced);
+
+    for (int c = 0; c < numChannels; ++c)
+    {
+        auto* data = queue.getWritePointer (c);
+        std::memmove (data, data + produced, size_t (numQueued - produced) * sizeof (float));
+    }
+
+    numQueued -= produced;
+
+    // drop the input, that is neither needed for the next grain nor its search
+    auto keep = int (analysisPosition) - searchRange;
+    if (previousGrain >= 0)
+        keep = std::min (keep, previousGrain + hopSize);
+
+    const auto consumed = juce::jlimit (0, numInput, keep);
+    if (consumed > 0)
+    {
+        for (int c = 0; c < numChannels; ++c)
+        {
+            auto* data = input.getWritePointer (c);
+            std::memmove (data, data + consumed, size_t (numInput - consumed) * sizeof (float));
+        }
+
+        numInput -= consumed;
+        analysisPosition -= consumed;
+        if (previousGrain >= 0)
+            previousGrain -= consumed;
+    }
+
+    return produced;
+}
+
+} // foleys
@@ -0,0 +1,92 @@
+/*
+ ==============================================================================
+
+ Copyright (c) 2019 - 2021, Foleys Finest Audio - Daniel Walz
+ All rights reserved.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ ==============================================================================
+ */
+
+#pragma once
+
+namespace foleys
+{
+
+/**
+ Changes the speed of audio without changing the pitch, using waveform similarity
+ overlap-add (WSOLA): grains of the input are cross faded with half overlap, and each
+ grain is moved within a small search range to the position, where it is most similar
+ to the natural continuation of the previous grain. This keeps the waveform continuous,
+ so there is no phasiness, but percussive material can be smeared a little.
+
+ The input is appended with getInputWritePointers() and finishedInput(), like in the
+ Resampler, so it can be pulled straight from an AudioFifo.
+ */
+class TimeStretcher final
+{
+public:
+    TimeStretcher() = default;
+
+    /** Prepares the buffers. The grain size and search range are chosen for the sample rate */
+    void prepare (int numChannels, double sampleRate, int maximumBlockSize);
+
+    /** Clears the input and the overlap, the next output starts with the next input sample */
+    void reset();
+
+    /** Sets the speed, 0.25 to 4 times. 2 means the input is played twice as fast */
+    void setRate (double rate);
+    double getRate() const { return rate; }
+
+    /** Returns the number of input samples, that need to be appended to produce numOutput samples */
+    int getNumInputSamplesNeeded (int numOutput) const;
+
+    /** Returns one pointer per channel to append numSamples of input. Call finishedInput() afterwards */
+    float* const* getInputWritePointers (int numSamples);
+
+    /** Appends the samples written into the pointers from getInputWritePointers() */
+    void finishedInput (int numSamples);
+
+    /**
+     Writes the stretched audio into output. If output has more channels than the input, the input
+     channels are repeated. Returns the number of samples produced, which is less than numSamples
+     if there was not enough input.
+     */
+    int process (juce::AudioBuffer<float>& output, int startSample, int numSamples);
+
+private:
+    bool canProcessGrain() const;
+    void processGrain();
+    int  findBestGrainPosition (int nominal);
+
+    int    numChannels   = 0;
+    int    grainSize     = 0;
+    int    hopSize       = 0;
+    int    searchRange   = 0;
+    double rate          = 1.0;
+    double analysisPosition = 0.0;
+    int    previousGrain = -1;
+    int    numInput      = 0;
+    int    numQueued     = 0;
+
+    juce::AudioBuffer<float> input;
+    juce::AudioBuffer<float> overlap;
+    juce::AudioBuffer<float> queue;
+    std::vector<float*>      inputPointers;
+    std::vector<float>       window;
+    std::vector<float>       mono;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (TimeStretcher)
+};
+
+} // foleys
@@ -0,0 +1,62 @@
+/*
+ ==============================================================================
+
+ Copyright (c) 2019 - 2021, Foleys Finest Audio - Daniel Walz
+ All rights reserved.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ ==============================================================================
+ */
+
+#pragma once
+
+namespace foleys
+{
+
+/**
+ Small loops shared by the resampler, the time stretcher and the meters. They use four
+ independent sums, so the compiler can keep them in one vector register.
+ */
+namespace VectorMath
+{
+
+/** Returns the sum of a [i] * b [i], taking every stride-th sample */
+inline float dotProduct (const float* a, const float* b, int numSamples, int stride = 1)
+{
+    float sum0 = 0.0f, sum1 = 0.0f, sum2 = 0.0f, sum3 = 0.0f;
+
+    const auto step = 4 * stride;
+    int i = 0;
+    for (; i + step <= numSamples; i += step)
+    {
+        sum0 += a [i]              * b [i];
+        sum1 += a [i + stride]     * b [i + stride];
+        sum2 += a [i + 2 * stride] * b [i + 2 * stride];
+        sum3 += a [i + 3 * stride] * b [i + 3 * stride];
+    }
+
+    for (; i < numSamples; i += stride)
+        sum0 += a [i] * b [i];
+
+    return (sum0 + sum1) + (sum2 + sum3);
+}
+
+/** Returns the sum of the squared samples, taking every stride-th sample */
+inline float sumOfSquares (const float* samples, int numSamples, int stride = 1)
+{
+    return dotProduct (samples, samples, numSamples, stride);
+}
+
+} // VectorMath
+
+} // foleys
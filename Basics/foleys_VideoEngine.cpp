@@ -23,12 +23,7 @@ namespace foleys
 
 VideoEngine::VideoEngine()
 {
-    const int numReaders = std::max (4, juce::SystemStats::getNumCpus());
-    for (int i = 0; i < numReaders; ++i)
-        readingThreads.emplace_back (std::make_unique<juce::TimeSliceThread>("Reading Thread #" + juce::String (i)));
-
-    for (auto& reader : readingThreads)
-        reader->startThread();
+    audioReadingThread.startThread();
 
     startTimer (1000);
 
@@ -39,13 +34,18 @@ VideoEngine::VideoEngine()
 
 VideoEngine::~VideoEngine()
 {
+    renderQueue.cancelAllJobs();
+
 #if FOLEYS_REPORT_USAGE
     jobThreads.addJob (new UsageReporter ("appFinished"), true);
     juce::Thread::sleep (1000);
 #endif
 
-    for (auto& reader : readingThreads)
-        reader->stopThread (500);
+    audioReadingThread.stopThread (500);
+
+    for (auto& clip : releasePool)
+        if (auto* client = clip->getBackgroundJob())
+            removeFromBackgroundThreads (client);
 
     masterReference.clear();
 }
@@ -66,38 +66,42 @@ std::unique_ptr<AVReader> VideoEngine::createReaderFor (juce::File file, StreamT
 
 juce::TimeSliceThread& VideoEngine::getNextTimeSliceThread()
 {
-    jassert (!readingThreads.empty());
-
-    int minClients = std::numeric_limits<int>::max();
-    size_t nextThread = 0;
-    for (size_t i=0; i < readingThreads.size(); ++i)
-    {
-        auto& thread = readingThreads.at (i);
-        if (thread->getNumClients() <= minClients)
-        {
-            minClients = thread->getNumClients();
-            nextThread = i;
-        }
-    }
+    return audioReadingThread;
+}
 
-    return *readingThreads [nextThread];
+ReaderScheduler& VideoEngine::getReaderScheduler()
+{
+    return readerScheduler;
 }
 
 void VideoEngine::manageLifeTime (std::shared_ptr<AVClip> clip)
 {
     releasePool.push_back (clip);
 
+    if (clip->getPerformanceCounters() == nullptr)
+        clip->setPerformanceCounters (performanceMonitor.createCounters (clip->getDescription()));
+
+    bufferingManager.addClip (clip);
+
     auto* client = clip->getBackgroundJob();
     if (client == nullptr)
         return;
 
-    getNextTimeSliceThread().addTimeSliceClient (client);
+    readerScheduler.addJob (client, clip.get());
+}
+
+void VideoEngine::releaseWhenUnused (std::shared_ptr<const void> object)
+{
+    if (object == nullptr)
+        return;
+
+    const juce::ScopedLock sl (unusedLock);
+    unusedPool.push_back (std::move (object));
 }
 
 void VideoEngine::removeFromBackgroundThreads (juce::TimeSliceClient* client)
 {
-    for (auto& reader : readingThreads)
-        reader->removeTimeSliceClient (client);
+    readerScheduler.removeJob (client);
 }
 
 void VideoEngine::addJob (std::function<void()> job)
@@ -126,6 +130,8 @@ void VideoEngine::timerCallback()
     {
         if (p->use_count() == 1)
         {
+            bufferingManager.removeClip (p->get());
+
             if (auto* client = (*p)->getBackgroundJob())
                 removeFromBackgroundThreads (client);
 
@@ -136,6 +142,52 @@ void VideoEngine::timerCallback()
             ++p;
         }
     }
+
+    std::vector<std::shared_ptr<const void>> unused;
+
+    {
+        const juce::ScopedLock sl (unusedLock);
+        for (auto p = unusedPool.begin(); p != unusedPool.end();)
+        {
+            if (p->use_count() == 1)
+            {
+                unused.push_back (std::move (*p));
+                p = unusedPool.erase (p);
+            }
+            else
+            {
+                ++p;
+            }
+        }
+    }
+
+    // plugins and ValueTree listeners must be deleted on the message thread, so this happens here outside the lock
+    unused.clear();
+}
+
+PerformanceMonitor& VideoEngine::getPerformanceMonitor()
+{
+    return performanceMonitor;
+}
+
+BufferingManager& VideoEngine::getBufferingManager()
+{
+    return bufferingManager;
+}
+
+RenderQueue& VideoEngine::getRenderQueue()
+{
+    return renderQueue;
+}
+
+void VideoEngine::setCacheDirectory (const juce::File& directory)
+{
+    cacheDirectory = directory;
+}
+
+juce::File VideoEngine::getCacheDirectory() const
+{
+    return cacheDirectory;
 }
 
 juce::UndoManager* VideoEngine::getUndoManager()
@@ -36,7 +36,7 @@ class CameraManager;
 
  You can use the VideoEngine to create instances of AVClip, using the built in AVFormatManager.
  It also manages the lifetime of the clips, managing the auto release pool and the thread
- pools for reading ahead and for creating the thumbnails.
+ pools for reading ahead and for creating the thumbnails, and the RenderQueue for exports.
  */
 class VideoEngine  : private juce::Timer
 {
@@ -70,6 +70,13 @@ public:
      */
     void manageLifeTime (std::shared_ptr<AVClip> clip);
 
+    /**
+     Keeps the object alive, until no other thread holds a reference to it, and deletes it
+     on the message thread. Use this for data, that a realtime thread might still use,
+     e.g. a processor chain that was replaced. Plugins must be deleted on the message thread.
+     */
+    void releaseWhenUnused (std::shared_ptr<const void> object);
+
     /**
      You can set an external undomanager. In this case you are responsible for detetion.
      If you use the undomanager provided by the engine, you don't have to do anything
@@ -115,10 +122,42 @@ public:
                                                                      juce::String& error) const;
 
     /**
-     This method will find the TimeSliceThread with the least number of clients to balance the load.
+     Returns a TimeSliceThread for juce classes that need one, e.g. the juce::BufferingAudioSource.
+     The clips' own background jobs run on the ReaderScheduler instead.
      */
     juce::TimeSliceThread& getNextTimeSliceThread();
 
+    /**
+     Grants access to the ReaderScheduler, that runs the background reading jobs of the clips,
+     e.g. to display the queue depths.
+     */
+    ReaderScheduler& getReaderScheduler();
+
+    /**
+     Grants access to the PerformanceMonitor, to query the time spent in the individual
+     stages per clip or to export a trace.
+     */
+    PerformanceMonitor& getPerformanceMonitor();
+
+    /**
+     Grants access to the BufferingManager, e.g. to set the memory limit for reading ahead.
+     */
+    BufferingManager& getBufferingManager();
+
+    /**
+     Grants access to the RenderQueue, that renders batches of ClipRenderer jobs on its own
+     thread pool, so exports don't hold up the thumbnails.
+     */
+    RenderQueue& getRenderQueue();
+
+    /**
+     Set the directory, where the engine keeps generated data like frozen audio.
+     The files are named by a hash of their content, so they can be reused. Deleting
+     them is left to the application. The default is a folder in the temp directory.
+     */
+    void setCacheDirectory (const juce::File& directory);
+    juce::File getCacheDirectory() const;
+
 private:
 
     void removeFromBackgroundThreads (juce::TimeSliceClient* client);
@@ -134,10 +173,22 @@ private:
     juce::OptionalScopedPointer<juce::UndoManager> undoManager { new juce::UndoManager(), true };
 
     juce::ThreadPool jobThreads { std::max (4, juce::SystemStats::getNumCpus()) };
-    std::vector<std::unique_ptr<juce::TimeSliceThread>> readingThreads;
+    ReaderScheduler readerScheduler { std::max (4, juce::SystemStats::getNumCpus()) };
+    juce::TimeSliceThread audioReadingThread { "Audio Reading Thread" };
+
+    BufferingManager bufferingManager;
+
+    PerformanceMonitor performanceMonitor;
 
     std::vector<std::shared_ptr<AVClip>> releasePool;
 
+    juce::CriticalSection                    unusedLock;
+    std::vector<std::shared_ptr<const void>> unusedPool;
+
+    RenderQueue renderQueue;
+
+    juce::File cacheDirectory { juce::File::getSpecialLocation (juce::File::tempDirectory).getChildFile ("foleys_video_engine") };
+
     JUCE_DECLARE_WEAK_REFERENCEABLE (VideoEngine)
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (VideoEngine)
     
@@ -29,7 +29,14 @@ VideoFifo::VideoFifo (int size)
 
 VideoFrame& VideoFifo::getWritingFrame()
 {
-    return *frames [size_t (writePosition.load())];
+    auto& frame = *frames [size_t (writePosition.load())];
+    if (frame.image.isNull() && ! spareImages.empty())
+    {
+        frame.image = spareImages.back();
+        spareImages.pop_back();
+    }
+
+    return frame;
 }
 
 void VideoFifo::finishWriting()
@@ -44,12 +51,14 @@ void VideoFifo::finishWriting()
 
 VideoFrame& VideoFifo::getFrame (int64_t timecode)
 {
+    const juce::ScopedLock sl (readLock);
+
     auto pos = readPosition.load();
     auto nextPos = findFramePosition (timecode, pos);
     if (nextPos >= 0)
     {
         readPosition.store (nextPos);
-        return *frames [size_t (nextPos)];
+        return handOut (nextPos);
     }
 
 #if FOLEYS_DEBUG_LOGGING
@@ -57,9 +66,17 @@ VideoFrame& VideoFifo::getFrame (int64_t timecode)
     dumpTimeCodes();
 #endif
 
+    // the frame was skipped, e.g. at a faster playback rate: show the one before
+    auto latest = findLatestFrameBefore (timecode);
+    if (latest >= 0)
+    {
+        readPosition.store (latest);
+        return handOut (latest);
+    }
+
     readPosition.store (previousIndex (writePosition.load()));
 
-    return *frames [size_t (pos)];
+    return handOut (pos);
 }
 
 VideoFrame& VideoFifo::getFrameSeconds (double pts)
@@ -70,13 +87,24 @@ VideoFrame& VideoFifo::getFrameSeconds (double pts)
 
 VideoFrame& VideoFifo::getLatestFrame()
 {
+    const juce::ScopedLock sl (readLock);
+
     auto pos = previousIndex (writePosition.load());
     readPosition.store (pos);
+    return handOut (pos);
+}
+
+VideoFrame& VideoFifo::handOut (int pos)
+{
+    heldPosition = lastHandedOut;
+    lastHandedOut = pos;
     return *frames [size_t (pos)];
 }
 
 bool VideoFifo::setTimeCodeSeconds (double pts)
 {
+    const juce::ScopedLock sl (readLock);
+
     auto timecode = convertTimecode (pts, settings);
 
     auto pos = readPosition.load();
@@ -104,8 +132,86 @@ int VideoFifo::getFreeSpace() const
     return int (frames.size()) - getNumAvailableFrames();
 }
 
+int VideoFifo::getSize() const
+{
+    return int (frames.size());
+}
+
+void VideoFifo::setSize (int numFrames)
+{
+    jassert (numFrames > 1);
+
+    const juce::ScopedLock sl (readLock);
+
+    readPosition.store (0);
+    writePosition.store (0);
+    lastHandedOut = -1;
+    heldPosition  = -1;
+
+    frames.resize (size_t (std::max (numFrames, 2)));
+    for (auto& frame : frames)
+    {
+        if (frame == nullptr)
+            frame = std::make_unique<VideoFrame>();
+
+        frame->timecode = -1;
+        frame->yuv.reset();
+        frame->imageOutdated.store (false);
+    }
+}
+
+void VideoFifo::releaseUnusedFrames()
+{
+    const int maxSpareImages = 2;
+
+    const juce::ScopedLock sl (readLock);
+
+    // the frames from the read position on are not consumed yet, and the readers might still use the frames they got last
+    const auto write = writePosition.load();
+    const auto read  = readPosition.load();
+
+    for (auto pos = nextIndex (write); pos != write && pos != read; pos = nextIndex (pos))
+    {
+        if (pos == lastHandedOut || pos == heldPosition)
+            break;
+
+        auto& frame = *frames [size_t (pos)];
+        frame.yuv.reset();
+        frame.imageOutdated.store (false);
+        frame.timecode = -1;
+
+        if (frame.image.isNull())
+            continue;
+
+        // a reader might have kept a copy of the image, so only images nobody else refers to are written into again
+        if (frame.image.getReferenceCount() == 1 && int (spareImages.size()) < maxSpareImages)
+            spareImages.push_back (frame.image);
+
+        frame.image = juce::Image();
+    }
+}
+
+void VideoFifo::releaseFramesBefore (double pts)
+{
+    const juce::ScopedLock sl (readLock);
+
+    if (getNumAvailableFrames() == 0)
+        return;
+
+    const auto timecode = convertTimecode (pts, settings);
+    const auto latest   = previousIndex (writePosition.load());
+    auto pos = readPosition.load();
+
+    while (pos != latest && frames [size_t (pos)]->timecode + settings.defaultDuration <= timecode)
+        pos = nextIndex (pos);
+
+    readPosition.store (pos);
+}
+
 bool VideoFifo::isFrameAvailable (double pts) const
 {
+    const juce::ScopedLock sl (readLock);
+
     auto timecode = convertTimecode (pts, settings);
     auto pos = findFramePosition (timecode, readPosition.load());
     return pos >= 0;
@@ -153,6 +259,24 @@ int VideoFifo::findFramePosition (int64_t timecode, int start) const
     return -1;
 }
 
+int VideoFifo::findLatestFrameBefore (int64_t timecode) const
+{
+    const auto writing = writePosition.load();
+    int latest = -1;
+
+    for (int i = 0; i < int (frames.size()); ++i)
+    {
+        const auto frameTimecode = frames [size_t (i)]->timecode;
+        if (i == writing || frameTimecode < 0 || frameTimecode > timecode)
+            continue;
+
+        if (latest < 0 || frameTimecode > frames [size_t (latest)]->timecode)
+            latest = i;
+    }
+
+    return latest;
+}
+
 void VideoFifo::setVideoSettings (const VideoStreamSettings& s)
 {
     settings = s;
@@ -186,12 +310,18 @@ int VideoFifo::previousIndex (int pos, int offset) const
 
 void VideoFifo::clear()
 {
+    const juce::ScopedLock sl (readLock);
+
     readPosition.store (0);
     writePosition.store (0);
+    lastHandedOut = -1;
+    heldPosition  = -1;
 
     for (auto& frame : frames)
     {
         frame->timecode = -1;
+        frame->yuv.reset();
+        frame->imageOutdated.store (false);
     }
 }
 
@@ -42,6 +42,11 @@ public:
      */
     void finishWriting();
 
+    /**
+     Returns the frame to display at timecode. The frame stays valid until the
+     next but one call of getFrame() or getLatestFrame(), so a frame that is
+     still painted won't be recycled, while the next one is fetched.
+     */
     VideoFrame& getFrame (int64_t timecode);
     VideoFrame& getFrameSeconds (double pts);
 
@@ -64,6 +69,33 @@ public:
      */
     int getFreeSpace() const;
 
+    /**
+     Returns the total number of frames the fifo can hold
+     */
+    int getSize() const;
+
+    /**
+     Change the number of frames the fifo can hold. This will clear the fifo, so
+     make sure nobody is writing while calling this. Frames that were handed out
+     stay valid, unless the fifo shrinks.
+     */
+    void setSize (int numFrames);
+
+    /**
+     Releases the images of frames that were already consumed, so the memory is
+     proportional to the number of buffered frames rather than the size of the fifo.
+     A few images are kept to be reused by getWritingFrame(). The frames that were
+     handed out last by getFrame() are kept.
+     Call this only from the thread that is writing.
+     */
+    void releaseUnusedFrames();
+
+    /**
+     Advances the read position past the frames, that end before pts, so they can be overwritten.
+     The latest frame is always kept. Use this if frames are only fetched on demand.
+     */
+    void releaseFramesBefore (double pts);
+
     /**
      Reset all indices and set all VideoFrames to empty (timecode = -1)
      */
@@ -84,15 +116,27 @@ public:
 private:
     int findFramePosition (int64_t timecode, int start) const;
 
+    /** Returns the index of the latest frame, that starts before timecode, or -1 */
+    int findLatestFrameBefore (int64_t timecode) const;
+
+    /** Remembers the frame handed out to a reader, so releaseUnusedFrames() doesn't recycle it */
+    VideoFrame& handOut (int pos);
+
     int nextIndex (int pos, int offset=1) const;
     int previousIndex (int pos, int offset=1) const;
 
     VideoStreamSettings     settings;
 
     std::vector<std::unique_ptr<VideoFrame>> frames;
+    std::vector<juce::Image> spareImages;
     std::atomic<int>    writePosition {0};
     std::atomic<int>    readPosition  {0};
 
+    // guards the read position and the handed out frames against the writer releasing frames
+    juce::CriticalSection readLock;
+    int                 lastHandedOut = -1;
+    int                 heldPosition  = -1;
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (VideoFifo)
 };
 
@@ -0,0 +1,162 @@
+/*
+ ==============================================================================
+
+ Copyright (c) 2019 - 2021, Foleys Finest Audio - Daniel Walz
+ All rights reserved.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ ==============================================================================
+ */
+
+namespace foleys
+{
+
+std::shared_ptr<YUVFrame> YUVFrame::create (Size size)
+{
+    auto frame = std::make_shared<YUVFrame>();
+    frame->size = size;
+
+    size_t total = 0;
+    for (int plane = 0; plane < 3; ++plane)
+    {
+        const auto planeSize = frame->getPlaneSize (plane);
+        frame->lineSizes [plane] = (planeSize.width + 31) & ~31;
+        total += size_t (frame->lineSizes [plane] * planeSize.height);
+    }
+
+    auto memory = std::make_shared<juce::HeapBlock<uint8_t>> (total);
+
+    auto* data = memory->get();
+    for (int plane = 0; plane < 3; ++plane)
+    {
+        frame->planes [plane] = data;
+        data += frame->lineSizes [plane] * frame->getPlaneSize (plane).height;
+    }
+
+    frame->owner = memory;
+    return frame;
+}
+
+Size YUVFrame::getPlaneSize (int plane) const
+{
+    if (plane == 0)
+        return size;
+
+    return { (size.width + 1) / 2, (size.height + 1) / 2 };
+}
+
+void YUVFrame::clear()
+{
+    for (int plane = 0; plane < 3; ++plane)
+    {
+        const auto planeSize = getPlaneSize (plane);
+        const auto black = uint8_t (plane == 0 ? 16 : 128);
+
+        for (int y = 0; y < planeSize.height; ++y)
+            std::fill_n (planes [plane] + y * lineSizes [plane], planeSize.width, black);
+    }
+}
+
+void YUVFrame::copyFrom (const YUVFrame& other)
+{
+    jassert (size.width == other.size.width && size.height == other.size.height);
+
+    for (int plane = 0; plane < 3; ++plane)
+    {
+        const auto planeSize = getPlaneSize (plane);
+
+        for (int y = 0; y < planeSize.height; ++y)
+            std::copy_n (other.planes [plane] + y * other.lineSizes [plane], planeSize.width,
+                         planes [plane] + y * lineSizes [plane]);
+    }
+}
+
+void YUVFrame::blend (const YUVFrame& other, float alpha)
+{
+    jassert (size.width == other.size.width && size.height == other.size.height);
+
+    const auto weight = juce::jlimit (0, 256, juce::roundToInt (alpha * 256.0f));
+    if (weight == 0)
+        return;
+
+    if (weight == 256)
+    {
+        copyFrom (other);
+        return;
+    }
+
+    for (int plane = 0; plane < 3; ++plane)
+    {
+        const auto planeSize = getPlaneSize (plane);
+
+        for (int y = 0; y < planeSize.height; ++y)
+        {
+            const auto* source = other.planes [plane] + y * other.lineSizes [plane];
+            auto* target = planes [plane] + y * lineSizes [plane];
+
+            for (int x = 0; x < planeSize.width; ++x)
+                target [x] = uint8_t (target [x] + (((int (source [x]) - int (target [x])) * weight) >> 8));
+        }
+    }
+}
+
+void YUVFrame::convertToImage (juce::Image& image) const
+{
+    jassert (image.getWidth() == size.width && image.getHeight() == size.height);
+
+    juce::Image::BitmapData data (image, juce::Image::BitmapData::writeOnly);
+
+    for (int y = 0; y < size.height; ++y)
+    {
+        const auto* lumaLine = planes [0] + y * lineSizes [0];
+        const auto* uLine    = planes [1] + (y / 2) * lineSizes [1];
+        const auto* vLine    = planes [2] + (y / 2) * lineSizes [2];
+        auto* pixel = data.getLinePointer (y);
+
+        for (int x = 0; x < size.width; ++x)
+        {
+            // limited range, the luma is scaled from 16..235 and the chroma from 16..240
+            const auto c = 298 * (int (lumaLine [x]) - 16) + 128;
+            const auto d = int (uLine [x / 2]) - 128;
+            const auto e = int (vLine [x / 2]) - 128;
+
+            reinterpret_cast<juce::PixelARGB*> (pixel)->setARGB (255,
+                                                                 uint8_t (juce::jlimit (0, 255, (c + 409 * e) >> 8)),
+                                                                 uint8_t (juce::jlimit (0, 255, (c - 100 * d - 208 * e) >> 8)),
+                                                                 uint8_t (juce::jlimit (0, 255, (c + 516 * d) >> 8)));
+            pixel += data.pixelStride;
+        }
+    }
+}
+
+//==============================================================================
+
+void VideoFrame::updateImage()
+{
+    if (! imageOutdated.load())
+        return;
+
+    // several views might show the same frame, only one of them converts it
+    const juce::ScopedLock sl (conversionLock);
+
+    if (! imageOutdated.load() || yuv == nullptr)
+        return;
+
+    if (image.getWidth() != yuv->size.width || image.getHeight() != yuv->size.height || image.getReferenceCount() > 1)
+        image = juce::Image (juce::Image::ARGB, yuv->size.width, yuv->size.height, false);
+
+    yuv->convertToImage (image);
+    imageOutdated.store (false);
+}
+
+} // foleys
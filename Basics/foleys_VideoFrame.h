@@ -23,13 +23,58 @@
 namespace foleys
 {
 
+/**
+ The pixels of a frame in planar 8 bit YUV 4:2:0 with limited range, the way most codecs
+ deliver and expect them. When rendering, frames that are only passed through or blended
+ can skip the conversion to RGB and back.
+ */
+struct YUVFrame
+{
+    Size     size;
+    uint8_t* planes [3]    = {};
+    int      lineSizes [3] = {};
+
+    /** Keeps the memory of the planes alive, e.g. the frame of the decoder */
+    std::shared_ptr<void> owner;
+
+    /** Creates a frame, that owns its memory */
+    static std::shared_ptr<YUVFrame> create (Size size);
+
+    /** Returns the size of the plane, the chroma planes are subsampled */
+    Size getPlaneSize (int plane) const;
+
+    /** Fills the frame with black */
+    void clear();
+
+    /** Copies the pixels of a frame of the same size */
+    void copyFrom (const YUVFrame& other);
+
+    /** Blends a frame of the same size on top of this one */
+    void blend (const YUVFrame& other, float alpha);
+
+    /** Converts the pixels into an ARGB image of the same size, using the BT.601 coefficients */
+    void convertToImage (juce::Image& image) const;
+};
+
 struct VideoFrame
 {
     VideoFrame() = default;
     juce::int64 timecode = -1;
     juce::Image image;
 
+    /** Only set, if planar frames were requested (see AVClip::setPlanarFramesEnabled).
+        If a ComposedClip sets this, the image was not rendered. */
+    std::shared_ptr<YUVFrame> yuv;
+
+    /** Set by readers, that only provided the yuv planes. The image is converted by updateImage() */
+    std::atomic<bool> imageOutdated { false };
+
+    /** Converts the yuv planes into the image, if the reader skipped it. Call this before using the image */
+    void updateImage();
+
 private:
+    juce::CriticalSection conversionLock;
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (VideoFrame)
 };
 
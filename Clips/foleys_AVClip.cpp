@@ -100,11 +100,31 @@ void AVClip::addVideoParameter (std::unique_ptr<ProcessorParameter> parameter)
     videoParameters [parameter->getParameterID()] = std::move (parameter);
 }
 
+void AVClip::setReadAheadState (ReadAheadState state)
+{
+    readAheadState.store (state);
+}
+
+ReadAheadState AVClip::getReadAheadState() const
+{
+    return readAheadState.load();
+}
+
 juce::TimeSliceClient* AVClip::getBackgroundJob()
 {
     return nullptr;
 }
 
+PerformanceCounters* AVClip::getPerformanceCounters() const
+{
+    return performanceCounters.get();
+}
+
+void AVClip::setPerformanceCounters (std::shared_ptr<PerformanceCounters> counters)
+{
+    performanceCounters = std::move (counters);
+}
+
 VideoEngine* AVClip::getVideoEngine() const
 {
     return videoEngine;
@@ -112,6 +132,8 @@ VideoEngine* AVClip::getVideoEngine() const
 
 void AVClip::renderFrame (juce::Graphics& g, juce::Rectangle<float> area, VideoFrame& frame, float rotation, float zoom, juce::Point<float> translation, float alpha)
 {
+    frame.updateImage();
+
     if (frame.image.isNull())
         return;
 
@@ -157,6 +179,8 @@ void AVClip::renderFrame (juce::Graphics& g, juce::Rectangle<float> area, VideoF
 #if FOLEYS_USE_OPENGL
 void AVClip::renderFrame (OpenGLView& view, VideoFrame& frame, float rotation, float zoom, juce::Point<float> translation, float alpha)
 {
+    frame.updateImage();
+
     if (frame.image.isNull())
         return;
 
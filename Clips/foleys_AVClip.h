@@ -41,7 +41,7 @@ class OpenGLView;
 
  When you created a shared_ptr of an AVClip, call manageLifeTime() on the VideoEngine,
  that will add it to the auto release pool and register possible background jobs
- with the TimeSliceThreads.
+ with the ReaderScheduler.
  */
 class AVClip  : public juce::PositionableAudioSource,
                 public TimeCodeAware
@@ -109,6 +109,27 @@ public:
      */
     virtual double getFrameDurationInSeconds() const { return 0.0; }
 
+    /**
+     Asks the clip to attach a YUVFrame to the frames, if the source is planar YUV anyway.
+     The ClipRenderer uses this to skip the conversion to RGB and back. Those frames are
+     only converted to RGB, when VideoFrame::updateImage() is called.
+     */
+    virtual void setPlanarFramesEnabled (bool shouldProvideYUV) { juce::ignoreUnused (shouldProvideYUV); }
+
+    /**
+     In offline mode the clip doesn't read ahead in the background. Instead it decodes
+     synchronously on the calling thread, whenever audio or a frame is requested. It never
+     drops data nor gives up after a timeout, so a bounce is deterministic regardless of the load.
+     Don't use this for realtime playback.
+     */
+    virtual void setOfflineMode (bool shouldRenderOffline) { juce::ignoreUnused (shouldRenderOffline); }
+
+    /** Returns true, if the clip decodes on demand, see setOfflineMode() */
+    virtual bool isOfflineMode() const { return false; }
+
+    /** Returns true, if reading in offline mode got stuck since it was switched on, so the output has a gap */
+    virtual bool hasOfflineReadFailed() const { return false; }
+
     /** This returns a copy of the clip. Note that this will not work properly
         if the clip is not properly registered in the engine, because the
         copy will automatically be registered with the engine as well. */
@@ -132,6 +153,35 @@ public:
         return true;
     }
 
+    /**
+     Tells the clip how urgently it needs to read ahead. The BufferingManager of the
+     VideoEngine uses this to distribute the read ahead memory between the clips.
+     */
+    void setReadAheadState (ReadAheadState state);
+    ReadAheadState getReadAheadState() const;
+
+    /**
+     Sets the amount of data the clip may buffer ahead. This is called by the BufferingManager.
+     */
+    virtual void setReadAheadBudget (const ReadAheadBudget& budget) { juce::ignoreUnused (budget); }
+
+    /**
+     Returns the number of bytes needed to buffer one second of this clip. Clips, that
+     don't read ahead return 0.
+     */
+    virtual size_t getReadAheadBytesPerSecond() const { return 0; }
+
+    /**
+     Returns the number of bytes currently held in the read ahead buffers.
+     */
+    virtual size_t getBufferedBytes() const { return 0; }
+
+    /**
+     Returns the time in seconds until the clip runs out of buffered data. The ReaderScheduler
+     runs the most urgent background job first. Clips without a deadline return the maximum.
+     */
+    virtual double getSecondsToDeadline() const { return std::numeric_limits<double>::max(); }
+
     static void addDefaultAudioParameters (AVClip& clip);
     static void addDefaultVideoParameters (AVClip& clip);
 
@@ -141,6 +191,13 @@ public:
     /** @internal */
     virtual juce::TimeSliceClient* getBackgroundJob();
 
+    /** Returns the counters measuring the time this clip spends in each stage. This is set
+        by VideoEngine::manageLifeTime() and can be nullptr */
+    PerformanceCounters* getPerformanceCounters() const;
+
+    /** @internal */
+    void setPerformanceCounters (std::shared_ptr<PerformanceCounters> counters);
+
     /** @internal */
     VideoEngine* getVideoEngine() const;
 
@@ -158,6 +215,10 @@ private:
 
     Aspect zoomType = Aspect::LetterBox;
 
+    std::atomic<ReadAheadState> readAheadState { ReadAheadState::Playing };
+
+    std::shared_ptr<PerformanceCounters> performanceCounters;
+
     ParameterMap videoParameters;
     ParameterMap audioParameters;
 
@@ -45,140 +45,394 @@ void AudioClip::setMediaFile (const juce::URL& media)
     mediaFile = media;
 }
 
-void AudioClip::setAudioFormatReader (juce::AudioFormatReader* readerToUse, int samplesToBuffer)
+/**
+ Reads from the AudioFormatReader straight into the free space of the AudioFifo. If the
+ file's sample rate differs from the playback, the samples are resampled on the way.
+ */
+class AudioClip::FifoReader
 {
-    if (readerToUse == nullptr)
+public:
+    FifoReader (juce::AudioFormatReader& readerToUse, Resampler::Quality quality, double sampleRate)
+      : reader (readerToUse),
+        ratio (sampleRate > 0 ? readerToUse.sampleRate / sampleRate : 1.0)
     {
-        resampler.reset();
-        readerSource.reset();
-        reader.reset();
-        return;
+        if (ratio != 1.0)
+        {
+            resampler = std::make_unique<Resampler> (quality);
+            resampler->prepare (int (reader.numChannels), ratio);
+        }
     }
 
-    reader.reset (readerToUse);
+    /** Sets the position in samples at the playback rate */
+    void setPosition (int64_t position)
+    {
+        const auto sourcePosition = position * ratio;
+        readPosition = int64_t (sourcePosition);
+
+        if (resampler)
+        {
+            resampler->reset (sourcePosition - double (readPosition));
+            readPosition -= resampler->getHistorySize();
+        }
+    }
 
-    if (samplesToBuffer > 0 && getVideoEngine() != nullptr)
+    void readInto (AudioFifo& fifo, int numSamples)
     {
-        readerSource = std::make_unique<juce::BufferingAudioSource>(new juce::AudioFormatReaderSource (reader.get(), false),
-                                                                    getVideoEngine()->getNextTimeSliceThread(),
-                                                                    true,
-                                                                    samplesToBuffer,
-                                                                    reader->numChannels);
+        while (numSamples > 0)
+        {
+            int space = 0;
+            auto* const* pointers = fifo.getWritePointers (space);
+            const auto numToWrite = std::min (space, numSamples);
+            if (numToWrite <= 0)
+                return;
+
+            juce::AudioBuffer<float> target (pointers, fifo.getNumChannels(), numToWrite);
+
+            if (resampler)
+            {
+                const auto needed = resampler->getNumInputSamplesNeeded (numToWrite);
+                if (needed > 0)
+                {
+                    juce::AudioBuffer<float> input (resampler->getInputWritePointers (needed), int (reader.numChannels), needed);
+                    read (input);
+                    resampler->finishedInput (needed);
+                }
+
+                FOLEYS_MEASURE_STAGE (Conversion);
+                resampler->process (target, 0, numToWrite);
+            }
+            else
+            {
+                read (target);
+            }
+
+            fifo.finishedWrite (numToWrite);
+            numSamples -= numToWrite;
+        }
     }
-    else
+
+private:
+    void read (juce::AudioBuffer<float>& buffer)
     {
-        readerSource = std::make_unique<juce::AudioFormatReaderSource>(reader.get(), false);
+        FOLEYS_MEASURE_STAGE (Decode);
+
+        // beyond the end of the file the reader fills in silence
+        reader.read (&buffer, 0, buffer.getNumSamples(), readPosition, true, true);
+        readPosition += buffer.getNumSamples();
     }
 
-    setupResampler();
+    juce::AudioFormatReader&   reader;
+    std::unique_ptr<Resampler> resampler;
+    const double               ratio;
+    int64_t                    readPosition = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (FifoReader)
+};
+
+AudioClip::~AudioClip()
+{
+    backgroundJob.setSuspended (true);
 }
 
-void AudioClip::setupResampler()
+void AudioClip::setAudioFormatReader (juce::AudioFormatReader* readerToUse, int samplesToBufferAhead)
 {
-    if (reader.get() == nullptr)
-    {
-        resampler.reset();
-        readerSource.reset();
+    backgroundJob.setSuspended (true);
+
+    fifoReader.reset();
+    reader.reset (readerToUse);
+
+    if (reader == nullptr)
         return;
-    }
 
     originalSampleRate = reader->sampleRate;
-    if (originalSampleRate != sampleRate)
-        resampler = std::make_unique<juce::ResamplingAudioSource> (readerSource.get(), false, reader->numChannels);
-    else
-        resampler.reset();
+    samplesToBuffer = samplesToBufferAhead;
 
-    if (resampler.get() != nullptr && sampleRate > 0)
-    {
-        resampler->setResamplingRatio (originalSampleRate / sampleRate);
-        resampler->prepareToPlay (samplesPerBlock, sampleRate);
-    }
+    audioFifo.setNumChannels (int (reader->numChannels));
+    updateFifoSizes();
+    createFifoReader();
+
+    backgroundJob.setSuspended (false);
+}
+
+void AudioClip::createFifoReader()
+{
+    jassert (backgroundJob.isSuspended());
+
+    fifoReader = std::make_unique<FifoReader> (*reader, resamplingQuality, sampleRate);
+
+    audioFifo.setPosition (nextReadPosition.load());
+    fifoReader->setPosition (nextReadPosition.load());
+}
+
+void AudioClip::updateFifoSizes()
+{
+    if (sampleRate <= 0)
+        return;
+
+    auto seconds = 1.0;
+    if (auto* engine = getVideoEngine())
+        seconds = std::max (seconds, engine->getBufferingManager().getReadAheadTime (ReadAheadState::Playing));
+
+    // offline a whole block is read at once
+    const auto blockSeconds = offline.load() ? samplesPerBlock / sampleRate : 0.0;
+
+    audioFifo.setNumSamples (std::max (samplesToBuffer, juce::roundToInt (sampleRate * (seconds + blockSeconds))));
+}
+
+void AudioClip::setOfflineMode (bool shouldRenderOffline)
+{
+    if (offline.load() == shouldRenderOffline)
+        return;
+
+    backgroundJob.setSuspended (true);
+    offline.store (shouldRenderOffline);
+
+    if (reader == nullptr)
+        return;
+
+    // resizing empties the fifo, so the reader needs to be positioned again
+    updateFifoSizes();
+    createFifoReader();
+
+    backgroundJob.setSuspended (false);
+}
+
+bool AudioClip::isOfflineMode() const
+{
+    return offline.load();
+}
+
+void AudioClip::setResamplingQuality (Resampler::Quality quality)
+{
+    if (resamplingQuality == quality)
+        return;
+
+    backgroundJob.setSuspended (true);
+    resamplingQuality = quality;
+
+    if (reader == nullptr)
+        return;
+
+    createFifoReader();
+    backgroundJob.setSuspended (false);
 }
 
 void AudioClip::prepareToPlay (int samplesPerBlockExpected, double sampleRateToUse)
 {
+    backgroundJob.setSuspended (true);
+
+    if (sampleRate != sampleRateToUse)
+        nextReadPosition = juce::int64 (getCurrentTimeInSeconds() * sampleRateToUse);
+
     sampleRate = sampleRateToUse;
     samplesPerBlock = samplesPerBlockExpected;
+    audioFifo.setSampleRate (sampleRate);
+
+    if (reader == nullptr)
+        return;
 
-    setupResampler();
+    updateFifoSizes();
+    createFifoReader();
 
-    readerSource->prepareToPlay (samplesPerBlockExpected, sampleRate);
+    backgroundJob.setSuspended (false);
 }
 
 void AudioClip::releaseResources()
 {
-    if (readerSource)
-        readerSource->releaseResources();
 }
 
 void AudioClip::getNextAudioBlock (const juce::AudioSourceChannelInfo& info)
 {
     const auto gain = float (juce::Decibels::decibelsToGain (getAudioParameters().at(IDs::gain)->getRealValue()));
 
-    if (resampler.get() != nullptr)
-        resampler->getNextAudioBlock (info);
-    else if (readerSource.get() != nullptr)
-        readerSource->getNextAudioBlock (info);
+    if (fifoReader.get() != nullptr)
+    {
+        if (offline.load())
+        {
+            FOLEYS_PERFORMANCE_SOURCE (getPerformanceCounters());
+            fifoReader->readInto (audioFifo, info.numSamples - audioFifo.getAvailableSamples());
+        }
+
+        audioFifo.pullSamples (info);
+    }
     else
+    {
         info.clearActiveBufferRegion();
+    }
+
+    nextReadPosition += info.numSamples;
 
     info.buffer->applyGainRamp (info.startSample, info.numSamples, lastGain, gain);
     lastGain = gain;
 }
 
-void AudioClip::setNextReadPosition (juce::int64 samples)
+bool AudioClip::waitForSamplesReady (int samples, int timeout)
 {
-    if (readerSource)
+    if (fifoReader.get() == nullptr)
+        return true;
+
+    if (offline.load())
     {
-        if (sampleRate > 0 && originalSampleRate != sampleRate)
-            readerSource->setNextReadPosition (juce::int64 (samples * originalSampleRate / sampleRate));
-        else
-            readerSource->setNextReadPosition (samples);
+        fifoReader->readInto (audioFifo, samples - audioFifo.getAvailableSamples());
+        return true;
     }
+
+    FOLEYS_PERFORMANCE_SOURCE (getPerformanceCounters());
+    FOLEYS_MEASURE_STAGE (Wait);
+
+    const auto start = juce::Time::getMillisecondCounter();
+
+    while (audioFifo.getAvailableSamples() < samples && int (juce::Time::getMillisecondCounter() - start) < timeout)
+        juce::Thread::sleep (5);
+
+    return audioFifo.getAvailableSamples() >= samples;
 }
 
-juce::int64 AudioClip::getNextReadPosition() const
+void AudioClip::setNextReadPosition (juce::int64 samples)
 {
-    if (readerSource)
-    {
-        if (originalSampleRate > 0 && sampleRate != originalSampleRate)
-            return juce::int64 (readerSource->getNextReadPosition() * sampleRate / originalSampleRate);
+    backgroundJob.setSuspended (true);
 
-        return readerSource->getNextReadPosition();
+    nextReadPosition = samples;
+
+    if (fifoReader.get() != nullptr)
+    {
+        audioFifo.setPosition (samples);
+        fifoReader->setPosition (samples);
     }
 
-    return 0;
+    backgroundJob.setSuspended (fifoReader.get() == nullptr);
+}
+
+juce::int64 AudioClip::getNextReadPosition() const
+{
+    return nextReadPosition.load();
 }
 
 juce::int64 AudioClip::getTotalLength() const
 {
-    if (readerSource)
-    {
-        if (originalSampleRate > 0 && sampleRate != originalSampleRate)
-            return juce::int64 (readerSource->getTotalLength() * sampleRate / originalSampleRate);
+    if (reader == nullptr)
+        return 0;
 
-        return readerSource->getTotalLength();
-    }
+    if (sampleRate > 0 && originalSampleRate > 0)
+        return juce::int64 (reader->lengthInSamples * sampleRate / originalSampleRate);
 
-    return 0;
+    return reader->lengthInSamples;
 }
 
 double AudioClip::getCurrentTimeInSeconds() const
 {
-    if (readerSource && originalSampleRate > 0.0)
-        return readerSource->getNextReadPosition() / originalSampleRate;
+    const auto rate = sampleRate > 0 ? sampleRate : originalSampleRate;
+    if (rate > 0.0)
+        return nextReadPosition.load() / rate;
 
     return 0.0;
 }
 
 double AudioClip::getLengthInSeconds() const
 {
-    if (readerSource && originalSampleRate > 0.0)
-        return readerSource->getTotalLength() / originalSampleRate;
+    if (reader && originalSampleRate > 0.0)
+        return reader->lengthInSamples / originalSampleRate;
 
     return 0.0;
 }
 
+void AudioClip::setReadAheadBudget (const ReadAheadBudget& budget)
+{
+    readAheadSeconds.store (budget.seconds);
+    readAheadBytes.store (budget.maxBytes);
+}
+
+size_t AudioClip::getReadAheadBytesPerSecond() const
+{
+    return size_t (audioFifo.getNumChannels() * sampleRate * sizeof (float));
+}
+
+size_t AudioClip::getBufferedBytes() const
+{
+    return size_t (audioFifo.getAvailableSamples()) * size_t (audioFifo.getNumChannels()) * sizeof (float);
+}
+
+double AudioClip::getSecondsToDeadline() const
+{
+    const auto state = getReadAheadState();
+    if (state == ReadAheadState::Idle || state == ReadAheadState::Suspended)
+        return std::numeric_limits<double>::max();
+
+    return getBufferedSeconds (std::numeric_limits<double>::max());
+}
+
+double AudioClip::getBufferedSeconds (double maxSeconds) const
+{
+    if (sampleRate > 0)
+        return std::min (maxSeconds, audioFifo.getAvailableSamples() / sampleRate);
+
+    return maxSeconds;
+}
+
+int AudioClip::getNumSamplesToRead() const
+{
+    if (sampleRate <= 0)
+        return 0;
+
+    auto target = std::max (samplesPerBlock, int (readAheadSeconds.load() * sampleRate));
+
+    const auto bytesPerSample = size_t (audioFifo.getNumChannels()) * sizeof (float);
+    if (bytesPerSample > 0)
+        target = int (std::min (size_t (target), std::max (readAheadBytes.load() / bytesPerSample, size_t (samplesPerBlock))));
+
+    const auto missing = std::min (target - audioFifo.getAvailableSamples(), audioFifo.getFreeSpace());
+    return juce::jlimit (0, readChunkSize, missing);
+}
+
+AudioClip::BackgroundReaderJob::BackgroundReaderJob (AudioClip& ownerToUse)
+    : owner (ownerToUse)
+{
+}
+
+int AudioClip::BackgroundReaderJob::useTimeSlice()
+{
+    // offline the samples are read synchronously when they are requested
+    if (owner.getReadAheadState() == ReadAheadState::Suspended || owner.offline.load())
+        return 100;
+
+    FOLEYS_PERFORMANCE_SOURCE (owner.getPerformanceCounters());
+
+    if (suspended == false && owner.fifoReader.get() != nullptr)
+    {
+        juce::ScopedValueSetter<bool> guard (inReadBlock, true);
+
+        const auto numSamples = owner.getNumSamplesToRead();
+        if (numSamples > 0)
+            owner.fifoReader->readInto (owner.audioFifo, numSamples);
+    }
+
+    if (owner.getNextReadPosition() >= owner.getTotalLength())
+        return 100;
+
+    // the fuller the buffer compared to the budget, the longer we can wait
+    const auto target = std::max (owner.readAheadSeconds.load(), 0.01);
+
+    return int (50.0 * owner.getBufferedSeconds (target) / target);
+}
+
+void AudioClip::BackgroundReaderJob::setSuspended (bool s)
+{
+    suspended = s;
+
+    while (suspended && inReadBlock)
+        juce::Thread::sleep (5);
+}
+
+bool AudioClip::BackgroundReaderJob::isSuspended() const
+{
+    return suspended;
+}
+
+juce::TimeSliceClient* AudioClip::getBackgroundJob()
+{
+    return &backgroundJob;
+}
+
 std::shared_ptr<AVClip> AudioClip::createCopy (StreamTypes types)
 {
     auto* engine = getVideoEngine();
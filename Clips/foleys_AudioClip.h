@@ -26,18 +26,20 @@ namespace foleys
 /**
  @class AudioClip
 
- The AudioClip plays back an audio file inside the video engine. It wraps around
- a JUCE AudioFormatReaderSource.
+ The AudioClip plays back an audio file inside the video engine. Like the MovieClip
+ a background job reads ahead into an AudioFifo, resampling to the playback rate on
+ the way, so the audio callback only copies the samples out of the fifo.
 
  When you created a shared_ptr of an AudioClip, call manageLifeTime() on the VideoEngine,
  that will add it to the auto release pool and register possible background jobs
- with the TimeSliceThreads.
+ with the ReaderScheduler.
  */
 
 class AudioClip : public AVClip
 {
 public:
     AudioClip (VideoEngine& videoEngine);
+    ~AudioClip() override;
 
     /** Used to identify the clip type to the user */
     juce::String getClipType() const override { return NEEDS_TRANS ("Audio"); }
@@ -47,6 +49,7 @@ public:
     juce::URL getMediaFile() const override;
     void setMediaFile (const juce::URL& media);
 
+    /** Takes ownership of the reader. samplesToBuffer is the minimum size of the fifo, the read ahead is set by the BufferingManager */
     void setAudioFormatReader (juce::AudioFormatReader* reader, int samplesToBuffer = 48000);
 
     VideoFrame& getFrame ([[maybe_unused]]double pts) override { return dummy; }
@@ -88,20 +91,81 @@ public:
 
     double getSampleRate() const override { return sampleRate; }
 
+    /** When rendering non realtime (bounce), use this to wait for background
+        threads to read ahead */
+    bool waitForSamplesReady (int samples, int timeout=1000) override;
+
+    /** In offline mode the clip reads synchronously when the samples are requested */
+    void setOfflineMode (bool shouldRenderOffline) override;
+    bool isOfflineMode() const override;
+
+    /** Set the quality of the resampler, that is used when the file's sample rate differs from the playback */
+    void setResamplingQuality (Resampler::Quality quality);
+    Resampler::Quality getResamplingQuality() const { return resamplingQuality; }
+
+    void setReadAheadBudget (const ReadAheadBudget& budget) override;
+    size_t getReadAheadBytesPerSecond() const override;
+    size_t getBufferedBytes() const override;
+    double getSecondsToDeadline() const override;
+
+    juce::TimeSliceClient* getBackgroundJob() override;
+
 private:
+    class FifoReader;
 
-    void setupResampler();
+    /** Creates the FifoReader for the current sample rate and quality and positions it. Suspend the backgroundJob before */
+    void createFifoReader();
 
-    std::unique_ptr<juce::AudioFormatReader>       reader;
-    std::unique_ptr<juce::PositionableAudioSource> readerSource;
-    std::unique_ptr<juce::ResamplingAudioSource>   resampler;
+    /** Sets the size of the fifo to hold the read ahead, and in offline mode additionally a whole block */
+    void updateFifoSizes();
+
+    /** The number of samples the background job should add to the fifo, 0 if it is filled up to the budget */
+    int getNumSamplesToRead() const;
+
+    /** The time in seconds, that is buffered, but at most maxSeconds */
+    double getBufferedSeconds (double maxSeconds) const;
+
+    /** @internal */
+    class BackgroundReaderJob : public juce::TimeSliceClient
+    {
+    public:
+        BackgroundReaderJob (AudioClip& owner);
+
+        int useTimeSlice() override;
+
+        void setSuspended (bool s);
+        bool isSuspended() const;
+    private:
+        AudioClip& owner;
+        std::atomic<bool> suspended = true;
+        bool inReadBlock = false;
+    };
+
+    BackgroundReaderJob backgroundJob {*this};
+    friend BackgroundReaderJob;
+
+    std::unique_ptr<juce::AudioFormatReader> reader;
+    std::unique_ptr<FifoReader>              fifoReader;
+    AudioFifo  audioFifo;
     VideoFrame dummy;
     juce::URL  mediaFile;
     double sampleRate = 0.0;
     double originalSampleRate = 0.0;
     int    samplesPerBlock = 0;
+    int    samplesToBuffer = 0;
     float  lastGain = 0.0;
 
+    std::atomic<int64_t> nextReadPosition { 0 };
+    std::atomic<bool>    offline { false };
+
+    std::atomic<double> readAheadSeconds { 1.0 };
+    std::atomic<size_t> readAheadBytes   { std::numeric_limits<size_t>::max() };
+
+    /** The maximum number of samples the background job reads in one time slice */
+    static constexpr int readChunkSize = 8192;
+
+    Resampler::Quality resamplingQuality = Resampler::Quality::High;
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (AudioClip)
 };
 
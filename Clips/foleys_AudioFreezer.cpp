@@ -0,0 +1,537 @@
+/*
+ ==============================================================================
+
+ Copyright (c) 2019 - 2021, Foleys Finest Audio - Daniel Walz
+ All rights reserved.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ ==============================================================================
+ */
+namespace foleys
+{
+
+namespace
+{
+    /** FNV-1a, the hash only names the cache files */
+    uint64_t hashBytes (const void* data, size_t numBytes)
+    {
+        auto hash = uint64_t (14695981039346656037ULL);
+        auto* bytes = static_cast<const uint8_t*> (data);
+
+        for (size_t i = 0; i < numBytes; ++i)
+        {
+            hash ^= bytes [i];
+            hash *= uint64_t (1099511628211ULL);
+        }
+
+        return hash;
+    }
+
+    struct AutomationSnapshot
+    {
+        std::map<double, double> keyframes;
+        double value = 0.0;
+
+        AutomationSnapshot (const ParameterAutomation& automation)
+          : keyframes (automation.getKeyframes()),
+            value (automation.getValue())
+        {}
+
+        double getValueForTime (double pts) const
+        {
+            return ParameterAutomation::getValueForTime (keyframes, value, pts);
+        }
+    };
+
+    class RenderPlayHead : public juce::AudioPlayHead
+    {
+    public:
+        RenderPlayHead() = default;
+
+        bool getCurrentPosition (juce::AudioPlayHead::CurrentPositionInfo &result) override
+        {
+            result.timeInSamples = timeInSamples;
+            result.timeInSeconds = timeInSeconds;
+            return true;
+        }
+
+        bool canControlTransport() override
+        {
+            return false;
+        }
+
+        juce::int64 timeInSamples = 0;
+        double      timeInSeconds = 0.0;
+
+    private:
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (RenderPlayHead)
+    };
+}
+
+//==============================================================================
+
+class AudioFreezer::RenderJob : public juce::ThreadPoolJob
+{
+public:
+    struct Processor
+    {
+        std::unique_ptr<juce::AudioProcessor> processor;
+        bool active = true;
+        std::vector<std::pair<int, AutomationSnapshot>> automations;
+    };
+
+    RenderJob (AudioFreezer& freezer, std::shared_ptr<AVClip> clipToRender, const juce::File& fileToWrite)
+      : juce::ThreadPoolJob ("Freeze audio"),
+        owner (&freezer),
+        generation (freezer.generation),
+        renderGeneration (freezer.generation->load()),
+        progress (freezer.progress),
+        clip (std::move (clipToRender)),
+        file (fileToWrite)
+    {}
+
+    ~RenderJob() override
+    {
+        // the plugin instances were created on the message thread and are deleted there
+        auto instances = std::make_shared<std::vector<Processor>> (std::move (processors));
+        juce::MessageManager::callAsync ([instances = std::move (instances)] {});
+    }
+
+    juce::ThreadPoolJob::JobStatus runJob() override
+    {
+        file.getParentDirectory().createDirectory();
+        juce::TemporaryFile tempFile (file);
+
+        juce::WavAudioFormat format;
+        auto stream = std::make_unique<juce::FileOutputStream> (tempFile.getFile());
+        std::unique_ptr<juce::AudioFormatWriter> writer;
+        if (stream->openedOk())
+            writer.reset (format.createWriterFor (stream.get(), sampleRate, juce::uint32 (numChannels), 32, {}, 0));
+
+        if (writer.get() == nullptr)
+        {
+            FOLEYS_LOG ("Could not write frozen audio: " << file.getFullPathName());
+            return juce::ThreadPoolJob::jobHasFinished;
+        }
+
+        stream.release();
+
+        RenderPlayHead playhead;
+        for (auto& p : processors)
+        {
+            p.processor->setPlayHead (&playhead);
+            p.processor->prepareToPlay (sampleRate, blockSize);
+        }
+
+        const auto& clipParameters = clip->getAudioParameters();
+
+        clip->setOfflineMode (true);
+        clip->prepareToPlay (blockSize, sampleRate);
+        clip->setNextReadPosition (offsetSamples);
+
+        juce::AudioBuffer<float> buffer (numChannels, blockSize);
+        juce::MidiBuffer midiDummy;
+
+        for (int64_t position = 0; position < lengthSamples; position += blockSize)
+        {
+            if (shouldExit() || generation->load() != renderGeneration)
+                return juce::ThreadPoolJob::jobHasFinished;
+
+            const auto numSamples = int (std::min (int64_t (blockSize), lengthSamples - position));
+            // like in the DefaultAudioMixer, the clip's automation is timed from the clip's start and the processors' from the source
+            const auto clipTime = position / sampleRate;
+            const auto pts = offset + clipTime;
+
+            for (const auto& automation : clipAutomations)
+            {
+                const auto parameter = clipParameters.find (automation.first);
+                if (parameter != clipParameters.end())
+                    parameter->second->setNormalisedValue (automation.second.getValueForTime (clipTime));
+            }
+
+            juce::AudioBuffer<float> block (buffer.getArrayOfWritePointers(), numChannels, 0, numSamples);
+            clip->getNextAudioBlock (juce::AudioSourceChannelInfo (block));
+
+            // the time is counted in the source, so moving the clip doesn't change the render
+            playhead.timeInSamples = offsetSamples + position;
+            playhead.timeInSeconds = pts;
+
+            for (auto& p : processors)
+            {
+                const auto& parameters = p.processor->getParameters();
+                for (const auto& automation : p.automations)
+                    if (juce::isPositiveAndBelow (automation.first, parameters.size()))
+                        parameters [automation.first]->setValue (float (automation.second.getValueForTime (pts)));
+
+                if (p.active)
+                    p.processor->processBlock (block, midiDummy);
+                else
+                    p.processor->processBlockBypassed (block, midiDummy);
+
+                midiDummy.clear();
+            }
+
+            writer->writeFromAudioSampleBuffer (block, 0, numSamples);
+
+            progress->store (double (position + numSamples) / double (lengthSamples));
+        }
+
+        for (auto& p : processors)
+            p.processor->releaseResources();
+
+        writer.reset();
+
+        if (! tempFile.overwriteTargetFileWithTemporary())
+            return juce::ThreadPoolJob::jobHasFinished;
+
+        juce::MessageManager::callAsync ([freezer = owner, finished = renderGeneration, renderedFile = file]() mutable
+                                         {
+                                             if (freezer)
+                                                 freezer->renderFinished (finished, renderedFile);
+                                         });
+
+        return juce::ThreadPoolJob::jobHasFinished;
+    }
+
+    std::vector<Processor> processors;
+    std::vector<std::pair<juce::Identifier, AutomationSnapshot>> clipAutomations;
+
+    double  sampleRate    = 48000.0;
+    int     blockSize     = 1024;
+    int     numChannels   = 2;
+    double  offset        = 0.0;
+    int64_t offsetSamples = 0;
+    int64_t lengthSamples = 0;
+
+private:
+    juce::WeakReference<AudioFreezer>    owner;
+    std::shared_ptr<std::atomic<int>>    generation;
+    const int                            renderGeneration;
+    std::shared_ptr<std::atomic<double>> progress;
+
+    std::shared_ptr<AVClip> clip;
+    juce::File              file;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (RenderJob)
+};
+
+//==============================================================================
+
+AudioFreezer::AudioFreezer (ClipDescriptor& ownerToUse)
+  : owner (ownerToUse),
+    state (ownerToUse.getStatusTree())
+{
+    state.addListener (this);
+
+    setEnabled (state.getProperty (IDs::frozenAudio, false));
+}
+
+AudioFreezer::~AudioFreezer()
+{
+    // a running render will notice and stop
+    ++(*generation);
+
+    state.removeListener (this);
+    masterReference.clear();
+}
+
+void AudioFreezer::setEnabled (bool shouldBeEnabled)
+{
+    if (enabled == shouldBeEnabled)
+        return;
+
+    enabled = shouldBeEnabled;
+    invalidate();
+
+    if (! enabled)
+    {
+        retireFile (frozenFile);
+        frozenFile = juce::File();
+        deleteRetiredFiles();
+    }
+}
+
+bool AudioFreezer::isEnabled() const
+{
+    return enabled;
+}
+
+bool AudioFreezer::isReady() const
+{
+    return getFrozenClip() != nullptr;
+}
+
+void AudioFreezer::invalidate()
+{
+    ++(*generation);
+    progress->store (-1.0);
+
+    setFrozenClip ({});
+
+    if (enabled)
+        startTimer (renderDelayMilliseconds);
+    else
+        stopTimer();
+}
+
+double AudioFreezer::getProgress() const
+{
+    return progress->load();
+}
+
+void AudioFreezer::updateSampleRate()
+{
+    if (enabled && renderSampleRate != owner.getOwningClip().getSampleRate())
+        invalidate();
+}
+
+std::shared_ptr<AVClip> AudioFreezer::getFrozenClip() const
+{
+    return std::atomic_load (&frozenClip);
+}
+
+void AudioFreezer::setFrozenClip (std::shared_ptr<AVClip> clip)
+{
+    // the engine's release pool keeps the previous clip alive, in case the audio thread still reads it
+    std::atomic_store (&frozenClip, std::move (clip));
+}
+
+void AudioFreezer::setNextReadPosition (int64_t samples)
+{
+    if (auto clip = getFrozenClip())
+        clip->setNextReadPosition (samples);
+}
+
+void AudioFreezer::setReadAheadState (ReadAheadState readAheadState)
+{
+    if (auto clip = getFrozenClip())
+        clip->setReadAheadState (readAheadState);
+}
+
+void AudioFreezer::timerCallback()
+{
+    stopTimer();
+    deleteRetiredFiles();
+    startRender();
+}
+
+void AudioFreezer::startRender()
+{
+    auto& composedClip = owner.getOwningClip();
+    auto* engine = composedClip.getVideoEngine();
+
+    renderSampleRate = composedClip.getSampleRate();
+
+    if (engine == nullptr || owner.clip == nullptr || ! owner.clip->hasAudio() || renderSampleRate <= 0.0)
+        return;
+
+    const auto blockSize   = std::max (composedClip.getDefaultBufferSize(), 64);
+    const auto numChannels = std::max (composedClip.getNumChannels(), 1);
+
+    // everything, that changes the rendered audio, goes into the name of the file
+    juce::MemoryOutputStream hashData;
+    hashData << owner.clip->getMediaFile().toString (true) << owner.getOffset() << owner.getLength()
+             << renderSampleRate << numChannels
+             << state.getChildWithName (IDs::audioParameters).toXmlString();
+
+    const auto processors = owner.getAudioProcessors();
+    std::vector<juce::MemoryBlock> processorStates;
+
+    for (const auto& controller : *processors)
+    {
+        juce::MemoryBlock block;
+        if (auto* processor = controller->getAudioProcessor())
+            processor->getStateInformation (block);
+
+        // the saved plugin state might be outdated, the current state was read above
+        auto processorState = controller->getProcessorState().createCopy();
+        processorState.removeProperty (IDs::state, nullptr);
+        processorState.removeProperty (IDs::pluginStatus, nullptr);
+
+        hashData << processorState.toXmlString();
+        hashData.write (block.getData(), block.getSize());
+
+        processorStates.push_back (std::move (block));
+    }
+
+    const auto file = engine->getCacheDirectory().getChildFile ("frozen_" + juce::String::toHexString (juce::int64 (hashBytes (hashData.getData(), hashData.getDataSize())))).withFileExtension ("wav");
+
+    // the same state was rendered before, e.g. before an undo
+    if (file.existsAsFile())
+    {
+        file.setLastModificationTime (juce::Time::getCurrentTime());
+        renderFinished (generation->load(), file);
+        return;
+    }
+
+    auto job = std::make_unique<RenderJob> (*this, owner.clip->createCopy (StreamTypes::audio()), file);
+    job->sampleRate    = renderSampleRate;
+    job->blockSize     = blockSize;
+    job->numChannels   = numChannels;
+    job->offset        = owner.getOffset();
+    job->offsetSamples = owner.getOffsetInSamples();
+    job->lengthSamples = owner.getLengthInSamples();
+
+    for (auto& parameter : owner.getAudioParameterController().getParameters())
+        job->clipAutomations.push_back ({ parameter.first, AutomationSnapshot (*parameter.second) });
+
+    for (size_t i = 0; i < processors->size(); ++i)
+    {
+        const auto& controller = processors->at (i);
+        if (controller->getAudioProcessor() == nullptr)
+            continue;
+
+        // the render needs its own instances, the live ones are busy on the audio thread
+        juce::String error;
+        auto instance = engine->createAudioPluginInstance (controller->getProcessorState().getProperty (IDs::identifier), renderSampleRate, blockSize, error);
+        if (instance.get() == nullptr)
+        {
+            FOLEYS_LOG ("Freezing " << owner.getDescription() << " failed: " << error);
+            return;
+        }
+
+        const auto& block = processorStates [i];
+        if (block.getSize() > 0)
+            instance->setStateInformation (block.getData(), int (block.getSize()));
+
+        RenderJob::Processor processor;
+        processor.processor = std::move (instance);
+        processor.active = controller->isActive();
+
+        for (auto& parameter : controller->getParameters())
+            processor.automations.push_back ({ parameter.second->getParameterIndex(), AutomationSnapshot (*parameter.second) });
+
+        job->processors.push_back (std::move (processor));
+    }
+
+    progress->store (0.0);
+    engine->addJob (job.release(), true);
+}
+
+void AudioFreezer::renderFinished (int renderGeneration, const juce::File& file)
+{
+    if (! enabled || renderGeneration != generation->load())
+        return;
+
+    progress->store (-1.0);
+
+    auto* engine = owner.getOwningClip().getVideoEngine();
+    if (engine == nullptr || owner.clip == nullptr)
+        return;
+
+    auto clip = engine->createClipFromFile (juce::URL (file), StreamTypes::audio());
+    if (clip == nullptr)
+        return;
+
+    clip->prepareToPlay (owner.getOwningClip().getDefaultBufferSize(), owner.getOwningClip().getSampleRate());
+
+    // if the clip is playing meanwhile, this will be late and the mixer uses the processors until the next seek
+    clip->setNextReadPosition (std::max (owner.clip->getNextReadPosition() - owner.getOffsetInSamples(), int64_t (0)));
+
+    setFrozenClip (clip);
+
+    if (file != frozenFile)
+    {
+        retireFile (frozenFile);
+        frozenFile = file;
+    }
+
+    deleteRetiredFiles();
+    trimCache (file.getParentDirectory(), file);
+}
+
+void AudioFreezer::retireFile (const juce::File& file)
+{
+    if (file != juce::File())
+        retiredFiles.push_back (file);
+}
+
+void AudioFreezer::deleteRetiredFiles()
+{
+    // the previous clip might still have the file open, that delete is tried again next time
+    retiredFiles.erase (std::remove_if (retiredFiles.begin(), retiredFiles.end(),
+                                        [] (const juce::File& file) { return ! file.existsAsFile() || file.deleteFile(); }),
+                        retiredFiles.end());
+}
+
+void AudioFreezer::trimCache (const juce::File& directory, const juce::File& fileToKeep)
+{
+    auto files = directory.findChildFiles (juce::File::findFiles, false, "frozen_*.wav");
+
+    std::sort (files.begin(), files.end(), [] (const juce::File& a, const juce::File& b)
+                                           {
+                                               return a.getLastModificationTime() > b.getLastModificationTime();
+                                           });
+
+    juce::int64 totalBytes = 0;
+    for (const auto& file : files)
+    {
+        totalBytes += file.getSize();
+
+        if (totalBytes > maximumCacheBytes && file != fileToKeep)
+            file.deleteFile();
+    }
+}
+
+bool AudioFreezer::affectsAudio (const juce::ValueTree& tree) const
+{
+    for (auto node = tree; node.isValid() && node != state; node = node.getParent())
+        if (node.getType() == IDs::audioProcessors || node.getType() == IDs::audioParameters)
+            return true;
+
+    return false;
+}
+
+void AudioFreezer::valueTreePropertyChanged (juce::ValueTree& treeWhosePropertyHasChanged,
+                                             const juce::Identifier& property)
+{
+    if (treeWhosePropertyHasChanged == state)
+    {
+        if (property == IDs::frozenAudio)
+            setEnabled (state.getProperty (IDs::frozenAudio, false));
+        else if (property == IDs::length || property == IDs::offset || property == IDs::source)
+            invalidate();
+
+        return;
+    }
+
+    // the saved plugin state and the status don't change the sound
+    if (property == IDs::state || property == IDs::pluginStatus)
+        return;
+
+    if (affectsAudio (treeWhosePropertyHasChanged))
+        invalidate();
+}
+
+void AudioFreezer::valueTreeChildAdded (juce::ValueTree& parentTree,
+                                        juce::ValueTree&)
+{
+    if (affectsAudio (parentTree))
+        invalidate();
+}
+
+void AudioFreezer::valueTreeChildRemoved (juce::ValueTree& parentTree,
+                                          juce::ValueTree&,
+                                          int)
+{
+    if (affectsAudio (parentTree))
+        invalidate();
+}
+
+void AudioFreezer::valueTreeChildOrderChanged (juce::ValueTree& parentTree, int, int)
+{
+    if (affectsAudio (parentTree))
+        invalidate();
+}
+
+} // foleys
@@ -0,0 +1,137 @@
+/*
+ ==============================================================================
+
+ Copyright (c) 2019 - 2021, Foleys Finest Audio - Daniel Walz
+ All rights reserved.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ ==============================================================================
+ */
+#pragma once
+
+namespace foleys
+{
+
+class ClipDescriptor;
+
+/**
+ @class AudioFreezer
+
+ The AudioFreezer renders the audio of a ClipDescriptor including its AudioProcessors
+ and their automation into a file in the VideoEngine's cache directory. While the
+ frozen audio is up to date, the DefaultAudioMixer plays it instead of running the
+ processors, which saves the CPU of heavy plugin chains.
+
+ The render runs on the VideoEngine's thread pool with its own instances of the plugins.
+ Any change of the processors, their automation or the clip's length or offset invalidates
+ the frozen audio, and a new render is started after a short delay. Until it has finished,
+ the processors are running live again. Moving the clip keeps the frozen audio.
+
+ A file, that was replaced by a newer render, is deleted. Old files of all clips are
+ deleted, once the frozen files together exceed maximumCacheBytes.
+
+ Changes inside a plugin, that don't show as a parameter, can't be detected. In that
+ case call ClipDescriptor::invalidateFrozenAudio().
+ */
+class AudioFreezer  : private juce::ValueTree::Listener,
+                      private juce::Timer
+{
+public:
+    AudioFreezer (ClipDescriptor& owner);
+    ~AudioFreezer() override;
+
+    /** Start or stop rendering and playing back the frozen audio */
+    void setEnabled (bool shouldBeEnabled);
+    bool isEnabled() const;
+
+    /** Returns true, if the frozen audio is rendered and can be played */
+    bool isReady() const;
+
+    /** Drops the frozen audio and renders it again */
+    void invalidate();
+
+    /** Returns the progress of the current render between 0 and 1, or -1 if no render is running */
+    double getProgress() const;
+
+    /** Renders again, if the sample rate of the ComposedClip changed */
+    void updateSampleRate();
+
+    /** Returns the clip playing the frozen audio, if it is ready. The audio thread keeps this
+        pointer while reading, a newer render won't delete it */
+    std::shared_ptr<AVClip> getFrozenClip() const;
+
+    /** Positions the frozen audio. The position is counted from the clip's offset,
+        so it is zero where the clip starts in the timeline */
+    void setNextReadPosition (int64_t samples);
+
+    void setReadAheadState (ReadAheadState state);
+
+private:
+    class RenderJob;
+
+    void startRender();
+    void renderFinished (int generation, const juce::File& file);
+    void setFrozenClip (std::shared_ptr<AVClip> clip);
+
+    void retireFile (const juce::File& file);
+    void deleteRetiredFiles();
+
+    /** Deletes the least recently used frozen files beyond maximumCacheBytes */
+    static void trimCache (const juce::File& directory, const juce::File& fileToKeep);
+
+    void timerCallback() override;
+
+    void valueTreePropertyChanged (juce::ValueTree& treeWhosePropertyHasChanged,
+                                   const juce::Identifier& property) override;
+
+    void valueTreeChildAdded (juce::ValueTree& parentTree,
+                              juce::ValueTree& childWhichHasBeenAdded) override;
+
+    void valueTreeChildRemoved (juce::ValueTree& parentTree,
+                                juce::ValueTree& childWhichHasBeenRemoved,
+                                int indexFromWhichChildWasRemoved) override;
+
+    void valueTreeChildOrderChanged (juce::ValueTree& parentTree, int, int) override;
+
+    void valueTreeParentChanged (juce::ValueTree&) override {}
+
+    /** Returns true, if a change in this tree changes the rendered audio */
+    bool affectsAudio (const juce::ValueTree& tree) const;
+
+    ClipDescriptor& owner;
+    juce::ValueTree state;
+
+    bool   enabled          = false;
+    double renderSampleRate = 0.0;
+
+    /** Counts the invalidations, a render of an older generation is discarded */
+    std::shared_ptr<std::atomic<int>>    generation { std::make_shared<std::atomic<int>>(0) };
+    std::shared_ptr<std::atomic<double>> progress   { std::make_shared<std::atomic<double>>(-1.0) };
+
+    std::shared_ptr<AVClip> frozenClip;
+    juce::File              frozenFile;
+
+    /** Files of previous renders, that couldn't be deleted yet */
+    std::vector<juce::File> retiredFiles;
+
+    /** Changes are collected for this time before a new render is started */
+    static constexpr int renderDelayMilliseconds = 500;
+
+    /** Size of all frozen files in the cache directory */
+    static constexpr juce::int64 maximumCacheBytes = juce::int64 (2) * 1024 * 1024 * 1024;
+
+    JUCE_DECLARE_WEAK_REFERENCEABLE (AudioFreezer)
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (AudioFreezer)
+};
+
+} // foleys
@@ -60,6 +60,7 @@ ClipDescriptor::ClipDescriptor (ComposedClip& ownerToUse, std::shared_ptr<AVClip
     videoParameterController.setClip (clip->getVideoParameters(), state.getOrCreateChildWithName (IDs::videoParameters, nullptr), undoManager);
 
     state.addListener (this);
+    freezer = std::make_unique<AudioFreezer> (*this);
 }
 
 ClipDescriptor::ClipDescriptor (ComposedClip& ownerToUse, juce::ValueTree stateToUse, juce::UndoManager* undo)
@@ -74,7 +75,7 @@ ClipDescriptor::ClipDescriptor (ComposedClip& ownerToUse, juce::ValueTree stateT
     {
         auto source = state.getProperty (IDs::source);
 
-        clip = engine->createClipFromFile ({ source });
+        clip = engine->createClipFromFile ({ source }, owner.getStreamTypes());
         if (clip)
         {
             audioParameterController.setClip (clip->getAudioParameters(), state.getOrCreateChildWithName (IDs::audioParameters, undoManager), undoManager);
@@ -90,14 +91,15 @@ ClipDescriptor::ClipDescriptor (ComposedClip& ownerToUse, juce::ValueTree stateT
         }
     }
     state.addListener (this);
+    freezer = std::make_unique<AudioFreezer> (*this);
 }
 
 ClipDescriptor::~ClipDescriptor()
 {
-    for (const auto& vp : videoProcessors)
+    for (const auto& vp : *videoProcessors)
         listeners.call ([&](ClipDescriptor::Listener& l) { l.processorControllerToBeDeleted (vp.get()); } );
 
-    for (const auto& ap : audioProcessors)
+    for (const auto& ap : *audioProcessors)
         listeners.call ([&](ClipDescriptor::Listener& l) { l.processorControllerToBeDeleted (ap.get()); } );
 }
 
@@ -146,6 +148,48 @@ bool ClipDescriptor::getAudioPlaying() const
     return state.getProperty (IDs::audio, true);
 }
 
+void ClipDescriptor::setAudioBus (int bus)
+{
+    state.setProperty (IDs::audioBus, bus, undoManager);
+}
+
+int ClipDescriptor::getAudioBus() const
+{
+    return state.getProperty (IDs::audioBus, 0);
+}
+
+void ClipDescriptor::setAudioFrozen (bool shouldBeFrozen)
+{
+    state.setProperty (IDs::frozenAudio, shouldBeFrozen, undoManager);
+}
+
+bool ClipDescriptor::isAudioFrozen() const
+{
+    return state.getProperty (IDs::frozenAudio, false);
+}
+
+AudioFreezer& ClipDescriptor::getAudioFreezer()
+{
+    return *freezer;
+}
+
+void ClipDescriptor::setClipReadPosition (int64_t samples)
+{
+    clip->setNextReadPosition (samples);
+    freezer->setNextReadPosition (samples - getOffsetInSamples());
+}
+
+void ClipDescriptor::setClipReadAheadState (ReadAheadState readAheadState)
+{
+    clipReadAheadState.store (readAheadState);
+    freezer->setReadAheadState (readAheadState);
+}
+
+ReadAheadState ClipDescriptor::getClipReadAheadState() const
+{
+    return clipReadAheadState.load();
+}
+
 double ClipDescriptor::getCurrentTimeInSeconds() const
 {
     return getClipTimeInDescriptorTime (getOwningClip().getCurrentTimeInSeconds());
@@ -162,14 +206,23 @@ void ClipDescriptor::triggerTimecodeUpdate (juce::NotificationType type)
     sendTimecode (0, getCurrentTimeInSeconds(), type);
 }
 
-const std::vector<std::unique_ptr<ProcessorController>>& ClipDescriptor::getVideoProcessors() const
+std::shared_ptr<const ClipDescriptor::ProcessorChain> ClipDescriptor::getVideoProcessors() const
+{
+    return std::atomic_load (&videoProcessors);
+}
+
+std::shared_ptr<const ClipDescriptor::ProcessorChain> ClipDescriptor::getAudioProcessors() const
 {
-    return videoProcessors;
+    return std::atomic_load (&audioProcessors);
 }
 
-const std::vector<std::unique_ptr<ProcessorController>>& ClipDescriptor::getAudioProcessors() const
+void ClipDescriptor::publishChain (std::shared_ptr<const ProcessorChain>& chain, ProcessorChain newChain)
 {
-    return audioProcessors;
+    auto previous = std::atomic_exchange (&chain, std::make_shared<const ProcessorChain> (std::move (newChain)));
+
+    // a render thread might still process the previous chain, so it must not be deleted here
+    if (auto* engine = owner.getVideoEngine())
+        engine->releaseWhenUnused (std::move (previous));
 }
 
 void ClipDescriptor::addListener (Listener* listener)
@@ -238,9 +291,17 @@ void ClipDescriptor::updateSampleCounts()
     offset = state.getProperty (IDs::offset);
 
     const auto sampleRate = clip->getSampleRate();
-    startSamples  = juce::int64 (sampleRate * start);
+    const auto newStart   = juce::int64 (sampleRate * start);
+    const auto newOffset  = juce::int64 (sampleRate * offset);
+
+    // only moving the clip in the timeline or in its source needs it to be positioned again
+    if (startSamples.exchange (newStart) != newStart || offsetSamples.exchange (newOffset) != newOffset)
+        preRollState = PreRollState::Required;
+
     lengthSamples = juce::int64 (sampleRate * length);
-    offsetSamples = juce::int64 (sampleRate * offset);
+
+    if (freezer)
+        freezer->updateSampleRate();
 }
 
 ClipDescriptor::ClipParameterController& ClipDescriptor::getAudioParameterController()
@@ -284,13 +345,13 @@ void ClipDescriptor::addAudioProcessor (std::unique_ptr<ProcessorController> con
         processorsNode.addChild (controller->getProcessorState(), index, undoManager);
     }
 
-    {
-        juce::ScopedLock sl (owner.getCallbackLock());
-        if (juce::isPositiveAndBelow (index, audioProcessors.size()))
-            audioProcessors.insert (std::next (audioProcessors.begin(), index), std::move (controller));
-        else
-            audioProcessors.push_back (std::move (controller));
-    }
+    auto chain = *getAudioProcessors();
+    if (juce::isPositiveAndBelow (index, chain.size()))
+        chain.insert (std::next (chain.begin(), index), std::move (controller));
+    else
+        chain.push_back (std::move (controller));
+
+    publishChain (audioProcessors, std::move (chain));
 
     listeners.call ([&](ClipDescriptor::Listener& l) { l.processorControllerAdded(); } );
 }
@@ -302,14 +363,16 @@ void ClipDescriptor::addAudioProcessor (std::unique_ptr<juce::AudioProcessor> pr
 
 void ClipDescriptor::removeAudioProcessor (int index)
 {
-    const auto& toBeRemoved = std::next (audioProcessors.begin(), index);
-    if (toBeRemoved == audioProcessors.end())
+    auto chain = *getAudioProcessors();
+    if (! juce::isPositiveAndBelow (index, chain.size()))
         return;
 
+    const auto toBeRemoved = std::next (chain.begin(), index);
+
     listeners.call ([&](ClipDescriptor::Listener& l) { l.processorControllerToBeDeleted (toBeRemoved->get()); } );
 
-    juce::ScopedLock sl (owner.getCallbackLock());
-    audioProcessors.erase (toBeRemoved);
+    chain.erase (toBeRemoved);
+    publishChain (audioProcessors, std::move (chain));
 }
 
 void ClipDescriptor::addVideoProcessor (std::unique_ptr<ProcessorController> controller, int index)
@@ -321,13 +384,13 @@ void ClipDescriptor::addVideoProcessor (std::unique_ptr<ProcessorController> con
         processorsNode.addChild (controller->getProcessorState(), index, undoManager);
     }
 
-    {
-        juce::ScopedLock sl (owner.getCallbackLock());
-        if (juce::isPositiveAndBelow (index, videoProcessors.size()))
-            videoProcessors.insert (std::next (videoProcessors.begin(), index), std::move (controller));
-        else
-            videoProcessors.push_back (std::move (controller));
-    }
+    auto chain = *getVideoProcessors();
+    if (juce::isPositiveAndBelow (index, chain.size()))
+        chain.insert (std::next (chain.begin(), index), std::move (controller));
+    else
+        chain.push_back (std::move (controller));
+
+    publishChain (videoProcessors, std::move (chain));
 
     listeners.call ([&](ClipDescriptor::Listener& l) { l.processorControllerAdded(); } );
 }
@@ -339,10 +402,12 @@ void ClipDescriptor::addVideoProcessor (std::unique_ptr<VideoProcessor> processo
 
 void ClipDescriptor::removeVideoProcessor (int index)
 {
-    const auto& toBeRemoved = std::next (videoProcessors.begin(), index);
-    if (toBeRemoved == videoProcessors.end() || manualStateChange)
+    auto chain = *getVideoProcessors();
+    if (! juce::isPositiveAndBelow (index, chain.size()) || manualStateChange)
         return;
 
+    const auto toBeRemoved = std::next (chain.begin(), index);
+
     juce::ScopedValueSetter<bool> manual (manualStateChange, true);
 
     listeners.call ([&](ClipDescriptor::Listener& l) { l.processorControllerToBeDeleted (toBeRemoved->get()); } );
@@ -350,61 +415,45 @@ void ClipDescriptor::removeVideoProcessor (int index)
     auto processorsNode = state.getOrCreateChildWithName (IDs::videoProcessors, undoManager);
     processorsNode.removeChild (index, undoManager);
 
-    juce::ScopedLock sl (owner.getCallbackLock());
-    videoProcessors.erase (toBeRemoved);
+    chain.erase (toBeRemoved);
+    publishChain (videoProcessors, std::move (chain));
 }
 
 void ClipDescriptor::removeProcessor (ProcessorController* controller)
 {
-    const auto& videoToBeRemoved = std::find_if (videoProcessors.begin(),
-                                                 videoProcessors.end(),
-                                                 [controller](const auto& p){ return p.get() == controller; });
-    if (videoToBeRemoved != videoProcessors.end())
+    auto removeFrom = [&] (std::shared_ptr<const ProcessorChain>& current, const juce::Identifier& nodeType)
     {
-        listeners.call ([&](ClipDescriptor::Listener& l) { l.processorControllerToBeDeleted (videoToBeRemoved->get()); } );
+        auto chain = *std::atomic_load (&current);
+        const auto toBeRemoved = std::find_if (chain.begin(), chain.end(),
+                                               [controller](const auto& p){ return p.get() == controller; });
+        if (toBeRemoved == chain.end())
+            return false;
 
-        auto index = std::distance (videoProcessors.begin(), videoToBeRemoved);
-        if (!manualStateChange)
-        {
-            juce::ScopedValueSetter<bool> manual (manualStateChange, true);
-            auto processorsNode = state.getOrCreateChildWithName (IDs::videoProcessors, undoManager);
-            processorsNode.removeChild (int (index), undoManager);
-        }
-
-        juce::ScopedLock sl (owner.getCallbackLock());
-        videoProcessors.erase (videoToBeRemoved);
+        listeners.call ([&](ClipDescriptor::Listener& l) { l.processorControllerToBeDeleted (toBeRemoved->get()); } );
 
-        return;
-    }
-
-    const auto& audioToBeRemoved = std::find_if (audioProcessors.begin(),
-                                                 audioProcessors.end(),
-                                                 [controller](const auto& p){ return p.get() == controller; });
-    if (audioToBeRemoved != audioProcessors.end())
-    {
-        listeners.call ([&](ClipDescriptor::Listener& l) { l.processorControllerToBeDeleted (audioToBeRemoved->get()); } );
-
-        auto index = std::distance (audioProcessors.begin(), audioToBeRemoved);
+        auto index = std::distance (chain.begin(), toBeRemoved);
         if (!manualStateChange)
         {
             juce::ScopedValueSetter<bool> manual (manualStateChange, true);
-            auto processorsNode = state.getOrCreateChildWithName (IDs::audioProcessors, undoManager);
+            auto processorsNode = state.getOrCreateChildWithName (nodeType, undoManager);
             processorsNode.removeChild (int (index), undoManager);
         }
 
-        juce::ScopedLock sl (owner.getCallbackLock());
-        audioProcessors.erase (audioToBeRemoved);
-        return;
-    }
+        chain.erase (toBeRemoved);
+        publishChain (current, std::move (chain));
+        return true;
+    };
 
+    if (! removeFrom (videoProcessors, IDs::videoProcessors))
+        removeFrom (audioProcessors, IDs::audioProcessors);
 }
 
 void ClipDescriptor::readPluginStatesIntoValueTree()
 {
-    for (auto& processor : audioProcessors)
+    for (auto& processor : *getAudioProcessors())
         processor->readPluginStatesIntoValueTree();
 
-    for (auto& processor : videoProcessors)
+    for (auto& processor : *getVideoProcessors())
         processor->readPluginStatesIntoValueTree();
 }
 
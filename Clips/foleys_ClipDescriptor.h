@@ -24,6 +24,7 @@ namespace foleys
 {
 
 class ComposedClip;
+class AudioFreezer;
 
 /**
  @class ClipDescriptor
@@ -94,6 +95,26 @@ public:
     void setAudioPlaying (bool shouldPlay);
     bool getAudioPlaying() const;
 
+    /** Routes the audio to a bus of the DefaultAudioMixer, 0 for the master bus */
+    void setAudioBus (int bus);
+    int getAudioBus() const;
+
+    /** Renders the audio including the AudioProcessors into a file and plays that instead
+        of the processors, see AudioFreezer */
+    void setAudioFrozen (bool shouldBeFrozen);
+    bool isAudioFrozen() const;
+
+    AudioFreezer& getAudioFreezer();
+
+    /** Positions the clip and its frozen audio. Use this instead of calling setNextReadPosition()
+        on the clip directly, the position is in the clip's time like AVClip::setNextReadPosition() */
+    void setClipReadPosition (int64_t samples);
+
+    /** Sets the ReadAheadState this descriptor needs and the state of its frozen audio. Several descriptors
+        can share a clip, so the ComposedClip passes the most urgent of their states on to the clip */
+    void setClipReadAheadState (ReadAheadState readAheadState);
+    ReadAheadState getClipReadAheadState() const;
+
     /** Transforms a time relative to the containing clip into a local time in ClipDescriptor. */
     double getClipTimeInDescriptorTime (double time) const;
 
@@ -111,13 +132,21 @@ public:
     ClipParameterController& getAudioParameterController();
     ClipParameterController& getVideoParameterController();
 
+    /**
+     An immutable list of processors. Adding or removing a processor publishes a new chain,
+     so the render threads never wait for an edit. Old chains are released by the VideoEngine,
+     once no thread uses them anymore.
+     */
+    using ProcessorChain = std::vector<std::shared_ptr<ProcessorController>>;
+
     void addProcessor (juce::ValueTree tree, int index = -1);
 
     void addAudioProcessor (std::unique_ptr<ProcessorController> controller, int index=-1);
     void addAudioProcessor (std::unique_ptr<juce::AudioProcessor> processor, int index=-1);
     void removeAudioProcessor (int index);
 
-    const std::vector<std::unique_ptr<ProcessorController>>& getAudioProcessors() const;
+    /** Returns the current chain. Keep the pointer while processing, the chain won't change */
+    std::shared_ptr<const ProcessorChain> getAudioProcessors() const;
 
     void addVideoProcessor (std::unique_ptr<ProcessorController> controller, int index=-1);
     void addVideoProcessor (std::unique_ptr<VideoProcessor> processor, int index=-1);
@@ -125,7 +154,8 @@ public:
 
     void removeProcessor (ProcessorController* controller);
 
-    const std::vector<std::unique_ptr<ProcessorController>>& getVideoProcessors() const;
+    /** Returns the current chain. Keep the pointer while processing, the chain won't change */
+    std::shared_ptr<const ProcessorChain> getVideoProcessors() const;
 
     ComposedClip& getOwningClip();
     const ComposedClip& getOwningClip() const;
@@ -200,6 +230,19 @@ private:
     std::atomic<int64_t> lengthSamples  = 0;
     std::atomic<int64_t> offsetSamples  = 0;
 
+    /** Tracks, if the clip was positioned for its place in the timeline. The ComposedClip
+        seeks the clip ahead of its start time, so it can read ahead in time */
+    enum class PreRollState
+    {
+        Required = 0,   /**< The clip's read position doesn't match the timeline */
+        Requested,      /**< The audio thread asked for a pre-roll */
+        Scheduled,      /**< A job was scheduled to seek the clip */
+        Ready           /**< The clip is positioned and can read ahead */
+    };
+
+    std::atomic<PreRollState> preRollState { PreRollState::Required };
+    std::atomic<ReadAheadState> clipReadAheadState { ReadAheadState::Playing };
+
     void valueTreePropertyChanged (juce::ValueTree& treeWhosePropertyHasChanged,
                                    const juce::Identifier& property) override;
 
@@ -222,8 +265,13 @@ private:
 
     juce::ListenerList<Listener> listeners;
 
-    std::vector<std::unique_ptr<ProcessorController>> videoProcessors;
-    std::vector<std::unique_ptr<ProcessorController>> audioProcessors;
+    /** Swaps in the new chain and hands the previous one to the VideoEngine to be released off the realtime threads */
+    void publishChain (std::shared_ptr<const ProcessorChain>& chain, ProcessorChain newChain);
+
+    std::shared_ptr<const ProcessorChain> videoProcessors { std::make_shared<const ProcessorChain>() };
+    std::shared_ptr<const ProcessorChain> audioProcessors { std::make_shared<const ProcessorChain>() };
+
+    std::unique_ptr<AudioFreezer> freezer;
 
     friend ComposedClip;
 
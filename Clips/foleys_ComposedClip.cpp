@@ -34,6 +34,8 @@ namespace IDs
     static juce::Identifier offset       { "offset" };
     static juce::Identifier visible      { "visible" };
     static juce::Identifier audio        { "audio" };
+    static juce::Identifier audioBus     { "audioBus" };
+    static juce::Identifier frozenAudio  { "frozenAudio" };
     static juce::Identifier state        { "state" };
     static juce::Identifier audioProcessors { "AudioProcessors" };
     static juce::Identifier videoProcessors { "VideoProcessors" };
@@ -48,7 +50,8 @@ ComposedClip::ComposedClip (VideoEngine& engine)
     videoSettings.timebase = 24000;
     videoSettings.defaultDuration = 1001;
 
-    audioMixer = std::make_unique<DefaultAudioMixer>();
+    audioMixer = std::make_shared<DefaultAudioMixer>();
+    clipSnapshot = std::make_shared<ClipSnapshot>();
 
     state.addListener (this);
 }
@@ -74,6 +77,8 @@ std::shared_ptr<ClipDescriptor> ComposedClip::addClip (std::shared_ptr<AVClip> c
 {
     auto clipDescriptor = std::make_shared<ClipDescriptor> (*this, clip, getUndoManager());
     clip->prepareToPlay (audioSettings.defaultNumSamples, audioSettings.timebase);
+    clip->setPlanarFramesEnabled (planarFrames.load());
+    clip->setOfflineMode (offline.load());
 
     clipDescriptor->setDescription (makeUniqueDescription (clip->getDescription()));
     clipDescriptor->setStart (pos.start);
@@ -93,6 +98,8 @@ std::shared_ptr<ClipDescriptor> ComposedClip::addClip (std::shared_ptr<AVClip> c
             clips.insert (std::next (clips.begin(), zPosition), clipDescriptor);
         else
             clips.push_back (clipDescriptor);
+
+        publishClips();
     }
 
     return clipDescriptor;
@@ -102,9 +109,14 @@ void ComposedClip::removeClip (std::shared_ptr<ClipDescriptor> descriptor)
 {
     descriptor->getVideoParameterController().removeListener (this);
 
-    auto it = std::find (clips.begin(), clips.end(), descriptor);
-    if (it != clips.end())
-        clips.erase (it);
+    {
+        juce::ScopedLock sl (clipDescriptorLock);
+        auto it = std::find (clips.begin(), clips.end(), descriptor);
+        if (it != clips.end())
+            clips.erase (it);
+
+        publishClips();
+    }
 
     state.removeChild (descriptor->getStatusTree(), getUndoManager());
 }
@@ -137,6 +149,14 @@ VideoFrame& ComposedClip::getFrame (double pts)
 {
     auto nextTimeCode = convertTimecode (pts, videoSettings);
 
+    if (planarFrames.load() && composeYUV (pts))
+    {
+        frame.timecode = nextTimeCode;
+        return frame;
+    }
+
+    frame.yuv.reset();
+
     if (frame.image.getWidth() != videoSettings.frameSize.width || frame.image.getHeight() != videoSettings.frameSize.height)
         frame.image = juce::Image (juce::Image::ARGB, videoSettings.frameSize.width, videoSettings.frameSize.height, true);
     else
@@ -152,6 +172,82 @@ VideoFrame& ComposedClip::getFrame (double pts)
     return frame;
 }
 
+bool ComposedClip::composeYUV (double pts)
+{
+    FOLEYS_PERFORMANCE_SOURCE (getPerformanceCounters());
+    FOLEYS_MEASURE_STAGE (Compose);
+
+    struct Layer
+    {
+        std::shared_ptr<YUVFrame> yuv;
+        float alpha = 1.0f;
+    };
+
+    std::vector<Layer> layers;
+    frame.yuv.reset();
+
+    for (auto& clip : getClips())
+    {
+        if (! clip->clip->hasVideo() || ! juce::isPositiveAndBelow (pts - clip->getStart(), clip->getLength()))
+            continue;
+
+        auto localPts = clip->getClipTimeInDescriptorTime (pts);
+        clip->updateVideoAutomations (localPts);
+
+        auto& controller = clip->getVideoParameterController();
+        const auto alpha = float (controller.getValueAtTime (IDs::alpha, localPts, 1.0));
+
+        if (! clip->getVideoProcessors()->empty()
+            || controller.getValueAtTime (IDs::zoom, localPts, 100.0) != 100.0
+            || controller.getValueAtTime (IDs::translateX, localPts, 0.0) != 0.0
+            || controller.getValueAtTime (IDs::translateY, localPts, 0.0) != 0.0
+            || controller.getValueAtTime (IDs::rotation, localPts, 0.0) != 0.0)
+            return false;
+
+        if (alpha <= 0.0f)
+            continue;
+
+        auto source = clip->clip->getFrame (localPts).yuv;
+        if (source == nullptr
+            || source->size.width != videoSettings.frameSize.width
+            || source->size.height != videoSettings.frameSize.height)
+            return false;
+
+        layers.push_back ({ source, alpha });
+    }
+
+    // a single opaque layer goes straight to the encoder
+    if (layers.size() == 1 && layers.front().alpha >= 1.0f)
+    {
+        frame.yuv = layers.front().yuv;
+        return true;
+    }
+
+    // the writer might still hold the last frame
+    if (yuvBuffer == nullptr || yuvBuffer.use_count() > 1
+        || yuvBuffer->size.width != videoSettings.frameSize.width
+        || yuvBuffer->size.height != videoSettings.frameSize.height)
+        yuvBuffer = YUVFrame::create (videoSettings.frameSize);
+
+    // layers below the topmost opaque one are hidden
+    auto first = std::find_if (layers.rbegin(), layers.rend(), [](const auto& layer) { return layer.alpha >= 1.0f; });
+    if (first != layers.rend())
+    {
+        yuvBuffer->copyFrom (*first->yuv);
+        for (auto it = first.base(); it != layers.end(); ++it)
+            yuvBuffer->blend (*it->yuv, it->alpha);
+    }
+    else
+    {
+        yuvBuffer->clear();
+        for (auto& layer : layers)
+            yuvBuffer->blend (*layer.yuv, layer.alpha);
+    }
+
+    frame.yuv = yuvBuffer;
+    return true;
+}
+
 Size ComposedClip::getVideoSize() const
 {
     return videoSettings.frameSize;
@@ -159,7 +255,7 @@ Size ComposedClip::getVideoSize() const
 
 double ComposedClip::getCurrentTimeInSeconds() const
 {
-    return convertToSeconds (position.load());
+    return convertToSeconds (position->load());
 }
 
 juce::Image ComposedClip::getStillImage ([[maybe_unused]]double seconds, [[maybe_unused]]Size size)
@@ -170,6 +266,9 @@ juce::Image ComposedClip::getStillImage ([[maybe_unused]]double seconds, [[maybe
 
 void ComposedClip::render (juce::Graphics& view, juce::Rectangle<float> area, double pts, float, float, juce::Point<float>, float alphaExtern)
 {
+    FOLEYS_PERFORMANCE_SOURCE (getPerformanceCounters());
+    FOLEYS_MEASURE_STAGE (Compose);
+
     auto active = getClips();
 
     for (auto clip : active)
@@ -224,7 +323,10 @@ void ComposedClip::prepareToPlay (int samplesPerBlockExpected, double sampleRate
     audioSettings.timebase = juce::roundToInt (sampleRateToUse);
     audioSettings.defaultNumSamples = samplesPerBlockExpected;
 
-    audioMixer->setup (audioSettings.numChannels, audioSettings.timebase, audioSettings.defaultNumSamples);
+    getAudioMixer().setup (audioSettings.numChannels, audioSettings.timebase, audioSettings.defaultNumSamples);
+
+    if (auto meter = getLoudnessMeter())
+        meter->prepare (audioSettings.timebase, audioSettings.numChannels);
 
     for (auto& descriptor : getClips())
     {
@@ -241,36 +343,55 @@ void ComposedClip::releaseResources()
 
 void ComposedClip::getNextAudioBlock (const juce::AudioSourceChannelInfo& info)
 {
+    FOLEYS_PERFORMANCE_SOURCE (getPerformanceCounters());
+    FOLEYS_MEASURE_STAGE (Compose);
+
     info.clearActiveBufferRegion();
-    auto pos = position.load();
+    auto pos = position->load();
 
-    auto active = getClips();
-    active.erase (std::remove_if (active.begin(), active.end(),
-                                  [pos](auto& clip)
-                                  {
-        return ! clip->clip->hasAudio() || ! juce::isPositiveAndBelow (pos - clip->getStartInSamples(), clip->getLengthInSamples());
-    }), active.end());
+    // the snapshot avoids waiting for the clipDescriptorLock on the audio thread. Holding it keeps the
+    // engine from releasing it, so no descriptor is destroyed here
+    auto snapshot = std::atomic_load (&clipSnapshot);
+    updateReadAheadStates (snapshot->clips, pos);
+
+    // clips starting within the block are mixed from their start, which matters for large offline blocks
+    auto& active = snapshot->active;
+    active.clear();
+    for (const auto& descriptor : snapshot->clips)
+        if (descriptor->clip->hasAudio() && isPlayingInBlock (*descriptor, pos, info.numSamples))
+            active.push_back (descriptor);
 
-    audioMixer->mixAudio (info,
-                          position.load(),
-                          getCurrentTimeInSeconds(),
-                          active);
+    // the reference keeps a replaced mixer alive until this block is mixed
+    auto mixer = std::atomic_load (&audioMixer);
+    mixer->mixAudio (info,
+                     position->load(),
+                     getCurrentTimeInSeconds(),
+                     active);
 
-    position.fetch_add (info.numSamples);
+    active.clear();
+
+    if (auto meter = getLoudnessMeter())
+        meter->process (*info.buffer, info.startSample, info.numSamples);
+
+    position->fetch_add (info.numSamples);
     triggerAsyncUpdate();
 }
 
 bool ComposedClip::waitForSamplesReady (int samples, int timeout)
 {
+    // offline the clips read synchronously, so there is no time limit
+    if (offline.load())
+        timeout = std::numeric_limits<int>::max();
+
     auto ready = true;
     const auto start = juce::Time::getMillisecondCounter();
-    const auto pos = position.load();
+    const auto pos = position->load();
 
     auto active = getClips();
     active.erase (std::remove_if (active.begin(), active.end(),
-                                  [pos](auto& clip)
+                                  [pos, samples](auto& clip)
                                   {
-        return ! clip->clip->hasAudio() || ! juce::isPositiveAndBelow (pos - clip->getStartInSamples(), clip->getLengthInSamples());
+        return ! clip->clip->hasAudio() || ! isPlayingInBlock (*clip, pos, samples);
     }), active.end());
 
     for (auto clip : active)
@@ -285,9 +406,28 @@ bool ComposedClip::waitForSamplesReady (int samples, int timeout)
 
 void ComposedClip::setNextReadPosition (juce::int64 samples)
 {
-    position.store (samples);
-    for (auto& descriptor : getClips())
-        descriptor->clip->setNextReadPosition (std::max (juce::int64 (samples + descriptor->getOffsetInSamples() - descriptor->getStartInSamples()), juce::int64 (descriptor->getOffsetInSamples())));
+    position->store (samples);
+
+    const auto descriptors = getClips();
+    const auto preRoll     = getPreRollSamples();
+
+    // only clips that play now or soon are seeked, the others are pre-rolled when they are about to start
+    for (auto& descriptor : descriptors)
+    {
+        const auto start = descriptor->getStartInSamples();
+
+        if (samples < start + descriptor->getLengthInSamples() && start - samples < preRoll)
+        {
+            descriptor->setClipReadPosition (std::max (juce::int64 (samples + descriptor->getOffsetInSamples() - start), juce::int64 (descriptor->getOffsetInSamples())));
+            descriptor->preRollState = ClipDescriptor::PreRollState::Ready;
+        }
+        else
+        {
+            descriptor->preRollState = ClipDescriptor::PreRollState::Required;
+        }
+    }
+
+    updateReadAheadStates (descriptors, samples);
 
     lastShownFrame = 0;
 
@@ -296,7 +436,7 @@ void ComposedClip::setNextReadPosition (juce::int64 samples)
 
 juce::int64 ComposedClip::getNextReadPosition() const
 {
-    return position;
+    return position->load();
 }
 
 juce::int64 ComposedClip::getTotalLength() const
@@ -341,13 +481,47 @@ void ComposedClip::parameterAutomationChanged (const ParameterAutomation*)
     invalidateVideo();
 }
 
-std::shared_ptr<AVClip> ComposedClip::createCopy (StreamTypes)
+void ComposedClip::setPlanarFramesEnabled (bool shouldProvideYUV)
+{
+    planarFrames.store (shouldProvideYUV);
+
+    for (auto& descriptor : getClips())
+        descriptor->clip->setPlanarFramesEnabled (shouldProvideYUV);
+
+    if (! shouldProvideYUV)
+    {
+        frame.yuv.reset();
+        yuvBuffer.reset();
+    }
+}
+
+void ComposedClip::setOfflineMode (bool shouldRenderOffline)
+{
+    offline.store (shouldRenderOffline);
+
+    for (auto& descriptor : getClips())
+        descriptor->clip->setOfflineMode (shouldRenderOffline);
+}
+
+bool ComposedClip::isOfflineMode() const
+{
+    return offline.load();
+}
+
+bool ComposedClip::hasOfflineReadFailed() const
+{
+    const auto descriptors = getClips();
+    return std::any_of (descriptors.begin(), descriptors.end(), [] (const auto& descriptor) { return descriptor->clip->hasOfflineReadFailed(); });
+}
+
+std::shared_ptr<AVClip> ComposedClip::createCopy (StreamTypes types)
 {
     auto* engine = getVideoEngine();
     if (engine == nullptr)
         return {};
 
     auto clipCopy = std::make_shared<ComposedClip>(*engine);
+    clipCopy->streamTypes = types;
     engine->manageLifeTime (clipCopy);
 
     for (auto clip : getStatusTree())
@@ -356,6 +530,11 @@ std::shared_ptr<AVClip> ComposedClip::createCopy (StreamTypes)
     return clipCopy;
 }
 
+StreamTypes ComposedClip::getStreamTypes() const
+{
+    return streamTypes;
+}
+
 double ComposedClip::getSampleRate() const
 {
     return audioSettings.timebase;
@@ -366,6 +545,49 @@ int ComposedClip::getDefaultBufferSize() const
     return audioSettings.defaultNumSamples;
 }
 
+void ComposedClip::setAudioMixer (std::unique_ptr<AudioMixer> mixer)
+{
+    jassert (mixer != nullptr);
+
+    if (audioSettings.timebase > 0)
+        mixer->setup (audioSettings.numChannels, audioSettings.timebase, audioSettings.defaultNumSamples);
+
+    std::shared_ptr<AudioMixer> previous = std::atomic_exchange (&audioMixer, std::shared_ptr<AudioMixer> (std::move (mixer)));
+
+    // the audio thread might still be mixing with the previous mixer
+    if (auto* engine = getVideoEngine())
+        engine->releaseWhenUnused (std::move (previous));
+}
+
+AudioMixer& ComposedClip::getAudioMixer()
+{
+    return *std::atomic_load (&audioMixer);
+}
+
+void ComposedClip::setLoudnessMeter (std::shared_ptr<LoudnessMeter> meter)
+{
+    if (meter != nullptr && audioSettings.timebase > 0)
+        meter->prepare (audioSettings.timebase, audioSettings.numChannels);
+
+    std::atomic_store (&loudnessMeter, std::move (meter));
+}
+
+std::shared_ptr<LoudnessMeter> ComposedClip::getLoudnessMeter() const
+{
+    return std::atomic_load (&loudnessMeter);
+}
+
+void ComposedClip::setNumChannels (int numChannels)
+{
+    jassert (numChannels > 0);
+    audioSettings.numChannels = numChannels;
+}
+
+int ComposedClip::getNumChannels() const
+{
+    return audioSettings.numChannels;
+}
+
 void ComposedClip::handleAsyncUpdate()
 {
     if (audioSettings.timebase > 0)
@@ -382,6 +604,136 @@ void ComposedClip::handleAsyncUpdate()
         for (auto clip : clips)
             clip->triggerTimecodeUpdate (juce::sendNotificationSync);
     }
+
+    schedulePreRolls();
+}
+
+void ComposedClip::setPreRollTime (double seconds)
+{
+    preRollTime.store (std::max (0.0, seconds));
+}
+
+double ComposedClip::getPreRollTime() const
+{
+    return preRollTime.load();
+}
+
+void ComposedClip::updateReadAheadStates (const std::vector<std::shared_ptr<ClipDescriptor>>& descriptors, int64_t pos)
+{
+    const auto preRoll = getPreRollSamples();
+    auto needsPreRoll  = false;
+
+    for (const auto& descriptor : descriptors)
+    {
+        const auto start    = descriptor->getStartInSamples();
+        const auto isActive = juce::isPositiveAndBelow (pos - start, descriptor->getLengthInSamples());
+
+        if (isActive || juce::isPositiveAndBelow (start - pos, preRoll))
+        {
+            auto expected = ClipDescriptor::PreRollState::Required;
+            if (offline.load())
+            {
+                if (descriptor->preRollState.compare_exchange_strong (expected, ClipDescriptor::PreRollState::Ready))
+                    descriptor->setClipReadPosition (std::max (pos + descriptor->getOffsetInSamples() - start,
+                                                                     descriptor->getOffsetInSamples()));
+            }
+            else if (descriptor->preRollState.compare_exchange_strong (expected, ClipDescriptor::PreRollState::Requested))
+            {
+                needsPreRoll = true;
+            }
+
+            const auto ready = descriptor->preRollState.load() == ClipDescriptor::PreRollState::Ready;
+
+            if (isActive)
+                descriptor->setClipReadAheadState (ReadAheadState::Playing);
+            else
+                descriptor->setClipReadAheadState (ready ? ReadAheadState::Upcoming : ReadAheadState::Suspended);
+        }
+        else if (pos >= start + descriptor->getLengthInSamples())
+        {
+            // the clip finished, it needs to be positioned again when it is needed
+            descriptor->preRollState = ClipDescriptor::PreRollState::Required;
+            descriptor->setClipReadAheadState (ReadAheadState::Suspended);
+        }
+        else
+        {
+            const auto ready = descriptor->preRollState.load() == ClipDescriptor::PreRollState::Ready;
+            descriptor->setClipReadAheadState (ready ? ReadAheadState::Idle : ReadAheadState::Suspended);
+        }
+    }
+
+    // several descriptors can share a clip, it reads ahead for the one that needs it most urgently
+    for (size_t i = 0; i < descriptors.size(); ++i)
+    {
+        auto* clip = descriptors [i]->clip.get();
+        auto state = descriptors [i]->getClipReadAheadState();
+        auto applied = false;
+
+        for (size_t j = 0; j < descriptors.size() && ! applied; ++j)
+        {
+            if (j == i || descriptors [j]->clip.get() != clip)
+                continue;
+
+            if (j < i)
+                applied = true;
+            else
+                state = std::min (state, descriptors [j]->getClipReadAheadState());
+        }
+
+        if (! applied)
+            clip->setReadAheadState (state);
+    }
+
+    if (needsPreRoll)
+        triggerAsyncUpdate();
+}
+
+int64_t ComposedClip::getPreRollSamples() const
+{
+    const auto preRoll = int64_t (preRollTime.load() * audioSettings.timebase);
+
+    // a clip starting within the block must be positioned before the block is rendered
+    if (offline.load())
+        return std::max (preRoll, int64_t (audioSettings.defaultNumSamples));
+
+    return preRoll;
+}
+
+bool ComposedClip::isPlayingInBlock (const ClipDescriptor& descriptor, int64_t pos, int numSamples)
+{
+    const auto start = descriptor.getStartInSamples();
+    return start < pos + numSamples && pos < start + descriptor.getLengthInSamples();
+}
+
+void ComposedClip::schedulePreRolls()
+{
+    auto* engine = getVideoEngine();
+    if (engine == nullptr)
+        return;
+
+    for (auto& descriptor : getClips())
+    {
+        auto expected = ClipDescriptor::PreRollState::Requested;
+        if (! descriptor->preRollState.compare_exchange_strong (expected, ClipDescriptor::PreRollState::Scheduled))
+            continue;
+
+        // the job shares the position, so it can outlive this clip
+        engine->addJob ([playhead = position, weak = std::weak_ptr<ClipDescriptor> (descriptor)]
+        {
+            if (auto locked = weak.lock())
+            {
+                // the playhead moved on since the pre-roll was requested, so the target is taken now
+                const auto target = std::max (playhead->load() + locked->getOffsetInSamples() - locked->getStartInSamples(),
+                                              locked->getOffsetInSamples());
+
+                locked->setClipReadPosition (target);
+
+                // if the timeline was changed meanwhile, the state is Required again and the clip will be seeked again
+                auto scheduled = ClipDescriptor::PreRollState::Scheduled;
+                locked->preRollState.compare_exchange_strong (scheduled, ClipDescriptor::PreRollState::Ready);
+            }
+        });
+    }
 }
 
 double ComposedClip::convertToSeconds (int64_t pos) const
@@ -408,6 +760,8 @@ void ComposedClip::valueTreeChildAdded (juce::ValueTree&, juce::ValueTree& child
         if (descriptor->clip != nullptr)
         {
             descriptor->clip->prepareToPlay (getDefaultBufferSize(), getSampleRate());
+            descriptor->clip->setPlanarFramesEnabled (planarFrames.load());
+            descriptor->clip->setOfflineMode (offline.load());
             descriptor->updateSampleCounts();
             descriptor->getVideoParameterController().addListener (this);
 
@@ -418,6 +772,8 @@ void ComposedClip::valueTreeChildAdded (juce::ValueTree&, juce::ValueTree& child
                 clips.insert (clips.begin() + index, descriptor);
             else
                 clips.push_back (descriptor);
+
+            publishClips();
         }
     }
 }
@@ -436,6 +792,7 @@ void ComposedClip::valueTreeChildRemoved (juce::ValueTree&, juce::ValueTree& chi
             {
                 (*it)->getVideoParameterController().removeListener (this);
                 clips.erase (it);
+                publishClips();
                 return;
             }
         }
@@ -452,6 +809,7 @@ void ComposedClip::valueTreeChildOrderChanged (juce::ValueTree&, int oldIndex, i
     auto element = *oldIt;
     clips.erase (oldIt);
     clips.insert (clips.begin() + newIndex, element);
+    publishClips();
 }
 
 juce::UndoManager* ComposedClip::getUndoManager()
@@ -480,6 +838,19 @@ std::vector<std::shared_ptr<ClipDescriptor>> ComposedClip::getClips() const
     return clips;
 }
 
+void ComposedClip::publishClips()
+{
+    auto snapshot = std::make_shared<ClipSnapshot>();
+    snapshot->clips = clips;
+    snapshot->active.reserve (clips.size());
+
+    auto previous = std::atomic_exchange (&clipSnapshot, std::move (snapshot));
+
+    // removed descriptors must not be destroyed on the audio thread
+    if (auto* engine = getVideoEngine())
+        engine->releaseWhenUnused (std::move (previous));
+}
+
 juce::String ComposedClip::makeUniqueDescription (const juce::String& description) const
 {
     int suffix = 0;
@@ -34,7 +34,7 @@ namespace foleys
 
  When you created a shared_ptr of an ComposedClip, call manageLifeTime() on the
  VideoEngine, that will add it to the auto release pool and register possible
- background jobs with the TimeSliceThreads.
+ background jobs with the ReaderScheduler.
  */
 class ComposedClip  : public AVClip,
                       private ControllableBase::Listener,
@@ -94,6 +94,26 @@ public:
 
     std::shared_ptr<AVClip> createCopy (StreamTypes types) override;
 
+    /** The streams the clips are loaded with. A copy made with createCopy (StreamTypes::audio())
+        loads its clips without video, e.g. to render only the audio */
+    StreamTypes getStreamTypes() const;
+
+    /**
+     With planar frames enabled, getFrame() composes in YUV, as long as all visible clips
+     deliver YUVFrames in the size of this clip and are neither moved, zoomed nor rotated.
+     A single opaque clip is passed through, fades and opacity are blended. Otherwise the
+     frame is rendered into the image as usual.
+     */
+    void setPlanarFramesEnabled (bool shouldProvideYUV) override;
+
+    /**
+     Switches all clips into offline mode. Clips are then positioned synchronously when they are
+     about to start, instead of pre-rolling them on the VideoEngine's thread pool.
+     */
+    void setOfflineMode (bool shouldRenderOffline) override;
+    bool isOfflineMode() const override;
+    bool hasOfflineReadFailed() const override;
+
     double getSampleRate() const override;
 
     /** When rendering non realtime (bounce), use this to wait for background
@@ -102,6 +122,19 @@ public:
 
     int getDefaultBufferSize() const;
 
+    /** Replace the mixer, that sums the audio of the clips. The default is a DefaultAudioMixer */
+    void setAudioMixer (std::unique_ptr<AudioMixer> mixer);
+    AudioMixer& getAudioMixer();
+
+    /** Measures the loudness of the mixed audio. The meter is prepared with the sample rate and channels
+        of this clip, nullptr removes the meter */
+    void setLoudnessMeter (std::shared_ptr<LoudnessMeter> meter);
+    std::shared_ptr<LoudnessMeter> getLoudnessMeter() const;
+
+    /** Set the number of channels to mix into, e.g. 6 for a 5.1 deliverable. Call prepareToPlay afterwards */
+    void setNumChannels (int numChannels);
+    int getNumChannels() const;
+
     /** Read all plugins getStateInformation() and save it into the statusTree as BLOB */
     void readPluginStatesIntoValueTree();
 
@@ -143,19 +176,53 @@ public:
 
     juce::UndoManager* getUndoManager();
 
-    /** This lock is used, when the vector of clips is changed, or when a clip is altered
-        in a way, that it cannot render correctly, e.g. when adding or removing an audio plugin */
+    /** This lock is used, when the vector of clips is changed. The mixer and the processor
+        chains of the clips are swapped without locking, see ClipDescriptor::ProcessorChain */
     juce::CriticalSection& getCallbackLock() { return clipDescriptorLock; }
 
     /** Create a unique description by appending or incrementing a number */
     juce::String makeUniqueDescription (const juce::String& description) const;
 
+    /** Set the time in seconds, how long before their start clips are positioned and start to read ahead.
+        Clips that finished playing are suspended until they are needed again. */
+    void setPreRollTime (double seconds);
+    double getPreRollTime() const;
+
 private:
 
     void handleAsyncUpdate() override;
 
     double convertToSeconds (int64_t pos) const;
 
+    /** Marks the clips as playing, upcoming or idle, so the BufferingManager can distribute the read ahead memory.
+        Clips within the pre-roll time that are not positioned yet get a pre-roll requested, or are positioned right away in offline mode. */
+    void updateReadAheadStates (const std::vector<std::shared_ptr<ClipDescriptor>>& descriptors, int64_t pos);
+
+    /** Seeks the clips, that requested a pre-roll, on the VideoEngine's thread pool */
+    void schedulePreRolls();
+
+    /** The number of samples before their start, when clips are positioned. Offline this covers at least a block */
+    int64_t getPreRollSamples() const;
+
+    /** Returns true, if the clip plays within the block of numSamples starting at pos */
+    static bool isPlayingInBlock (const ClipDescriptor& descriptor, int64_t pos, int numSamples);
+
+    /** Publishes a copy of the clips for the audio thread. Call this with the clipDescriptorLock held */
+    void publishClips();
+
+    /**
+     The clips as seen by the audio thread. active is the audio thread's list of the clips playing
+     in the current block, it is reserved for all clips, so filtering them doesn't allocate.
+     */
+    struct ClipSnapshot
+    {
+        std::vector<std::shared_ptr<ClipDescriptor>> clips;
+        std::vector<std::shared_ptr<ClipDescriptor>> active;
+    };
+
+    /** Composes the frame in YUV into frame.yuv. Returns false, if the frame needs to be rendered in RGB */
+    bool composeYUV (double pts);
+
     juce::CriticalSection clipDescriptorLock;
 
     juce::ValueTree state;
@@ -164,12 +231,24 @@ private:
     AudioStreamSettings audioSettings;
     VideoStreamSettings videoSettings;
 
-    std::unique_ptr<AudioMixer> audioMixer;
+    std::shared_ptr<AudioMixer> audioMixer;
+    std::shared_ptr<LoudnessMeter> loudnessMeter;
 
     std::vector<std::shared_ptr<ClipDescriptor>> clips;
-    std::atomic<int64_t> position = {};
+    std::shared_ptr<ClipSnapshot>                clipSnapshot;
+
+    /** Shared with the pre-roll jobs, that may still run after this clip was deleted */
+    std::shared_ptr<std::atomic<int64_t>> position { std::make_shared<std::atomic<int64_t>>(0) };
+
+    std::atomic<double>  preRollTime { 2.0 };
     VideoFrame           frame;
 
+    std::atomic<bool>         planarFrames { false };
+    std::atomic<bool>         offline      { false };
+    std::shared_ptr<YUVFrame> yuvBuffer;
+
+    StreamTypes streamTypes { StreamTypes::all() };
+
     int64_t lastShownFrame;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ComposedClip)
@@ -30,7 +30,7 @@ namespace foleys
 
  When you created a shared_ptr of an ImageClip, call manageLifeTime() on the VideoEngine,
  that will add it to the auto release pool and register possible background jobs
- with the TimeSliceThreads.
+ with the ReaderScheduler.
  */
 class ImageClip : public AVClip
 {
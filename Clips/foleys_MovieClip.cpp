@@ -79,10 +79,32 @@ void MovieClip::setReader (std::unique_ptr<AVReader> readerToUse)
     audioFifo.setPosition (0);
 
     if (sampleRate > 0)
+    {
         movieReader->setOutputSampleRate (sampleRate);
 
+        if (movieReader->numChannels > 0)
+            stretcher.prepare (movieReader->numChannels, sampleRate, std::max (samplesPerBlock, 512));
+
+        if (playbackRate.load() < 0.0)
+            prepareReverse();
+    }
+
+    positionChanged.store (true);
+    movieReader->setPlanarFramesEnabled (planarFrames.load());
+
     if (hasVideo())
-        videoFifo.setVideoSettings (movieReader->getVideoSettings (0));
+    {
+        const auto settings = movieReader->getVideoSettings (0);
+        videoFifo.setVideoSettings (settings);
+
+        if (auto* engine = getVideoEngine())
+        {
+            const auto seconds = std::max (1.0, engine->getBufferingManager().getReadAheadTime (ReadAheadState::Playing));
+            const auto numFrames = juce::roundToInt (std::ceil (seconds * settings.getFrameRate())) + 4;
+            if (numFrames > videoFifo.getSize())
+                videoFifo.setSize (numFrames);
+        }
+    }
 
     videoFifo.clear();
 
@@ -114,6 +136,9 @@ double MovieClip::getCurrentTimeInSeconds() const
 
 VideoFrame& MovieClip::getFrame (double pts)
 {
+    if (offline.load())
+        waitForFrameReady (pts);
+
     return videoFifo.getFrameSeconds (pts);
 }
 
@@ -145,15 +170,29 @@ juce::Image MovieClip::getStillImage (double seconds, Size size)
     return {};
 }
 
-void MovieClip::prepareToPlay (int, double sampleRateToUse)
+void MovieClip::prepareToPlay (int samplesPerBlockExpected, double sampleRateToUse)
 {
+    // the fifos are resized, so the reader must not write meanwhile
+    backgroundJob.setSuspended (true);
+
     sampleRate = sampleRateToUse;
-    audioFifo.setNumSamples (juce::roundToInt (sampleRate));
+    samplesPerBlock = samplesPerBlockExpected;
+
+    updateFifoSizes();
     audioFifo.setSampleRate (sampleRate);
 
     if (movieReader)
+    {
         movieReader->setOutputSampleRate (sampleRate);
 
+        if (movieReader->numChannels > 0)
+            stretcher.prepare (movieReader->numChannels, sampleRate, std::max (samplesPerBlock, 512));
+    }
+
+    if (playbackRate.load() < 0.0)
+        prepareReverse();
+
+    positionChanged.store (true);
     backgroundJob.setSuspended (false);
 }
 
@@ -164,10 +203,18 @@ void MovieClip::releaseResources()
 
 bool MovieClip::waitForSamplesReady (int samples, int timeout)
 {
-    jassert (samples > 0 && samples <= 4800);
-
     if (movieReader && movieReader->isOpenedOk() && movieReader->hasAudio())
     {
+        // at the end of the stream getNextAudioBlock() fills up with silence
+        if (offline.load())
+            return readSynchronously ([this, samples] { return audioFifo.getAvailableSamples() >= samples; }, getCurrentTimeInSeconds())
+                || movieReader->isEndOfStream();
+
+        jassert (samples > 0 && samples <= 4800);
+
+        FOLEYS_PERFORMANCE_SOURCE (getPerformanceCounters());
+        FOLEYS_MEASURE_STAGE (Wait);
+
         const auto start = juce::Time::getMillisecondCounter();
 
         while (audioFifo.getAvailableSamples() < samples && int (juce::Time::getMillisecondCounter() - start) < timeout)
@@ -183,6 +230,12 @@ bool MovieClip::waitForSamplesReady (int samples, int timeout)
 
 bool MovieClip::waitForFrameReady (double pts, int timeout)
 {
+    if (offline.load())
+        return readSynchronously ([this, pts] { return videoFifo.isFrameAvailable (pts); }, pts);
+
+    FOLEYS_PERFORMANCE_SOURCE (getPerformanceCounters());
+    FOLEYS_MEASURE_STAGE (Wait);
+
     const auto start = juce::Time::getMillisecondCounter();
 
     while (videoFifo.isFrameAvailable (pts) == false && int (juce::Time::getMillisecondCounter() - start) < timeout)
@@ -194,20 +247,218 @@ bool MovieClip::waitForFrameReady (double pts, int timeout)
 void MovieClip::getNextAudioBlock (const juce::AudioSourceChannelInfo& info)
 {
     const auto gain = float (juce::Decibels::decibelsToGain (getAudioParameters().at(IDs::gain)->getRealValue()));
+    const auto rate = offline.load() ? 1.0 : playbackRate.load();
+
+    if (positionChanged.exchange (false))
+    {
+        playPosition = double (nextReadPosition.load());
+        stretching = false;
+        stretcher.reset();
+    }
 
     if (movieReader && movieReader->isOpenedOk() && movieReader->hasAudio())
     {
-        audioFifo.pullSamples (info);
+        if (rate < 0.0)
+        {
+            readReverse (info, -rate);
+        }
+        else if (rate != 1.0 || stretching)
+        {
+            readStretched (info, rate);
+        }
+        else
+        {
+            if (offline.load())
+            {
+                const auto numSamples = info.numSamples;
+                if (! readSynchronously ([this, numSamples] { return audioFifo.getAvailableSamples() >= numSamples; }, getCurrentTimeInSeconds())
+                    && movieReader->isEndOfStream())
+                    audioFifo.pushSilence (numSamples - audioFifo.getAvailableSamples());
+            }
+
+            audioFifo.pullSamples (info);
+        }
+
         info.buffer->applyGainRamp (info.startSample, info.numSamples, lastGain, gain);
     }
     else
     {
+        // without audio the chunks still need to be switched for the video
+        if (rate < 0.0)
+            getReverseChunk (playPosition);
+
         info.clearActiveBufferRegion();
     }
-    nextReadPosition += info.numSamples;
+
+    playPosition = std::max (playPosition + info.numSamples * rate, 0.0);
+    nextReadPosition = juce::int64 (playPosition);
     lastGain = gain;
 
-    triggerAsyncUpdate();
+    // the timecode update looks up the frame on the message thread, offline that would interfere with the reading
+    if (! offline.load())
+        triggerAsyncUpdate();
+}
+
+void MovieClip::readStretched (const juce::AudioSourceChannelInfo& info, double rate)
+{
+    // the stretcher holds some input, so it stays in use until the next reposition
+    stretching = true;
+    stretcher.setRate (rate);
+
+    const auto numNeeded = std::min (stretcher.getNumInputSamplesNeeded (info.numSamples), audioFifo.getAvailableSamples());
+    if (numNeeded > 0)
+    {
+        juce::AudioBuffer<float> input (stretcher.getInputWritePointers (numNeeded), audioFifo.getNumChannels(), numNeeded);
+        audioFifo.pullSamples (juce::AudioSourceChannelInfo (&input, 0, numNeeded));
+        stretcher.finishedInput (numNeeded);
+    }
+
+    stretcher.process (*info.buffer, info.startSample, info.numSamples);
+}
+
+void MovieClip::readReverse (const juce::AudioSourceChannelInfo& info, double speed)
+{
+    auto position = playPosition;
+    const auto numChannels = info.buffer->getNumChannels();
+
+    for (int i = 0; i < info.numSamples; ++i)
+    {
+        const auto* chunk = getReverseChunk (position);
+        if (chunk == nullptr)
+        {
+            for (int c = 0; c < numChannels; ++c)
+                info.buffer->setSample (c, info.startSample + i, 0.0f);
+        }
+        else
+        {
+            const auto index  = position - double (chunk->start);
+            const auto first  = int (index);
+            const auto alpha  = float (index - first);
+            const auto chunkChannels = chunk->audio.getNumChannels();
+
+            for (int c = 0; c < numChannels; ++c)
+            {
+                const auto* samples = chunk->audio.getReadPointer (c % chunkChannels);
+                info.buffer->setSample (c, info.startSample + i, samples [first] + alpha * (samples [first + 1] - samples [first]));
+            }
+        }
+
+        position = std::max (position - speed, 0.0);
+    }
+}
+
+const MovieClip::ReverseChunk* MovieClip::getReverseChunk (double position)
+{
+    const auto generation = reverseGeneration.load();
+    auto isInside = [position, generation] (const ReverseChunk& chunk)
+    {
+        return chunk.generation == generation && position >= double (chunk.start) && position < double (chunk.start + chunk.numSamples - 1);
+    };
+
+    auto* chunk = &reverseChunks [size_t (playingChunk.load())];
+    if (isInside (*chunk))
+        return chunk;
+
+    if (! nextChunkReady.load (std::memory_order_acquire))
+        return nullptr;
+
+    // the background thread starts filling the other chunk once nextChunkReady is reset, this also drops a chunk outdated by a seek
+    const auto next = 1 - playingChunk.load();
+    playingChunk.store (next);
+    nextChunkReady.store (false, std::memory_order_release);
+
+    chunk = &reverseChunks [size_t (next)];
+    return isInside (*chunk) ? chunk : nullptr;
+}
+
+void MovieClip::prepareReverse()
+{
+    if (sampleRate <= 0 || movieReader == nullptr)
+        return;
+
+    const auto numChannels = std::max (movieReader->numChannels, 1);
+    const auto numSamples  = juce::roundToInt (reverseChunkSeconds * maximumPlaybackRate * sampleRate) + 2;
+
+    for (auto& chunk : reverseChunks)
+    {
+        if (chunk.audio.getNumChannels() != numChannels || chunk.audio.getNumSamples() < numSamples)
+            chunk.audio.setSize (numChannels, numSamples);
+
+        chunk.numSamples = 0;
+    }
+
+    if (reverseFifo == nullptr || reverseFifo->getNumChannels() != numChannels || reverseFifo->getSize() < numSamples + audioReserve)
+        reverseFifo = std::make_unique<AudioFifo> (numSamples + 2 * audioReserve, numChannels);
+
+    reverseFifo->setSampleRate (sampleRate);
+}
+
+bool MovieClip::readReverseChunk (const std::atomic<bool>& cancel)
+{
+    if (nextChunkReady.load (std::memory_order_acquire) || reverseFifo == nullptr || sampleRate <= 0)
+        return false;
+
+    const auto generation = reverseGeneration.load();
+    const auto speed = std::abs (playbackRate.load());
+    const auto& playing = reverseChunks [size_t (playingChunk.load())];
+
+    auto end = std::min (nextReadPosition.load() + 1, movieReader->getTotalLength());
+    if (playing.numSamples > 0 && playing.generation == generation)
+        end = std::min (end, playing.start);
+
+    if (end <= 0)
+        return false;
+
+    const auto length = juce::roundToInt (reverseChunkSeconds * std::max (1.0, speed) * sampleRate);
+    const auto start  = std::max (int64_t (0), end - length);
+    const auto numSamples = int (end - start) + 1;
+    auto& chunk = reverseChunks [size_t (1 - playingChunk.load())];
+
+    // convert at most a third of the video fifo per chunk, so the chunk on screen is never overwritten
+    auto videoRate = speed;
+    const auto frameDuration = videoFifo.getFrameDurationInSeconds();
+    if (hasVideo() && frameDuration > 0.0)
+        videoRate = std::max (videoRate, 3.0 * (end - start) / sampleRate / (frameDuration * (videoFifo.getSize() - videoReserve)));
+
+    movieReader->setPlaybackRate (-videoRate);
+    movieReader->setCatchUpMode (CatchUpMode::SkipConversion, start / sampleRate);
+
+    reverseFifo->setPosition (start);
+    if (sampleRate == movieReader->sampleRate)
+        movieReader->setPosition (start);
+    else
+        movieReader->setPosition (juce::int64 (start / sampleRate * movieReader->sampleRate));
+
+    const auto endSeconds = end / sampleRate;
+    while (! cancel.load() && ! movieReader->isEndOfStream())
+    {
+        const auto audioDone = ! hasAudio() || reverseFifo->getWritePosition() >= start + numSamples;
+        const auto videoDone = ! hasVideo() || movieReader->getLastDecodedVideoTime() >= endSeconds;
+        if (audioDone && videoDone)
+            break;
+
+        // the video is thinned out above, so only the audio can run out of space
+        if (hasAudio() && reverseFifo->getFreeSpace() <= audioReserve)
+            break;
+
+        movieReader->readNewData (videoFifo, *reverseFifo);
+    }
+
+    if (cancel.load())
+        return true;
+
+    const auto numRead = hasAudio() ? std::min (reverseFifo->getAvailableSamples(), numSamples) : numSamples;
+    if (hasAudio())
+        reverseFifo->pullSamples (juce::AudioSourceChannelInfo (&chunk.audio, 0, numRead));
+    else
+        chunk.audio.clear();
+
+    chunk.start = start;
+    chunk.numSamples = numRead;
+    chunk.generation = generation;
+
+    nextChunkReady.store (true, std::memory_order_release);
+    return true;
 }
 
 bool MovieClip::hasVideo() const
@@ -264,7 +515,12 @@ void MovieClip::setNextReadPosition (juce::int64 samples)
     backgroundJob.setSuspended (true);
 
     nextReadPosition = samples;
+    positionChanged.store (true);
     audioFifo.setPosition (samples);
+
+    // the chunks belong to the audio and the background thread, they check the generation themselves
+    ++reverseGeneration;
+
     if (movieReader && sampleRate > 0)
     {
         auto time = samples / sampleRate;
@@ -312,16 +568,300 @@ MovieClip::BackgroundReaderJob::BackgroundReaderJob (MovieClip& ownerToUse)
 {
 }
 
+void MovieClip::setReadAheadBudget (const ReadAheadBudget& budget)
+{
+    readAheadSeconds.store (budget.seconds);
+    readAheadBytes.store (budget.maxBytes);
+}
+
+size_t MovieClip::getReadAheadBytesPerSecond() const
+{
+    double bytes = 0.0;
+
+    if (hasVideo())
+    {
+        const auto frameDuration = videoFifo.getFrameDurationInSeconds();
+        if (frameDuration > 0.0)
+            bytes += getFrameSizeInBytes() / frameDuration;
+    }
+
+    if (hasAudio())
+        bytes += double (movieReader->numChannels) * sampleRate * sizeof (float) * std::max (1.0, std::abs (playbackRate.load()));
+
+    return size_t (bytes);
+}
+
+size_t MovieClip::getBufferedBytes() const
+{
+    size_t bytes = 0;
+
+    if (hasVideo())
+        bytes += size_t (videoFifo.getNumAvailableFrames()) * getFrameSizeInBytes();
+
+    if (hasAudio())
+        bytes += size_t (audioFifo.getAvailableSamples()) * size_t (movieReader->numChannels) * sizeof (float);
+
+    return bytes;
+}
+
+size_t MovieClip::getFrameSizeInBytes() const
+{
+    const auto size = getVideoSize();
+    return size_t (size.width) * size_t (size.height) * 4;
+}
+
+int MovieClip::getNumFramesToBuffer() const
+{
+    const auto frameDuration = videoFifo.getFrameDurationInSeconds();
+    auto numFrames = frameDuration > 0.0 ? int (std::ceil (readAheadSeconds.load() / frameDuration))
+                                         : videoFifo.getSize();
+
+    const auto frameSize = getFrameSizeInBytes();
+    if (frameSize > 0)
+        numFrames = int (std::min (size_t (numFrames), readAheadBytes.load() / frameSize));
+
+    return std::max (numFrames, 2);
+}
+
+bool MovieClip::needsMoreData() const
+{
+    if (hasAudio() && audioFifo.getFreeSpace() <= audioReserve)
+        return false;
+
+    if (hasVideo() && videoFifo.getFreeSpace() <= videoReserve)
+        return false;
+
+    // since the streams are interleaved, keep reading until both streams are filled up to the budget
+    // faster than realtime the audio needs to cover more media time
+    const auto rate = std::max (1.0, std::abs (playbackRate.load()));
+    if (hasAudio() && audioFifo.getAvailableSamples() < std::max (audioReserve, int (readAheadSeconds.load() * sampleRate * rate)))
+        return true;
+
+    if (hasVideo() && videoFifo.getNumAvailableFrames() < getNumFramesToBuffer())
+        return true;
+
+    return false;
+}
+
+void MovieClip::setMaximumCatchUpMode (CatchUpMode mode)
+{
+    maxCatchUpMode.store (mode);
+}
+
+CatchUpMode MovieClip::getMaximumCatchUpMode() const
+{
+    return maxCatchUpMode.load();
+}
+
+void MovieClip::setPlaybackRate (double rate)
+{
+    const auto magnitude = juce::jlimit (minimumPlaybackRate, maximumPlaybackRate, std::abs (rate));
+    const auto newRate   = rate < 0.0 ? -magnitude : magnitude;
+    const auto oldRate   = playbackRate.load();
+
+    if (newRate == oldRate)
+        return;
+
+    if ((newRate < 0.0) == (oldRate < 0.0))
+    {
+        playbackRate.store (newRate);
+        return;
+    }
+
+    // changing the direction starts the reader over at the current position
+    backgroundJob.setSuspended (true);
+
+    if (newRate < 0.0)
+        prepareReverse();
+
+    playbackRate.store (newRate);
+    setNextReadPosition (nextReadPosition.load());
+}
+
+double MovieClip::getPlaybackRate() const
+{
+    return playbackRate.load();
+}
+
+void MovieClip::setPlanarFramesEnabled (bool shouldProvideYUV)
+{
+    planarFrames.store (shouldProvideYUV);
+
+    if (movieReader != nullptr)
+        movieReader->setPlanarFramesEnabled (shouldProvideYUV);
+}
+
+AudioSyncStatistics MovieClip::getAudioSyncStatistics() const
+{
+    return movieReader != nullptr ? movieReader->getAudioSyncStatistics() : AudioSyncStatistics();
+}
+
+void MovieClip::setOfflineMode (bool shouldRenderOffline)
+{
+    if (offline.load() == shouldRenderOffline)
+        return;
+
+    backgroundJob.setSuspended (true);
+    offline.store (shouldRenderOffline);
+    offlineFailed.store (false);
+
+    if (movieReader != nullptr)
+        movieReader->setCatchUpMode (CatchUpMode::Off, 0.0);
+
+    // resizing empties the fifos, so the reader needs to be positioned again
+    updateFifoSizes();
+    setNextReadPosition (nextReadPosition.load());
+}
+
+bool MovieClip::isOfflineMode() const
+{
+    return offline.load();
+}
+
+bool MovieClip::hasOfflineReadFailed() const
+{
+    return offlineFailed.load();
+}
+
+void MovieClip::updateFifoSizes()
+{
+    auto seconds = 1.0;
+    if (auto* engine = getVideoEngine())
+        seconds = std::max (seconds, engine->getBufferingManager().getReadAheadTime (ReadAheadState::Playing));
+
+    // offline a whole block is read at once, while the other stream runs ahead by its interleaving
+    const auto blockSeconds = (offline.load() && sampleRate > 0) ? samplesPerBlock / sampleRate : 0.0;
+
+    if (sampleRate > 0)
+        audioFifo.setNumSamples (juce::roundToInt (sampleRate * (seconds + blockSeconds)));
+
+    const auto frameDuration = videoFifo.getFrameDurationInSeconds();
+    if (blockSeconds > 0.0 && frameDuration > 0.0 && hasVideo())
+    {
+        const auto numFrames = juce::roundToInt (std::ceil ((seconds + blockSeconds) / frameDuration)) + videoReserve + 1;
+        if (numFrames > videoFifo.getSize())
+            videoFifo.setSize (numFrames);
+    }
+}
+
+bool MovieClip::readSynchronously (const std::function<bool()>& isReady, double releaseBefore)
+{
+    if (movieReader == nullptr || ! movieReader->isOpenedOk() || sampleRate <= 0)
+        return isReady();
+
+    FOLEYS_PERFORMANCE_SOURCE (getPerformanceCounters());
+
+    while (! isReady())
+    {
+        if (movieReader->isEndOfStream())
+            return false;
+
+        if (hasVideo() && videoFifo.getFreeSpace() <= videoReserve)
+            videoFifo.releaseFramesBefore (releaseBefore);
+
+        if ((hasAudio() && audioFifo.getFreeSpace() <= audioReserve) || (hasVideo() && videoFifo.getFreeSpace() <= videoReserve))
+        {
+            // the other stream ran too far ahead, e.g. the video ended before the audio
+            FOLEYS_LOG ("Offline reading stalled at " << getCurrentTimeInSeconds() << ", the fifos are full");
+            offlineFailed.store (true);
+            return false;
+        }
+
+        movieReader->readNewData (videoFifo, audioFifo);
+
+        if (hasVideo())
+            videoFifo.releaseUnusedFrames();
+    }
+
+    return true;
+}
+
+void MovieClip::updateCatchUpMode()
+{
+    // lateness in seconds, when the next stage of skipping kicks in
+    const double skipNonReferenceTime = 0.25;
+    const double skipToKeyFrameTime   = 1.0;
+
+    auto mode = CatchUpMode::Off;
+    const auto playhead = sampleRate > 0 ? nextReadPosition.load() / sampleRate : 0.0;
+
+    if (sampleRate > 0 && getReadAheadState() == ReadAheadState::Playing)
+    {
+        const auto decoded = movieReader->getLastDecodedVideoTime();
+        const auto lateness = playhead - decoded;
+
+        if (decoded >= 0.0 && lateness > 0.0)
+        {
+            if (lateness > skipToKeyFrameTime)
+                mode = CatchUpMode::SkipToKeyFrame;
+            else if (lateness > skipNonReferenceTime)
+                mode = CatchUpMode::SkipNonReference;
+            else
+                mode = CatchUpMode::SkipConversion;
+        }
+    }
+
+    movieReader->setCatchUpMode (std::min (mode, maxCatchUpMode.load()), playhead);
+}
+
+double MovieClip::getSecondsToDeadline() const
+{
+    const auto state = getReadAheadState();
+    if (state == ReadAheadState::Idle || state == ReadAheadState::Suspended)
+        return std::numeric_limits<double>::max();
+
+    const auto rate = playbackRate.load();
+    if (rate < 0.0 && ! offline.load())
+        return nextChunkReady.load() ? reverseChunkSeconds : 0.0;
+
+    return getBufferedSeconds (std::numeric_limits<double>::max()) / std::max (1.0, rate);
+}
+
+double MovieClip::getBufferedSeconds (double maxSeconds) const
+{
+    auto secs = maxSeconds;
+    if (hasAudio() && sampleRate > 0)
+        secs = std::min (secs, audioFifo.getAvailableSamples() / sampleRate);
+
+    if (hasVideo())
+        secs = std::min (secs, videoFifo.getNumAvailableFrames() * videoFifo.getFrameDurationInSeconds());
+
+    return secs;
+}
+
 int MovieClip::BackgroundReaderJob::useTimeSlice()
 {
-    if (suspended == false &&
-        owner.sampleRate > 0 &&
-        owner.movieReader.get() != nullptr &&
-        (owner.hasAudio() == false || owner.audioFifo.getFreeSpace() > 2048) &&
-        (owner.hasVideo() == false || owner.videoFifo.getFreeSpace() > 3))
+    // offline the data is read synchronously when it is requested
+    if (owner.getReadAheadState() == ReadAheadState::Suspended || owner.offline.load())
+        return 100;
+
+    FOLEYS_PERFORMANCE_SOURCE (owner.getPerformanceCounters());
+
+    const auto rate = owner.playbackRate.load();
+
+    if (rate < 0.0)
     {
+        if (suspended || owner.movieReader.get() == nullptr)
+            return 20;
+
         juce::ScopedValueSetter<bool> guard (inDecodeBlock, true);
-        owner.movieReader->readNewData (owner.videoFifo, owner.audioFifo);
+        return owner.readReverseChunk (suspended) ? 1 : 10;
+    }
+
+    if (suspended == false && owner.movieReader.get() != nullptr)
+    {
+        juce::ScopedValueSetter<bool> guard (inDecodeBlock, true);
+
+        owner.movieReader->setPlaybackRate (rate);
+
+        if (owner.hasVideo())
+            owner.updateCatchUpMode();
+
+        if (owner.sampleRate > 0 && owner.needsMoreData())
+            owner.movieReader->readNewData (owner.videoFifo, owner.audioFifo);
+
+        if (owner.hasVideo())
+            owner.videoFifo.releaseUnusedFrames();
     }
 
     if (owner.movieReader.get() != nullptr)
@@ -330,14 +870,10 @@ int MovieClip::BackgroundReaderJob::useTimeSlice()
             return 100;
     }
 
-    double secs = 1;
-    if (owner.hasAudio())
-        secs = std::min (secs, owner.audioFifo.getAvailableSamples() / owner.sampleRate);
-
-    if (owner.hasVideo())
-        secs = std::min (secs, owner.videoFifo.getNumAvailableFrames() * owner.videoFifo.getFrameDurationInSeconds());
+    // the fuller the buffer compared to the budget, the longer we can wait
+    const auto target = std::max (owner.readAheadSeconds.load(), 0.01);
 
-    return int (50.0 * secs);
+    return int (50.0 * owner.getBufferedSeconds (target) / target);
 }
 
 void MovieClip::BackgroundReaderJob::setSuspended (bool s)
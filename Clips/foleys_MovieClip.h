@@ -29,11 +29,12 @@ namespace foleys
 
  The MovieClip plays back a video file. It buffers an amount of audio and
  video frames ahead of time. To check, you can call isFrameAvailable(),
- in case you need to wait for the frame, e.g. for offline bouncing.
+ in case you need to wait for the frame. For offline bouncing rather use
+ setOfflineMode(), which decodes the data synchronously when it is requested.
 
  When you created a shared_ptr of an MovieClip, call manageLifeTime() on the VideoEngine,
  that will add it to the auto release pool and register possible background jobs
- with the TimeSliceThreads.
+ with the ReaderScheduler.
  */
 class MovieClip   : public AVClip,
                     private juce::AsyncUpdater
@@ -97,8 +98,96 @@ public:
 
     bool waitForFrameReady (double pts, int timeout=1000) override;
 
+    /**
+     When the video decoding falls behind the audio clock, the clip skips work to catch
+     up: first it skips converting late frames, then it discards non reference frames,
+     and if it is still late it jumps to the next key frame. Use this to limit how far
+     it may go, CatchUpMode::Off decodes every frame.
+     */
+    void setMaximumCatchUpMode (CatchUpMode mode);
+    CatchUpMode getMaximumCatchUpMode() const;
+
+    /**
+     Sets the speed for playing the clip directly, e.g. for shuttle and scrubbing in a viewer.
+     Rates from 0.25 to 4 play forward with the pitch preserved, negative rates play backwards.
+     The position and getCurrentTimeInSeconds() follow the media time, the reader only decodes
+     the frames needed at that speed. In a ComposedClip the timeline sets the time, and in
+     offline mode the rate is ignored.
+     */
+    void setPlaybackRate (double rate);
+    double getPlaybackRate() const;
+
+    void setPlanarFramesEnabled (bool shouldProvideYUV) override;
+
+    /**
+     The reader places the decoded audio at the timestamps of the stream: gaps are filled with
+     silence, overlaps are trimmed and slow drift is corrected by stretching the audio slightly.
+     This returns the statistics of these corrections.
+     */
+    AudioSyncStatistics getAudioSyncStatistics() const;
+
+    void setOfflineMode (bool shouldRenderOffline) override;
+    bool isOfflineMode() const override;
+    bool hasOfflineReadFailed() const override;
+
+    void setReadAheadBudget (const ReadAheadBudget& budget) override;
+    size_t getReadAheadBytesPerSecond() const override;
+    size_t getBufferedBytes() const override;
+    double getSecondsToDeadline() const override;
+
 private:
 
+    /**
+     Backwards the reader decodes chunks ending at the start of the chunk being played.
+     Two chunks are used alternately, the background thread fills one while the audio
+     thread plays the other.
+     */
+    struct ReverseChunk
+    {
+        juce::AudioBuffer<float> audio;
+        int64_t start      = 0;
+        int     numSamples = 0;
+        int     generation = 0;
+    };
+
+    /** Returns true, if the budget allows to read more data */
+    bool needsMoreData() const;
+
+    /** Sets the size of the fifos to hold the read ahead, and in offline mode additionally a whole block */
+    void updateFifoSizes();
+
+    /**
+     Offline mode: reads on the calling thread until isReady returns true. Frames that end before
+     releaseBefore are dropped if the video fifo runs full. Returns false, if the stream ended first.
+     */
+    bool readSynchronously (const std::function<bool()>& isReady, double releaseBefore);
+
+    /** The number of video frames the current budget allows to buffer */
+    int getNumFramesToBuffer() const;
+
+    size_t getFrameSizeInBytes() const;
+
+    /** The time in seconds, that is buffered in both streams, but at most maxSeconds */
+    double getBufferedSeconds (double maxSeconds) const;
+
+    /** Measures how late the video decoding is compared to the audio clock and tells the reader */
+    void updateCatchUpMode();
+
+    /** Pulls the audio through the time stretcher, for playback rates other than 1 */
+    void readStretched (const juce::AudioSourceChannelInfo& info, double rate);
+
+    /** Plays the audio of the decoded chunks backwards, resampled to the speed */
+    void readReverse (const juce::AudioSourceChannelInfo& info, double speed);
+
+    /** Allocates the chunks for playing backwards, call this before the rate turns negative */
+    void prepareReverse();
+
+    /** Returns the chunk containing position, switching to the next chunk if it is ready */
+    const ReverseChunk* getReverseChunk (double position);
+
+    /** Decodes the next chunk to play backwards. Returns false if there was nothing to do */
+    bool readReverseChunk (const std::atomic<bool>& cancel);
+
     void handleAsyncUpdate() override;
 
     /** @internal */
@@ -125,13 +214,44 @@ private:
     std::vector<juce::LagrangeInterpolator> resamplers;
 
     double  sampleRate = {};
-    int64_t nextReadPosition = 0;
+    std::atomic<int64_t> nextReadPosition { 0 };
     int64_t lastShownFrame = -1;
+    int     samplesPerBlock = 0;
     bool    loop = false;
     float   lastGain = 0.0;
 
     Size originalSize;
 
+    std::atomic<double> readAheadSeconds { 1.0 };
+    std::atomic<size_t> readAheadBytes   { std::numeric_limits<size_t>::max() };
+
+    std::atomic<double> playbackRate    { 1.0 };
+    std::atomic<bool>   positionChanged { true };
+    double              playPosition = 0.0;
+    bool                stretching   = false;
+    TimeStretcher       stretcher;
+
+    std::array<ReverseChunk, 2> reverseChunks;
+    std::atomic<int>            playingChunk   { 0 };
+    std::atomic<bool>           nextChunkReady { false };
+    // a seek bumps this instead of touching the chunks, chunks read for an older generation are not played
+    std::atomic<int>            reverseGeneration { 0 };
+    std::unique_ptr<AudioFifo>  reverseFifo;
+
+    static constexpr double minimumPlaybackRate = 0.25;
+    static constexpr double maximumPlaybackRate = 4.0;
+    // the media time decoded at once when playing backwards, multiplied by the speed
+    static constexpr double reverseChunkSeconds = 0.5;
+
+    std::atomic<CatchUpMode> maxCatchUpMode { CatchUpMode::SkipToKeyFrame };
+    std::atomic<bool>        planarFrames   { false };
+    std::atomic<bool>        offline        { false };
+    std::atomic<bool>        offlineFailed  { false };
+
+    // a single packet can produce that many samples or frames, so this space needs to be free
+    static constexpr int audioReserve = 2048;
+    static constexpr int videoReserve = 3;
+
     VideoFifo videoFifo { 30 };
     AudioFifo audioFifo;
 
@@ -21,9 +21,35 @@
 namespace foleys
 {
 
-void DefaultAudioMixer::setup (int numChannels, double, int samplesPerBlockExpected)
+DefaultAudioMixer::DefaultAudioMixer()
 {
+    auto master = std::make_shared<Bus>();
+    master->name = "Master";
+
+    auto initial = std::make_shared<Routing>();
+    initial->buses.push_back ({ std::move (master), masterBus, {}, {} });
+    initial->executionOrder.push_back (masterBus);
+
+    routing = std::move (initial);
+}
+
+void DefaultAudioMixer::setup (int numChannelsToUse, double sampleRateToUse, int samplesPerBlockExpected)
+{
+    const juce::ScopedLock sl (editLock);
+
+    numChannels = numChannelsToUse;
+    sampleRate = sampleRateToUse;
+    samplesPerBlock = samplesPerBlockExpected;
+
     mixBuffer.setSize (numChannels, samplesPerBlockExpected);
+
+    for (auto& bus : getRouting()->buses)
+    {
+        bus.bus->buffer.setSize (numChannels, samplesPerBlockExpected);
+
+        for (auto& processor : bus.processors)
+            processor->prepareToPlay (sampleRate, samplesPerBlockExpected);
+    }
 }
 
 void DefaultAudioMixer::mixAudio (const juce::AudioSourceChannelInfo& info,
@@ -31,42 +57,383 @@ void DefaultAudioMixer::mixAudio (const juce::AudioSourceChannelInfo& info,
                                   const double  timeInSeconds,
                                   const std::vector<std::shared_ptr<ClipDescriptor>>& clips)
 {
+    // the reference keeps the routing and its processors alive until this block is mixed
+    const auto current = getRouting();
+    const auto& buses  = current->buses;
+
+    const auto numSamples = info.numSamples;
+
+    // the master bus refers straight to the output, the other buses to their own buffers
+    auto getBusBuffer = [&] (int index)
+    {
+        if (index == masterBus)
+            return juce::AudioBuffer<float> (info.buffer->getArrayOfWritePointers(), info.buffer->getNumChannels(), info.startSample, numSamples);
+
+        auto& buffer = buses [size_t (index)].bus->buffer;
+        jassert (numSamples <= buffer.getNumSamples());
+        return juce::AudioBuffer<float> (buffer.getArrayOfWritePointers(), buffer.getNumChannels(), 0, numSamples);
+    };
+
+    for (size_t i = 1; i < buses.size(); ++i)
+        buses [i].bus->buffer.clear (0, numSamples);
+
     for (auto& clip : clips)
     {
-        const auto start = clip->getStartInSamples();
-        if (position + info.numSamples >= start && position < start + clip->getLengthInSamples())
+        auto index = clip->getAudioBus();
+        if (! juce::isPositiveAndBelow (index, int (buses.size())))
+            index = masterBus;
+
+        auto target = getBusBuffer (index);
+        mixClip (*clip, target, numSamples, position, timeInSeconds);
+    }
+
+    for (auto index : current->executionOrder)
+    {
+        const auto& bus = buses [size_t (index)];
+        auto buffer = getBusBuffer (index);
+
+        processBus (bus, buffer);
+
+        if (index == masterBus)
+            continue;
+
+        auto addInto = [&] (int targetIndex, float gain)
         {
-            clip->updateAudioAutomations (timeInSeconds - clip->getStart());
+            auto target = getBusBuffer (targetIndex);
+            const auto channels = std::min (buffer.getNumChannels(), target.getNumChannels());
+            for (int channel = 0; channel < channels; ++channel)
+                target.addFrom (channel, 0, buffer, channel, 0, numSamples, gain);
+        };
+
+        addInto (bus.output, 1.0f);
+
+        for (const auto& send : bus.sends)
+            addInto (send.bus, send.gain);
+    }
+}
 
-            const auto offset = std::max (int (start - position), 0);
-            juce::AudioSourceChannelInfo reader (&mixBuffer, 0, info.numSamples - offset);
-            clip->clip->getNextAudioBlock (reader);
+void DefaultAudioMixer::mixClip (ClipDescriptor& clip, juce::AudioBuffer<float>& target, int numSamples, int64_t position, double timeInSeconds)
+{
+    const auto start = clip.getStartInSamples();
+    if (position + numSamples < start || position >= start + clip.getLengthInSamples())
+        return;
+
+    clip.updateAudioAutomations (timeInSeconds - clip.getStart());
+
+    const auto offset = std::max (int (start - position), 0);
+    juce::AudioSourceChannelInfo reader (&mixBuffer, 0, numSamples - offset);
+
+    // the frozen audio is only used while it is in sync, e.g. a render finished while playing is used after the next seek
+    auto frozen = clip.clip->isOfflineMode() ? nullptr : clip.getAudioFreezer().getFrozenClip();
+    if (frozen != nullptr && frozen->getNextReadPosition() != clip.clip->getNextReadPosition() - clip.getOffsetInSamples())
+        frozen.reset();
+
+    // the clip is read anyway to keep it in sync with its video
+    clip.clip->getNextAudioBlock (reader);
 
-            if (clip->getAudioPlaying() == false || offset > info.numSamples)
-                continue;
+    if (frozen != nullptr)
+        frozen->getNextAudioBlock (reader);
 
-            juce::AudioBuffer<float> procBuffer (mixBuffer.getArrayOfWritePointers(), mixBuffer.getNumChannels(), 0, info.numSamples - offset);
-            juce::MidiBuffer midiDummy;
-            for (const auto& controller : clip->getAudioProcessors())
+    if (clip.getAudioPlaying() == false || offset > numSamples)
+        return;
+
+    if (frozen == nullptr)
+    {
+        FOLEYS_PERFORMANCE_SOURCE (clip.clip->getPerformanceCounters());
+        FOLEYS_MEASURE_STAGE (Processors);
+
+        juce::AudioBuffer<float> procBuffer (mixBuffer.getArrayOfWritePointers(), mixBuffer.getNumChannels(), 0, numSamples - offset);
+        const auto processors = clip.getAudioProcessors();
+        for (const auto& controller : *processors)
+        {
+            controller->updateAutomation ((timeInSeconds - clip.getStart()) + clip.getOffset());
+            if (auto* audioProcessor = controller->getAudioProcessor())
             {
-                controller->updateAutomation ((timeInSeconds - clip->getStart()) + clip->getOffset());
-                if (auto* audioProcessor = controller->getAudioProcessor())
+                if (audioProcessor->isSuspended() == false)
                 {
-                    if (audioProcessor->isSuspended() == false)
-                    {
-                        controller->setPosition (position - start, timeInSeconds);
-                        if (controller->isActive())
-                            audioProcessor->processBlock (procBuffer, midiDummy);
-                        else
-                            audioProcessor->processBlockBypassed (procBuffer, midiDummy);
-                    }
+                    controller->setPosition (position - start, timeInSeconds);
+                    if (controller->isActive())
+                        audioProcessor->processBlock (procBuffer, midiDummy);
+                    else
+                        audioProcessor->processBlockBypassed (procBuffer, midiDummy);
+
+                    midiDummy.clear();
                 }
             }
+        }
+    }
+
+    const auto channels = std::min (mixBuffer.getNumChannels(), target.getNumChannels());
+    for (int channel = 0; channel < channels; ++channel)
+        target.addFrom (channel, offset, mixBuffer.getReadPointer (channel), numSamples - offset);
+}
 
-            for (int channel = 0; channel < mixBuffer.getNumChannels(); ++channel)
-                info.buffer->addFrom (channel, info.startSample + offset, mixBuffer.getReadPointer (channel), info.numSamples - offset);
+void DefaultAudioMixer::processBus (const BusRouting& bus, juce::AudioBuffer<float>& buffer)
+{
+    if (! bus.processors.empty())
+    {
+        FOLEYS_MEASURE_STAGE (Processors);
+
+        for (auto& processor : bus.processors)
+        {
+            if (processor->isSuspended() == false)
+            {
+                processor->processBlock (buffer, midiDummy);
+                midiDummy.clear();
+            }
         }
     }
+
+    auto& state = *bus.bus;
+    const auto gain = state.gain.load();
+    buffer.applyGainRamp (0, buffer.getNumSamples(), state.lastGain, gain);
+    state.lastGain = gain;
+}
+
+int DefaultAudioMixer::addBus (const juce::String& name, int outputBus)
+{
+    jassert (juce::isPositiveAndBelow (outputBus, getNumBuses()));
+
+    const juce::ScopedLock sl (editLock);
+
+    auto bus = std::make_shared<Bus>();
+    bus->name = name;
+    bus->buffer.setSize (numChannels, samplesPerBlock);
+
+    auto newRouting = std::make_shared<Routing> (*getRouting());
+    const auto output = juce::isPositiveAndBelow (outputBus, int (newRouting->buses.size())) ? outputBus : masterBus;
+    newRouting->buses.push_back ({ std::move (bus), output, {}, {} });
+
+    // a new bus has no inputs, so it can't create a feedback loop
+    sortBuses (getRoutingTargets (*newRouting), newRouting->executionOrder);
+
+    const auto index = int (newRouting->buses.size()) - 1;
+    publishRouting (std::move (newRouting));
+
+    return index;
+}
+
+int DefaultAudioMixer::getNumBuses() const
+{
+    return int (getRouting()->buses.size());
+}
+
+juce::String DefaultAudioMixer::getBusName (int bus) const
+{
+    const auto current = getRouting();
+    if (juce::isPositiveAndBelow (bus, int (current->buses.size())))
+        return current->buses [size_t (bus)].bus->name;
+
+    return {};
+}
+
+bool DefaultAudioMixer::setBusOutput (int bus, int outputBus)
+{
+    const auto current = getRouting();
+    if (! juce::isPositiveAndBelow (bus, int (current->buses.size())))
+        return false;
+
+    return updateRouting (bus, outputBus, current->buses [size_t (bus)].sends);
+}
+
+int DefaultAudioMixer::getBusOutput (int bus) const
+{
+    const auto current = getRouting();
+    if (juce::isPositiveAndBelow (bus, int (current->buses.size())))
+        return current->buses [size_t (bus)].output;
+
+    return masterBus;
+}
+
+bool DefaultAudioMixer::setBusSend (int bus, int targetBus, float gain)
+{
+    const auto current = getRouting();
+    if (! juce::isPositiveAndBelow (bus, int (current->buses.size())))
+        return false;
+
+    auto sends = current->buses [size_t (bus)].sends;
+    sends.erase (std::remove_if (sends.begin(), sends.end(), [targetBus](const auto& send) { return send.bus == targetBus; }), sends.end());
+
+    if (gain > 0.0f)
+        sends.push_back ({ targetBus, gain });
+
+    return updateRouting (bus, current->buses [size_t (bus)].output, std::move (sends));
+}
+
+void DefaultAudioMixer::setBusGain (int bus, float gain)
+{
+    const auto current = getRouting();
+    if (juce::isPositiveAndBelow (bus, int (current->buses.size())))
+        current->buses [size_t (bus)].bus->gain.store (gain);
+}
+
+float DefaultAudioMixer::getBusGain (int bus) const
+{
+    const auto current = getRouting();
+    if (juce::isPositiveAndBelow (bus, int (current->buses.size())))
+        return current->buses [size_t (bus)].bus->gain.load();
+
+    return 0.0f;
+}
+
+void DefaultAudioMixer::addBusProcessor (int bus, std::unique_ptr<juce::AudioProcessor> processor, int index)
+{
+    const juce::ScopedLock sl (editLock);
+
+    if (processor == nullptr || ! juce::isPositiveAndBelow (bus, getNumBuses()))
+        return;
+
+    if (sampleRate > 0)
+        processor->prepareToPlay (sampleRate, samplesPerBlock);
+
+    auto newRouting = std::make_shared<Routing> (*getRouting());
+    auto& processors = newRouting->buses [size_t (bus)].processors;
+
+    if (juce::isPositiveAndBelow (index, int (processors.size())))
+        processors.insert (std::next (processors.begin(), index), std::move (processor));
+    else
+        processors.push_back (std::move (processor));
+
+    publishRouting (std::move (newRouting));
+}
+
+void DefaultAudioMixer::removeBusProcessor (int bus, int index)
+{
+    const juce::ScopedLock sl (editLock);
+
+    if (! juce::isPositiveAndBelow (bus, getNumBuses()))
+        return;
+
+    auto newRouting = std::make_shared<Routing> (*getRouting());
+    auto& processors = newRouting->buses [size_t (bus)].processors;
+    if (! juce::isPositiveAndBelow (index, int (processors.size())))
+        return;
+
+    // the audio thread might still process it, releaseRetired() releases its resources later
+    retiredProcessors.push_back (processors [size_t (index)]);
+    processors.erase (std::next (processors.begin(), index));
+
+    publishRouting (std::move (newRouting));
+}
+
+int DefaultAudioMixer::getNumBusProcessors (int bus) const
+{
+    const auto current = getRouting();
+    if (juce::isPositiveAndBelow (bus, int (current->buses.size())))
+        return int (current->buses [size_t (bus)].processors.size());
+
+    return 0;
+}
+
+juce::AudioProcessor* DefaultAudioMixer::getBusProcessor (int bus, int index) const
+{
+    const auto current = getRouting();
+    if (juce::isPositiveAndBelow (bus, int (current->buses.size())))
+    {
+        const auto& processors = current->buses [size_t (bus)].processors;
+        if (juce::isPositiveAndBelow (index, int (processors.size())))
+            return processors [size_t (index)].get();
+    }
+
+    return nullptr;
+}
+
+std::shared_ptr<const DefaultAudioMixer::Routing> DefaultAudioMixer::getRouting() const
+{
+    return std::atomic_load (&routing);
+}
+
+void DefaultAudioMixer::publishRouting (std::shared_ptr<const Routing> newRouting)
+{
+    releaseRetired();
+    retiredRoutings.push_back (std::atomic_exchange (&routing, std::move (newRouting)));
+}
+
+void DefaultAudioMixer::releaseRetired()
+{
+    // a routing, that was swapped out, can't be picked up again, so once only this list holds it, it is unused
+    retiredRoutings.erase (std::remove_if (retiredRoutings.begin(), retiredRoutings.end(),
+                                           [] (const auto& retired) { return retired.use_count() == 1; }),
+                           retiredRoutings.end());
+
+    retiredProcessors.erase (std::remove_if (retiredProcessors.begin(), retiredProcessors.end(),
+                                             [] (const auto& processor)
+                                             {
+                                                 if (processor.use_count() > 1)
+                                                     return false;
+
+                                                 processor->releaseResources();
+                                                 return true;
+                                             }),
+                             retiredProcessors.end());
+}
+
+std::vector<std::vector<int>> DefaultAudioMixer::getRoutingTargets (const Routing& routingToCheck)
+{
+    const auto& buses = routingToCheck.buses;
+    std::vector<std::vector<int>> targets (buses.size());
+
+    for (size_t i = 1; i < buses.size(); ++i)
+    {
+        targets [i].push_back (buses [i].output);
+        for (const auto& send : buses [i].sends)
+            targets [i].push_back (send.bus);
+    }
+
+    return targets;
+}
+
+bool DefaultAudioMixer::updateRouting (int bus, int output, std::vector<Send> sends)
+{
+    const juce::ScopedLock sl (editLock);
+
+    auto newRouting = std::make_shared<Routing> (*getRouting());
+    const auto numBuses = int (newRouting->buses.size());
+
+    if (bus == masterBus || ! juce::isPositiveAndBelow (bus, numBuses) || ! juce::isPositiveAndBelow (output, numBuses))
+        return false;
+
+    for (const auto& send : sends)
+        if (! juce::isPositiveAndBelow (send.bus, numBuses))
+            return false;
+
+    auto& changed = newRouting->buses [size_t (bus)];
+    changed.output = output;
+    changed.sends = std::move (sends);
+
+    if (! sortBuses (getRoutingTargets (*newRouting), newRouting->executionOrder))
+        return false;
+
+    publishRouting (std::move (newRouting));
+    return true;
+}
+
+bool DefaultAudioMixer::sortBuses (const std::vector<std::vector<int>>& targets, std::vector<int>& order)
+{
+    std::vector<int> numInputs (targets.size(), 0);
+    for (const auto& busTargets : targets)
+        for (auto target : busTargets)
+            ++numInputs [size_t (target)];
+
+    std::vector<int> ready;
+    for (size_t i = 0; i < targets.size(); ++i)
+        if (numInputs [i] == 0)
+            ready.push_back (int (i));
+
+    order.clear();
+    while (! ready.empty())
+    {
+        const auto bus = ready.back();
+        ready.pop_back();
+        order.push_back (bus);
+
+        for (auto target : targets [size_t (bus)])
+            if (--numInputs [size_t (target)] == 0)
+                ready.push_back (target);
+    }
+
+    // buses in a feedback loop never run out of inputs
+    return order.size() == targets.size();
 }
 
 } // foleys
@@ -23,10 +23,25 @@
 namespace foleys
 {
 
+/**
+ The DefaultAudioMixer sums the clips after their own processors. Clips can be routed
+ to buses, see ClipDescriptor::setAudioBus(). Each bus runs its processors once for the
+ sum of all clips routed to it, so e.g. one reverb can serve all dialogue clips.
+
+ A bus outputs into another bus or the master bus and can send a copy post fader to
+ other buses. The routing is compiled into an execution order, where every bus runs
+ after all buses feeding into it. Routings with a feedback loop are refused.
+
+ Edits publish a new immutable Routing, so the audio thread never waits for them.
+ Call the editing methods from the message thread.
+ */
 class DefaultAudioMixer : public AudioMixer
 {
 public:
-    DefaultAudioMixer() = default;
+    /** All clips and buses are routed to the master bus by default */
+    static constexpr int masterBus = 0;
+
+    DefaultAudioMixer();
 
     void setup (int numChannels, double sampleRate, int samplesPerBlockExpected) override;
 
@@ -35,8 +50,94 @@ public:
                    const double  timeInSeconds,
                    const std::vector<std::shared_ptr<ClipDescriptor>>& clips) override;
 
+    /** Adds a bus, that outputs into outputBus. Returns the index of the new bus */
+    int addBus (const juce::String& name, int outputBus = masterBus);
+
+    int getNumBuses() const;
+    juce::String getBusName (int bus) const;
+
+    /** Routes the output of a bus. Returns false, if this would create a feedback loop */
+    bool setBusOutput (int bus, int outputBus);
+    int getBusOutput (int bus) const;
+
+    /** Sends a copy of the bus post fader to targetBus. A gain of 0 removes the send.
+        Returns false, if this would create a feedback loop */
+    bool setBusSend (int bus, int targetBus, float gain);
+
+    void setBusGain (int bus, float gain);
+    float getBusGain (int bus) const;
+
+    /** Adds a processor, that runs once per block on the sum of the bus */
+    void addBusProcessor (int bus, std::unique_ptr<juce::AudioProcessor> processor, int index = -1);
+    void removeBusProcessor (int bus, int index);
+    int getNumBusProcessors (int bus) const;
+    juce::AudioProcessor* getBusProcessor (int bus, int index) const;
+
 private:
+    struct Send
+    {
+        int   bus  = masterBus;
+        float gain = 1.0f;
+    };
+
+    /** The state of a bus, that is kept across routings. The buffer and lastGain belong to the audio thread */
+    struct Bus
+    {
+        juce::String             name;
+        std::atomic<float>       gain { 1.0f };
+        float                    lastGain = 1.0f;
+        juce::AudioBuffer<float> buffer;
+    };
+
+    struct BusRouting
+    {
+        std::shared_ptr<Bus>                               bus;
+        int                                                output = masterBus;
+        std::vector<Send>                                  sends;
+        std::vector<std::shared_ptr<juce::AudioProcessor>> processors;
+    };
+
+    /** An immutable snapshot of the buses, the audio thread keeps it while mixing a block */
+    struct Routing
+    {
+        std::vector<BusRouting> buses;
+        std::vector<int>        executionOrder;
+    };
+
+    std::shared_ptr<const Routing> getRouting() const;
+
+    /** Swaps in the new routing. The previous one is kept, until the audio thread doesn't use it anymore */
+    void publishRouting (std::shared_ptr<const Routing> newRouting);
+
+    /** Deletes the retired routings and processors, that the audio thread doesn't use anymore */
+    void releaseRetired();
+
+    /** Returns the buses each bus outputs and sends into */
+    static std::vector<std::vector<int>> getRoutingTargets (const Routing& routingToCheck);
+
+    /** Checks the routing with the changed outputs and sends of one bus and publishes it with its execution order */
+    bool updateRouting (int bus, int output, std::vector<Send> sends);
+
+    /** Sorts the buses, so every bus comes after all buses routed into it. Returns false, if there is a feedback loop */
+    static bool sortBuses (const std::vector<std::vector<int>>& targets, std::vector<int>& order);
+
+    void mixClip (ClipDescriptor& clip, juce::AudioBuffer<float>& target, int numSamples, int64_t position, double timeInSeconds);
+
+    void processBus (const BusRouting& bus, juce::AudioBuffer<float>& buffer);
+
+    /** Serialises the edits with setup(), the audio thread never takes it */
+    juce::CriticalSection editLock;
+
+    std::shared_ptr<const Routing>                     routing;
+    std::vector<std::shared_ptr<const Routing>>        retiredRoutings;
+    std::vector<std::shared_ptr<juce::AudioProcessor>> retiredProcessors;
+
+    int    numChannels = 2;
+    double sampleRate = 0.0;
+    int    samplesPerBlock = 0;
+
     juce::AudioBuffer<float> mixBuffer;
+    juce::MidiBuffer         midiDummy;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (DefaultAudioMixer)
 };
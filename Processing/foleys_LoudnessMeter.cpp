@@ -0,0 +1,431 @@
+/*
+ ==============================================================================
+
+ Copyright (c) 2019 - 2021, Foleys Finest Audio - Daniel Walz
+ All rights reserved.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ ==============================================================================
+ */
+namespace foleys
+{
+
+namespace
+{
+    float gainToLevel (float gain)
+    {
+        return juce::Decibels::gainToDecibels (gain, -std::numeric_limits<float>::infinity());
+    }
+}
+
+void LoudnessMeter::prepare (double sampleRateToUse, int numChannelsToUse)
+{
+    jassert (sampleRateToUse > 0.0 && numChannelsToUse > 0);
+
+    sampleRate  = sampleRateToUse;
+    numChannels = std::max (numChannelsToUse, 1);
+
+    // BS.1770: the LFE is not measured and the surround channels are weighted +1.5 dB
+    channelWeights.assign (size_t (numChannels), 1.0);
+    if (numChannels == 6)
+    {
+        channelWeights [3] = 0.0;
+        channelWeights [4] = 1.41;
+        channelWeights [5] = 1.41;
+    }
+
+    filterStates.assign (size_t (numChannels), {});
+
+    // the K-weighting filter for the actual sample rate, first a high shelf modelling the head...
+    {
+        const auto f0 = 1681.974450955533;
+        const auto gain = 3.999843853973347;
+        const auto q = 0.7071752369554196;
+
+        const auto k  = std::tan (juce::MathConstants<double>::pi * f0 / sampleRate);
+        const auto vh = std::pow (10.0, gain / 20.0);
+        const auto vb = std::pow (vh, 0.4996667741545416);
+        const auto a0 = 1.0 + k / q + k * k;
+
+        stages [0].b0 = (vh + vb * k / q + k * k) / a0;
+        stages [0].b1 = 2.0 * (k * k - vh) / a0;
+        stages [0].b2 = (vh - vb * k / q + k * k) / a0;
+        stages [0].a1 = 2.0 * (k * k - 1.0) / a0;
+        stages [0].a2 = (1.0 - k / q + k * k) / a0;
+    }
+
+    // ... then the RLB high pass
+    {
+        const auto f0 = 38.13547087602444;
+        const auto q = 0.5003270373238773;
+
+        const auto k  = std::tan (juce::MathConstants<double>::pi * f0 / sampleRate);
+        const auto a0 = 1.0 + k / q + k * k;
+
+        stages [1].b0 = 1.0;
+        stages [1].b1 = -2.0;
+        stages [1].b2 = 1.0;
+        stages [1].a1 = 2.0 * (k * k - 1.0) / a0;
+        stages [1].a2 = (1.0 - k / q + k * k) / a0;
+    }
+
+    subBlockLength = std::max (juce::roundToInt (sampleRate * 0.1), 1);
+
+    // above 96 kHz the inter sample peaks are mostly captured by the samples already
+    oversampling = sampleRate < 96000.0 ? 4 : (sampleRate < 192000.0 ? 2 : 1);
+    createTruePeakKernel();
+    truePeakHistory.setSize (numChannels, truePeakTaps - 1 + maxChunkSize);
+
+    resetRequested.store (false);
+    clear();
+}
+
+void LoudnessMeter::createTruePeakKernel()
+{
+    const auto length = oversampling * truePeakTaps;
+    const auto centre = (length - 1) / 2.0;
+
+    std::vector<double> prototype (size_t (length));
+    for (int n = 0; n < length; ++n)
+    {
+        // distance in input samples, the cutoff is the nyquist frequency of the input
+        const auto x = (n - centre) / oversampling;
+        const auto t = (n - centre) / (centre + 1.0);
+
+        const auto window = 0.42 + 0.5 * std::cos (juce::MathConstants<double>::pi * t)
+                                 + 0.08 * std::cos (juce::MathConstants<double>::twoPi * t);
+        const auto arg = juce::MathConstants<double>::pi * x;
+        const auto sinc = (x == 0.0) ? 1.0 : std::sin (arg) / arg;
+
+        prototype [size_t (n)] = sinc * window;
+    }
+
+    // each phase is stored in the order of the samples in the history, normalised to unity gain for DC
+    truePeakKernel.resize (size_t (length));
+    for (int phase = 0; phase < oversampling; ++phase)
+    {
+        auto* row = truePeakKernel.data() + phase * truePeakTaps;
+        double sum = 0.0;
+
+        for (int i = 0; i < truePeakTaps; ++i)
+        {
+            const auto value = prototype [size_t ((truePeakTaps - 1 - i) * oversampling + phase)];
+            row [i] = float (value);
+            sum += value;
+        }
+
+        if (sum > 0.0)
+            juce::FloatVectorOperations::multiply (row, float (1.0 / sum), truePeakTaps);
+    }
+}
+
+void LoudnessMeter::reset()
+{
+    resetRequested.store (true);
+}
+
+void LoudnessMeter::clear()
+{
+    for (auto& state : filterStates)
+        state = {};
+
+    truePeakHistory.clear();
+
+    subBlockPosition = 0;
+    subBlockEnergy   = 0.0;
+    subBlocks.fill (0.0);
+    numSubBlocks     = 0;
+
+    momentaryHistogram.clear();
+    shortTermHistogram.clear();
+
+    maxTruePeak         = 0.0f;
+    maxSamplePeak       = 0.0f;
+    maxMomentaryValue   = -std::numeric_limits<float>::infinity();
+    maxShortTermValue   = -std::numeric_limits<float>::infinity();
+    numSamplesProcessed = 0;
+
+    momentary.store    (-std::numeric_limits<float>::infinity());
+    shortTerm.store    (-std::numeric_limits<float>::infinity());
+    integrated.store   (-std::numeric_limits<float>::infinity());
+    range.store        (0.0f);
+    truePeak.store     (-std::numeric_limits<float>::infinity());
+    samplePeak.store   (-std::numeric_limits<float>::infinity());
+    maxMomentary.store (-std::numeric_limits<float>::infinity());
+    maxShortTerm.store (-std::numeric_limits<float>::infinity());
+    seconds.store      (0.0);
+}
+
+void LoudnessMeter::process (const juce::AudioBuffer<float>& buffer, int startSample, int numSamples)
+{
+    // call prepare() first
+    jassert (numChannels > 0);
+    if (numChannels == 0)
+        return;
+
+    if (resetRequested.exchange (false))
+        clear();
+
+    juce::ScopedNoDenormals noDenormals;
+
+    while (numSamples > 0)
+    {
+        const auto chunk = std::min ({ numSamples, maxChunkSize, subBlockLength - subBlockPosition });
+
+        processChunk (buffer, startSample, chunk);
+
+        startSample         += chunk;
+        numSamples          -= chunk;
+        subBlockPosition    += chunk;
+        numSamplesProcessed += chunk;
+
+        if (subBlockPosition >= subBlockLength)
+            finishSubBlock();
+    }
+
+    truePeak.store (gainToLevel (std::max (maxTruePeak, maxSamplePeak)));
+    samplePeak.store (gainToLevel (maxSamplePeak));
+    seconds.store (numSamplesProcessed / sampleRate);
+}
+
+void LoudnessMeter::processChunk (const juce::AudioBuffer<float>& buffer, int startSample, int numSamples)
+{
+    const auto channels = std::min (buffer.getNumChannels(), numChannels);
+
+    for (int channel = 0; channel < channels; ++channel)
+    {
+        const auto* samples = buffer.getReadPointer (channel, startSample);
+
+        measureTruePeak (channel, samples, numSamples);
+
+        const auto weight = channelWeights [size_t (channel)];
+        if (weight == 0.0)
+            continue;
+
+        // the filter is recursive, so it runs per sample in double precision
+        auto& state = filterStates [size_t (channel)];
+        const auto& s0 = stages [0];
+        const auto& s1 = stages [1];
+        double sum = 0.0;
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            const double x = samples [i];
+
+            const auto y0 = s0.b0 * x + state.z1 [0];
+            state.z1 [0]  = s0.b1 * x - s0.a1 * y0 + state.z2 [0];
+            state.z2 [0]  = s0.b2 * x - s0.a2 * y0;
+
+            const auto y1 = s1.b0 * y0 + state.z1 [1];
+            state.z1 [1]  = s1.b1 * y0 - s1.a1 * y1 + state.z2 [1];
+            state.z2 [1]  = s1.b2 * y0 - s1.a2 * y1;
+
+            sum += y1 * y1;
+        }
+
+        subBlockEnergy += weight * sum;
+    }
+}
+
+void LoudnessMeter::measureTruePeak (int channel, const float* samples, int numSamples)
+{
+    const auto minMax = juce::FloatVectorOperations::findMinAndMax (samples, numSamples);
+    const auto peak = std::max (-minMax.getStart(), minMax.getEnd());
+    maxSamplePeak = std::max (maxSamplePeak, peak);
+
+    if (oversampling == 1)
+        return;
+
+    // the history holds the last samples of the previous chunk in front of the new ones
+    constexpr auto historySize = truePeakTaps - 1;
+    auto* history = truePeakHistory.getWritePointer (channel);
+    juce::FloatVectorOperations::copy (history + historySize, samples, numSamples);
+
+    auto interpolated = maxTruePeak;
+    for (int i = 0; i < numSamples; ++i)
+    {
+        for (int phase = 0; phase < oversampling; ++phase)
+        {
+            const auto value = VectorMath::dotProduct (history + i, truePeakKernel.data() + phase * truePeakTaps, truePeakTaps);
+            interpolated = std::max (interpolated, std::abs (value));
+        }
+    }
+
+    maxTruePeak = interpolated;
+
+    std::memmove (history, history + numSamples, sizeof (float) * size_t (historySize));
+}
+
+void LoudnessMeter::finishSubBlock()
+{
+    subBlocks [size_t (numSubBlocks % numShortTermSubBlocks)] = subBlockEnergy / subBlockLength;
+    ++numSubBlocks;
+
+    subBlockEnergy   = 0.0;
+    subBlockPosition = 0;
+
+    auto getMeanEnergy = [&] (int numBlocks)
+    {
+        double sum = 0.0;
+        for (int i = 1; i <= numBlocks; ++i)
+            sum += subBlocks [size_t ((numSubBlocks - i) % numShortTermSubBlocks)];
+
+        return sum / numBlocks;
+    };
+
+    if (numSubBlocks >= numMomentarySubBlocks)
+    {
+        const auto energy = getMeanEnergy (numMomentarySubBlocks);
+        const auto loudness = float (energyToLoudness (energy));
+
+        momentaryHistogram.add (energy);
+        maxMomentaryValue = std::max (maxMomentaryValue, loudness);
+
+        momentary.store (loudness);
+        maxMomentary.store (maxMomentaryValue);
+    }
+
+    if (numSubBlocks >= numShortTermSubBlocks)
+    {
+        const auto energy = getMeanEnergy (numShortTermSubBlocks);
+        const auto loudness = float (energyToLoudness (energy));
+
+        shortTermHistogram.add (energy);
+        maxShortTermValue = std::max (maxShortTermValue, loudness);
+
+        shortTerm.store (loudness);
+        maxShortTerm.store (maxShortTermValue);
+    }
+
+    updateGatedValues();
+}
+
+void LoudnessMeter::updateGatedValues()
+{
+    auto sumBins = [] (const Histogram& histogram, int firstBin, uint64_t& count, double& energy)
+    {
+        count = 0;
+        energy = 0.0;
+        for (int bin = firstBin; bin < Histogram::numBins; ++bin)
+        {
+            count  += histogram.counts [size_t (bin)];
+            energy += histogram.energies [size_t (bin)];
+        }
+    };
+
+    uint64_t count = 0;
+    double   energy = 0.0;
+
+    // integrated: the blocks above -70 LUFS set a relative gate 10 LU below their mean
+    sumBins (momentaryHistogram, 0, count, energy);
+    if (count > 0)
+    {
+        const auto gate = momentaryHistogram.getBin (energyToLoudness (energy / double (count)) - 10.0);
+        sumBins (momentaryHistogram, gate, count, energy);
+
+        if (count > 0)
+            integrated.store (float (energyToLoudness (energy / double (count))));
+    }
+
+    // loudness range: the short-term values above a relative gate 20 LU below their mean, from the 10th to the 95th percentile
+    sumBins (shortTermHistogram, 0, count, energy);
+    if (count > 0)
+    {
+        const auto gate = shortTermHistogram.getBin (energyToLoudness (energy / double (count)) - 20.0);
+        sumBins (shortTermHistogram, gate, count, energy);
+
+        if (count > 0)
+        {
+            auto getPercentile = [&] (double percentile)
+            {
+                const auto rank = uint64_t (percentile * double (count - 1));
+                uint64_t cumulated = 0;
+
+                for (int bin = gate; bin < Histogram::numBins; ++bin)
+                {
+                    const auto binCount = shortTermHistogram.counts [size_t (bin)];
+                    cumulated += binCount;
+
+                    if (cumulated > rank)
+                        return energyToLoudness (shortTermHistogram.energies [size_t (bin)] / double (binCount));
+                }
+
+                return 0.0;
+            };
+
+            range.store (float (getPercentile (0.95) - getPercentile (0.10)));
+        }
+    }
+}
+
+double LoudnessMeter::energyToLoudness (double energy)
+{
+    if (energy <= 0.0)
+        return -std::numeric_limits<double>::infinity();
+
+    return -0.691 + 10.0 * std::log10 (energy);
+}
+
+LoudnessMeter::Report LoudnessMeter::getReport() const
+{
+    Report report;
+    report.integrated   = integrated.load();
+    report.range        = range.load();
+    report.truePeak     = truePeak.load();
+    report.samplePeak   = samplePeak.load();
+    report.maxMomentary = maxMomentary.load();
+    report.maxShortTerm = maxShortTerm.load();
+    report.seconds      = seconds.load();
+    return report;
+}
+
+juce::String LoudnessMeter::Report::toString() const
+{
+    return "Integrated: "     + juce::String (integrated, 1)   + " LUFS, "
+         + "Range: "          + juce::String (range, 1)        + " LU, "
+         + "True peak: "      + juce::String (truePeak, 1)     + " dBTP, "
+         + "Max momentary: "  + juce::String (maxMomentary, 1) + " LUFS, "
+         + "Max short-term: " + juce::String (maxShortTerm, 1) + " LUFS, "
+         + "Duration: "       + timecodeToString (seconds);
+}
+
+//==============================================================================
+
+void LoudnessMeter::Histogram::clear()
+{
+    counts.fill (0);
+    energies.fill (0.0);
+}
+
+void LoudnessMeter::Histogram::add (double energy)
+{
+    const auto loudness = energyToLoudness (energy);
+
+    // absolute gate
+    if (loudness < minLoudness)
+        return;
+
+    const auto bin = size_t (getBin (loudness));
+    ++counts [bin];
+    energies [bin] += energy;
+}
+
+int LoudnessMeter::Histogram::getBin (double loudness) const
+{
+    if (loudness <= minLoudness)
+        return 0;
+
+    return std::min (int ((loudness - minLoudness) / binSize), numBins - 1);
+}
+
+} // foleys
@@ -0,0 +1,176 @@
+/*
+ ==============================================================================
+
+ Copyright (c) 2019 - 2021, Foleys Finest Audio - Daniel Walz
+ All rights reserved.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ ==============================================================================
+ */
+#pragma once
+
+namespace foleys
+{
+
+/**
+ @class LoudnessMeter
+
+ Measures the loudness according to ITU-R BS.1770 and EBU R128 while the audio streams
+ through, e.g. attached to a ComposedClip or a ClipRenderer. It reports the momentary (400 ms),
+ short-term (3 s) and integrated loudness in LUFS, the loudness range (LRA) in LU and the
+ true peak in dBTP, measured with 4x oversampling.
+
+ process() doesn't allocate nor lock, the values are published as atomics and can be read
+ from any thread. Values, that were not measured yet, are minus infinity.
+
+ The integrated loudness and the loudness range are gated with histograms of 0.1 LU, so the
+ memory doesn't grow with the length of the programme.
+ */
+class LoudnessMeter final
+{
+public:
+    LoudnessMeter() = default;
+
+    /** The results of a measurement, e.g. to check the compliance of an export */
+    struct Report
+    {
+        float integrated    = -std::numeric_limits<float>::infinity();
+        float range         = 0.0f;
+        float truePeak      = -std::numeric_limits<float>::infinity();
+        float samplePeak    = -std::numeric_limits<float>::infinity();
+        float maxMomentary  = -std::numeric_limits<float>::infinity();
+        float maxShortTerm  = -std::numeric_limits<float>::infinity();
+        double seconds      = 0.0;
+
+        juce::String toString() const;
+    };
+
+    /**
+     Allocates the buffers and resets the measurement. Call this before process(), not
+     while another thread is calling process(). For 6 channels the 5.1 channel weighting
+     is used with the LFE on the fourth channel, otherwise all channels count the same.
+     */
+    void prepare (double sampleRate, int numChannels);
+
+    /** Starts a new measurement. This is safe to call while another thread is processing,
+        the measurement is reset at the beginning of the next process() call */
+    void reset();
+
+    /** Measures the audio. Call this from one thread only */
+    void process (const juce::AudioBuffer<float>& buffer, int startSample, int numSamples);
+
+    /** Loudness of the last 400 ms in LUFS */
+    float getMomentaryLoudness() const  { return momentary.load(); }
+
+    /** Loudness of the last 3 seconds in LUFS */
+    float getShortTermLoudness() const  { return shortTerm.load(); }
+
+    /** Gated loudness since the last reset in LUFS */
+    float getIntegratedLoudness() const { return integrated.load(); }
+
+    /** The loudness range (LRA) since the last reset in LU */
+    float getLoudnessRange() const      { return range.load(); }
+
+    /** The maximum true peak since the last reset in dBTP */
+    float getTruePeak() const           { return truePeak.load(); }
+
+    /** The maximum sample peak since the last reset in dBFS */
+    float getSamplePeak() const         { return samplePeak.load(); }
+
+    /** Returns all values of the measurement since the last reset */
+    Report getReport() const;
+
+private:
+    struct Histogram
+    {
+        static constexpr int    numBins     = 1000;
+        static constexpr double minLoudness = -70.0;
+        static constexpr double binSize     = 0.1;
+
+        std::array<uint64_t, numBins> counts   {};
+        std::array<double, numBins>   energies {};
+
+        void clear();
+        void add (double energy);
+        int getBin (double loudness) const;
+    };
+
+    struct Biquad
+    {
+        double b0 = 1.0, b1 = 0.0, b2 = 0.0, a1 = 0.0, a2 = 0.0;
+    };
+
+    struct FilterState
+    {
+        double z1 [2] = { 0.0, 0.0 };
+        double z2 [2] = { 0.0, 0.0 };
+    };
+
+    void clear();
+    void processChunk (const juce::AudioBuffer<float>& buffer, int startSample, int numSamples);
+    void measureTruePeak (int channel, const float* samples, int numSamples);
+    void finishSubBlock();
+    void updateGatedValues();
+    void createTruePeakKernel();
+
+    static double energyToLoudness (double energy);
+
+    double sampleRate  = 48000.0;
+    int    numChannels = 0;
+
+    std::vector<double>      channelWeights;
+    std::vector<FilterState> filterStates;
+    Biquad                   stages [2];
+
+    /** The gating blocks overlap by 75%, so the energy is collected in blocks of 100 ms */
+    static constexpr int numShortTermSubBlocks = 30;
+    static constexpr int numMomentarySubBlocks = 4;
+    static constexpr int maxChunkSize          = 1024;
+
+    int    subBlockLength   = 4800;
+    int    subBlockPosition = 0;
+    double subBlockEnergy   = 0.0;
+    std::array<double, numShortTermSubBlocks> subBlocks {};
+    int64_t numSubBlocks = 0;
+
+    Histogram momentaryHistogram;
+    Histogram shortTermHistogram;
+
+    /** The true peak uses a polyphase interpolation filter, each phase is a dot product */
+    static constexpr int truePeakTaps = 12;
+    int                      oversampling = 4;
+    std::vector<float>       truePeakKernel;
+    juce::AudioBuffer<float> truePeakHistory;
+    float                    maxTruePeak   = 0.0f;
+    float                    maxSamplePeak = 0.0f;
+    float                    maxMomentaryValue = -std::numeric_limits<float>::infinity();
+    float                    maxShortTermValue = -std::numeric_limits<float>::infinity();
+
+    int64_t numSamplesProcessed = 0;
+
+    std::atomic<bool>  resetRequested { false };
+
+    std::atomic<float> momentary    { -std::numeric_limits<float>::infinity() };
+    std::atomic<float> shortTerm    { -std::numeric_limits<float>::infinity() };
+    std::atomic<float> integrated   { -std::numeric_limits<float>::infinity() };
+    std::atomic<float> range        { 0.0f };
+    std::atomic<float> truePeak     { -std::numeric_limits<float>::infinity() };
+    std::atomic<float> samplePeak   { -std::numeric_limits<float>::infinity() };
+    std::atomic<float> maxMomentary { -std::numeric_limits<float>::infinity() };
+    std::atomic<float> maxShortTerm { -std::numeric_limits<float>::infinity() };
+    std::atomic<double> seconds     { 0.0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (LoudnessMeter)
+};
+
+} // foleys
@@ -107,9 +107,14 @@ void ParameterAutomation::deleteKeyframe (int index)
 }
 
 double ParameterAutomation::getValueForTime (double pts) const
+{
+    return getValueForTime (keyframes, getValue(), pts);
+}
+
+double ParameterAutomation::getValueForTime (const std::map<double, double>& keyframes, double value, double pts)
 {
     if (keyframes.empty())
-        return getValue();
+        return value;
 
     const auto& next = keyframes.upper_bound (pts);
     if (next == keyframes.begin())
@@ -95,6 +95,12 @@ public:
      */
     double         getValueForTime (double pts) const;
 
+    /**
+     Returns the normalised value at a certain time from a copy of the keyframes,
+     value is used when there are no keyframes.
+     */
+    static double  getValueForTime (const std::map<double, double>& keyframes, double value, double pts);
+
     /**
      Returns the unnormalised value at a certain time.
      */
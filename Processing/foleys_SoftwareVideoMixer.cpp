@@ -73,7 +73,7 @@ void SoftwareVideoMixer::compose (juce::Image&        target,
         if (frame.isNull() || w < 1 || h < 1)
             continue;
 
-        for (const auto& controller : clip->getVideoProcessors())
+        for (const auto& controller : *clip->getVideoProcessors())
         {
             if (controller->isActive() == false)
                 continue;
@@ -174,6 +174,21 @@ public:
         }
     }
 
+    /** Scales planar pixel data into a ffmpeg AVFrame */
+    void convertPlanesToFrame (AVFrame* frame, const uint8_t* const planes[], const int lineSizes[], int height)
+    {
+        if (scalerContext)
+        {
+            sws_scale (scalerContext,
+                       planes,
+                       lineSizes,
+                       0,
+                       height,
+                       frame->data,
+                       frame->linesize);
+        }
+    }
+
 #if JUCE_ANDROID
   #if JUCE_BIG_ENDIAN
     static const AVPixelFormat juceInternalFormat = AV_PIX_FMT_0BGR;
@@ -252,23 +267,184 @@ struct FFmpegFrame
     AVFrame* frame;
 };
 
+/**
+ Keeps AVFrames including their buffers for reuse, so the writer doesn't allocate
+ memory for each frame. All frames share the format set in setupVideo or setupAudio.
+ */
+class FFmpegFramePool
+{
+public:
+    FFmpegFramePool() = default;
+
+    ~FFmpegFramePool()
+    {
+        for (auto* frame : frames)
+            av_frame_free (&frame);
+    }
+
+    void setupVideo (int widthToUse, int heightToUse, AVPixelFormat formatToUse)
+    {
+        width = widthToUse;
+        height = heightToUse;
+        format = formatToUse;
+    }
+
+    void setupAudio (int numSamplesToUse, AVSampleFormat formatToUse, uint64_t channelLayoutToUse)
+    {
+        numSamples = numSamplesToUse;
+        format = formatToUse;
+        channelLayout = channelLayoutToUse;
+    }
+
+    /** Returns a writable frame, that needs to be handed back using release() */
+    AVFrame* acquire()
+    {
+        AVFrame* frame = nullptr;
+
+        {
+            const juce::ScopedLock sl (lock);
+            if (! frames.empty())
+            {
+                frame = frames.back();
+                frames.pop_back();
+            }
+        }
+
+        if (frame == nullptr)
+        {
+            frame = av_frame_alloc();
+            frame->format = format;
+            frame->width = width;
+            frame->height = height;
+            frame->channel_layout = channelLayout;
+            frame->channels = av_get_channel_layout_nb_channels (channelLayout);
+
+            // audio buffers are sized by nb_samples, FFmpeg rejects a frame without it
+            frame->nb_samples = numSamples;
+
+            if (auto ret = av_frame_get_buffer (frame, 0))
+            {
+                FOLEYS_LOG ("Cannot allocate buffers for frame: " << juce::String (ret));
+                av_frame_free (&frame);
+                return nullptr;
+            }
+        }
+
+        // the last audio frame might have been shortened
+        frame->nb_samples = numSamples;
+
+        // if the encoder still references the buffer, this will allocate a new one
+        if (auto ret = av_frame_make_writable (frame))
+        {
+            FOLEYS_LOG ("Error making frame writeable: " << juce::String (ret));
+            av_frame_free (&frame);
+            return nullptr;
+        }
+
+        return frame;
+    }
+
+    void release (AVFrame* frame)
+    {
+        if (frame == nullptr)
+            return;
+
+        const juce::ScopedLock sl (lock);
+        frames.push_back (frame);
+    }
+
+private:
+    juce::CriticalSection lock;
+    std::vector<AVFrame*> frames;
+
+    int      format        = -1;
+    int      width         = 0;
+    int      height        = 0;
+    int      numSamples    = 0;
+    uint64_t channelLayout = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (FFmpegFramePool)
+};
+
+/**
+ Keeps copies of the images pushed into the writer for reuse. The producer draws the next
+ frame into its image, while the copy is converted on another thread.
+ */
+class FFmpegImagePool
+{
+public:
+    FFmpegImagePool() = default;
+
+    /** Returns a copy of image, that needs to be handed back using release() */
+    juce::Image copyOf (const juce::Image& image)
+    {
+        juce::Image copy;
+
+        {
+            const juce::ScopedLock sl (lock);
+            if (! images.empty())
+            {
+                copy = std::move (images.back());
+                images.pop_back();
+            }
+        }
+
+        if (copy.isNull() || copy.getFormat() != image.getFormat() || copy.getBounds() != image.getBounds())
+            copy = juce::Image (image.getFormat(), image.getWidth(), image.getHeight(), false, juce::SoftwareImageType());
+
+        const juce::Image::BitmapData source (image, juce::Image::BitmapData::readOnly);
+        juce::Image::BitmapData target (copy, juce::Image::BitmapData::writeOnly);
+
+        const auto numBytes = size_t (image.getWidth() * source.pixelStride);
+        for (int y = 0; y < image.getHeight(); ++y)
+            std::memcpy (target.getLinePointer (y), source.getLinePointer (y), numBytes);
+
+        return copy;
+    }
+
+    void release (juce::Image image)
+    {
+        if (image.isNull())
+            return;
+
+        const juce::ScopedLock sl (lock);
+        images.push_back (std::move (image));
+    }
+
+private:
+    juce::CriticalSection    lock;
+    std::vector<juce::Image> images;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (FFmpegImagePool)
+};
+
 struct VideoStreamDescriptor
 {
-    FFmpegVideoScaler    scaler;
+    ~VideoStreamDescriptor()
+    {
+        avcodec_free_context (&context);
+    }
+
     int                  streamIndex = -1;
     AVCodecContext*      context = nullptr;
     VideoStreamSettings  settings;
-    VideoFifo            videoBuffer { 30 };
+    FFmpegFramePool      framePool;
+    FFmpegImagePool      imagePool;
 };
 
 struct AudioStreamDescriptor
 {
-    FFmpegAudioConverter converter;
+    ~AudioStreamDescriptor()
+    {
+        avcodec_free_context (&context);
+    }
+
     int                  streamIndex = -1;
     AVCodecContext*      context = nullptr;
     AudioStreamSettings  settings;
+    int                  frameSize = 1024;
     AudioFifo            sampleBuffer;
-    juce::HeapBlock<uint8_t> converterBuffer;
+    FFmpegFramePool      framePool;
 };
 
 
@@ -75,10 +75,13 @@ public:
         {
             auto* stream = formatContext->streams [audioStreamIdx];
             channelLayout = stream->codecpar->channel_layout;
+            if (channelLayout == 0)
+                channelLayout = uint64_t (av_get_default_channel_layout (audioContext->channels));
 
             reader.sampleRate  = audioContext->sample_rate;
             reader.numChannels = audioContext->channels;
             reader.numSamples  = stream->duration > 0 ? stream->duration : std::numeric_limits<int64_t>::max();
+            trimmedInput.resize (size_t (std::max (audioContext->channels, 1)));
 
             if (! setOutputSampleRate (audioContext->sample_rate))
             {
@@ -164,10 +167,26 @@ public:
         packet.size = 0;
         av_init_packet (&packet);
 
-        auto error = av_read_frame (formatContext, &packet);
+        int error = 0;
+        {
+            FOLEYS_MEASURE_STAGE (Demux);
+            error = av_read_frame (formatContext, &packet);
+        }
 
         if (error >= 0) {
             if (packet.stream_index == videoStreamIdx) {
+                if ((waitForKeyFrame || playbackRate >= keyFrameOnlyRate) && (packet.flags & AV_PKT_FLAG_KEY) == 0)
+                {
+                    av_packet_unref (&packet);
+                    return;
+                }
+
+                if (waitForKeyFrame)
+                {
+                    avcodec_flush_buffers (videoContext);
+                    waitForKeyFrame = false;
+                }
+
                 decodePacket (packet, videoFifo);
             }
             else if (packet.stream_index == audioStreamIdx) {
@@ -180,19 +199,126 @@ public:
                 //DBG ("Packet is neither audio nor video... stream: " + String (packet.stream_index));
             }
         }
+        else if (error == AVERROR_EOF && ! endOfStream)
+        {
+            // send the empty packet to drain the frames still held by the decoders
+            if (videoContext != nullptr)
+                decodePacket (packet, videoFifo);
+
+            if (audioContext != nullptr)
+                decodePacket (packet, audioFifo);
+
+            endOfStream = true;
+        }
         av_packet_unref (&packet);
     }
 
+    bool isEndOfStream() const
+    {
+        return endOfStream.load();
+    }
+
     void setPosition (int64_t position)
     {
         FOLEYS_LOG ("Seek for sample position: " << position);
 //        auto videoPts = av_rescale_q (position, audioContext->time_base, videoContext->time_base);
 //        auto response = av_seek_frame (formatContext, videoStreamIdx, videoPts, AVSEEK_FLAG_BACKWARD);
-        auto response = av_seek_frame (formatContext, audioStreamIdx, position, AVSEEK_FLAG_BACKWARD);
+        auto target = position;
+        if (juce::isPositiveAndBelow (audioStreamIdx, static_cast<int> (formatContext->nb_streams)) && reader.sampleRate > 0)
+            target = av_rescale_q (position, av_make_q (1, juce::roundToInt (reader.sampleRate)), formatContext->streams [audioStreamIdx]->time_base);
+
+        auto response = av_seek_frame (formatContext, audioStreamIdx, target, AVSEEK_FLAG_BACKWARD);
         if (response < 0)
         {
             FOLEYS_LOG ("Error seeking in audio stream: " << getErrorString (response));
         }
+
+        // drop the samples of the old position still buffered in the converter
+        if (audioConverterContext != nullptr)
+            swr_init (audioConverterContext);
+
+        // the first frame after the seek starts before the position, that is not a sync error
+        timestampOffset = 0;
+        averageSyncError = 0.0;
+        seeked = true;
+
+        // a drained decoder doesn't accept packets until it is flushed
+        if (endOfStream)
+        {
+            if (videoContext != nullptr)
+                avcodec_flush_buffers (videoContext);
+
+            if (audioContext != nullptr)
+                avcodec_flush_buffers (audioContext);
+        }
+
+        lastDecodedVideoTime = -1.0;
+        nextFrameToConvert = std::numeric_limits<double>::lowest();
+        waitForKeyFrame = false;
+        endOfStream = false;
+    }
+
+    void setCatchUpMode (CatchUpMode mode, double playheadSeconds)
+    {
+        if (videoContext == nullptr)
+            return;
+
+        if (mode == CatchUpMode::SkipToKeyFrame && catchUpMode != CatchUpMode::SkipToKeyFrame)
+            waitForKeyFrame = true;
+        else if (mode != CatchUpMode::SkipToKeyFrame)
+            waitForKeyFrame = false;
+
+        if (mode != catchUpMode)
+            FOLEYS_LOG ("Video catch up mode: " << int (mode) << " at " << playheadSeconds);
+
+        catchUpMode = mode;
+        skipUntil   = playheadSeconds;
+
+        updateVideoDiscard();
+    }
+
+    void setPlaybackRate (double rate)
+    {
+        if (rate == playbackRate)
+            return;
+
+        FOLEYS_LOG ("Video playback rate: " << rate);
+        playbackRate = rate;
+        nextFrameToConvert = std::numeric_limits<double>::lowest();
+
+        updateVideoDiscard();
+    }
+
+    /** Lets the decoder drop the frames, that are not referenced, when catching up or playing fast */
+    void updateVideoDiscard()
+    {
+        if (videoContext == nullptr)
+            return;
+
+        const auto skipNonReference = catchUpMode >= CatchUpMode::SkipNonReference || std::abs (playbackRate) >= skipNonReferenceRate;
+        videoContext->skip_frame = skipNonReference ? AVDISCARD_NONREF : AVDISCARD_DEFAULT;
+    }
+
+    double getLastDecodedVideoTime() const
+    {
+        return lastDecodedVideoTime.load();
+    }
+
+    AudioSyncStatistics getAudioSyncStatistics() const
+    {
+        AudioSyncStatistics statistics;
+        statistics.currentError       = syncError.load();
+        statistics.maximumError       = maxSyncError.load();
+        statistics.insertedSamples    = syncInsertedSamples.load();
+        statistics.trimmedSamples     = syncTrimmedSamples.load();
+        statistics.compensatedSamples = syncCompensatedSamples.load();
+        statistics.discontinuities    = syncDiscontinuities.load();
+        return statistics;
+    }
+
+    void setPlanarFramesEnabled (bool shouldProvideYUV)
+    {
+        planarFrames.store (shouldProvideYUV);
     }
 
     juce::Image getStillImage (double seconds, Size size)
@@ -398,7 +524,11 @@ private:
 
     void decodePacket (AVPacket& packet, VideoFifo& videoFifo)
     {
-        int response = avcodec_send_packet (videoContext, &packet);
+        int response = 0;
+        {
+            FOLEYS_MEASURE_STAGE (Decode);
+            response = avcodec_send_packet (videoContext, &packet);
+        }
 
         if (response < 0)
         {
@@ -407,7 +537,10 @@ private:
         }
 
         while (response >= 0) {
-            response = avcodec_receive_frame(videoContext, frame);
+            {
+                FOLEYS_MEASURE_STAGE (Decode);
+                response = avcodec_receive_frame(videoContext, frame);
+            }
             if (response >= 0)
             {
                 AVRational timeBase = av_make_q (1, AV_TIME_BASE);
@@ -416,11 +549,37 @@ private:
                     timeBase = formatContext->streams [videoStreamIdx]->time_base;
                 }
 
+                const auto frameTime = frame->best_effort_timestamp * av_q2d (timeBase);
+                lastDecodedVideoTime = frameTime;
+
+                // this frame is too late to be shown, don't waste time converting it
+                if (catchUpMode != CatchUpMode::Off && frameTime + frame->pkt_duration * av_q2d (timeBase) < skipUntil)
+                    continue;
+
+                // faster than realtime only every n-th frame is shown
+                const auto frameDuration = frame->pkt_duration * av_q2d (timeBase);
+                if (std::abs (playbackRate) > 1.0 && frameDuration > 0.0)
+                {
+                    if (frameTime < nextFrameToConvert)
+                        continue;
+
+                    nextFrameToConvert = frameTime + frameDuration * (std::abs (playbackRate) - 0.5);
+                }
+
                 auto& target = videoFifo.getWritingFrame();
-                if (target.image.getWidth() != frame->width || target.image.getHeight() != frame->height)
-                    target.image = juce::Image (juce::Image::ARGB, frame->width, frame->height, false);
+                target.yuv = planarFrames.load() ? createYUVFrame (frame) : nullptr;
 
-                scaler.convertFrameToImage (target.image, frame);
+                // with the planes the conversion to RGB is left to the consumers, that need the image
+                if (target.yuv == nullptr)
+                {
+                    if (target.image.getWidth() != frame->width || target.image.getHeight() != frame->height)
+                        target.image = juce::Image (juce::Image::ARGB, frame->width, frame->height, false);
+
+                    FOLEYS_MEASURE_STAGE (Conversion);
+                    scaler.convertFrameToImage (target.image, frame);
+                }
+
+                target.imageOutdated.store (target.yuv != nullptr);
                 target.timecode = frame->best_effort_timestamp;
                 videoFifo.finishWriting();
 
@@ -435,14 +594,43 @@ private:
         }
     }
 
+    /** References the decoded frame without copying, if it is in the format of YUVFrame */
+    static std::shared_ptr<YUVFrame> createYUVFrame (const AVFrame* decoded)
+    {
+        if (decoded->format != AV_PIX_FMT_YUV420P || decoded->color_range == AVCOL_RANGE_JPEG)
+            return {};
+
+        auto* reference = av_frame_clone (decoded);
+        if (reference == nullptr)
+            return {};
+
+        auto yuv = std::make_shared<YUVFrame>();
+        yuv->size = { reference->width, reference->height };
+        for (int plane = 0; plane < 3; ++plane)
+        {
+            yuv->planes [plane] = reference->data [plane];
+            yuv->lineSizes [plane] = reference->linesize [plane];
+        }
+
+        yuv->owner = std::shared_ptr<AVFrame> (reference, [](AVFrame* f) { av_frame_free (&f); });
+        return yuv;
+    }
+
     void decodePacket (AVPacket& packet, AudioFifo& audioFifo)
     {
-        int response = avcodec_send_packet (audioContext, &packet);
+        int response = 0;
+        {
+            FOLEYS_MEASURE_STAGE (Decode);
+            response = avcodec_send_packet (audioContext, &packet);
+        }
 
         // decode audio frame
         while (response >= 0)
         {
-            response = avcodec_receive_frame (audioContext, frame);
+            {
+                FOLEYS_MEASURE_STAGE (Decode);
+                response = avcodec_receive_frame (audioContext, frame);
+            }
             if (response == AVERROR(EAGAIN) || response == AVERROR_EOF)
             {
                 break;
@@ -461,31 +649,177 @@ private:
                         " in ms: " << juce::String (frame->best_effort_timestamp * 1000.0 / reader.sampleRate) <<
                         " timebase: " << reader.sampleRate);
 
-            if (frame->extended_data != nullptr  && reader.sampleRate > 0)
+            if (frame->extended_data != nullptr && frame->nb_samples > 0 && outputSampleRate > 0)
             {
-                const int  channels     = av_get_channel_layout_nb_channels (frame->channel_layout);
-                const auto numSamples   = frame->nb_samples;
-                const auto outTimestamp = int64_t (frame->best_effort_timestamp * outputSampleRate / reader.sampleRate);
-                const auto numProduced  = int (numSamples * outputSampleRate / reader.sampleRate);
+                jassert (audioFifo.getNumChannels() == reader.numChannels);
+                writeFrameSynchronised (audioFifo);
+            }
+        }
+    }
 
-                jassert (std::abs (audioFifo.getWritePosition() - outTimestamp) < std::numeric_limits<int>::max());
-                auto offset = int (audioFifo.getWritePosition() - outTimestamp);
+    /**
+     Places the decoded frame at its timestamp in the fifo. Big deviations are corrected at once by
+     inserting silence into gaps or trimming overlaps, small deviations like the drift of a field
+     recorder's clock are corrected smoothly by letting the converter stretch the audio slightly.
+     */
+    void writeFrameSynchronised (AudioFifo& audioFifo)
+    {
+        auto input    = (const uint8_t**) frame->extended_data;
+        auto numInput = frame->nb_samples;
 
-                if (audioConvertBuffer.getNumChannels() != channels || audioConvertBuffer.getNumSamples() < numProduced)
-                    audioConvertBuffer.setSize (channels, numProduced, false, false, true);
+        if (frame->best_effort_timestamp == AV_NOPTS_VALUE)
+        {
+            convertIntoFifo (audioFifo, input, numInput);
+            return;
+        }
 
-                if (outTimestamp < 0)
-                    return;
+        const auto outputRate = juce::roundToInt (outputSampleRate);
+        const auto inputRate  = audioContext->sample_rate;
+        const auto timeBase   = formatContext->streams [audioStreamIdx]->time_base;
+
+        const auto framePosition = av_rescale_q (frame->best_effort_timestamp, timeBase, av_make_q (1, outputRate)) + timestampOffset;
+
+        // the next converted sample lands behind the samples still buffered in the converter
+        const auto expectedPosition = audioFifo.getWritePosition() + swr_get_delay (audioConverterContext, outputRate);
+        auto error = framePosition - expectedPosition;
+
+        if (! seeked && std::abs (error) > discontinuitySeconds * outputRate)
+        {
+            FOLEYS_LOG ("Audio timestamps jumped by " << error << " samples, resynchronising");
+            timestampOffset -= error;
+            error = 0;
+            syncDiscontinuities.fetch_add (1);
+        }
+
+        if (! seeked)
+            updateSyncError (error / double (outputRate));
+
+        if (error < -hardSyncSeconds * outputRate || (seeked && error < 0))
+        {
+            // the frame overlaps the samples already written, drop the beginning
+            const auto numToTrim = int (av_rescale (-error, inputRate, outputRate));
+            if (numToTrim >= numInput)
+            {
+                if (! seeked)
+                    syncTrimmedSamples.fetch_add (av_rescale (numInput, outputRate, inputRate));
+
+                return;
+            }
+
+            input = trimInput (input, numToTrim);
+            numInput -= numToTrim;
 
-                // FIXME: add a strategy to smooth back to zero
-                offset = 0;
+            if (! seeked)
+                syncTrimmedSamples.fetch_add (-error);
 
-                swr_convert (audioConverterContext,
-                             (uint8_t**)audioConvertBuffer.getArrayOfWritePointers(), numProduced,
-                             (const uint8_t**)frame->extended_data, numSamples);
-                juce::AudioBuffer<float> buffer (audioConvertBuffer.getArrayOfWritePointers(), channels, int (offset), int (numProduced - offset));
-                audioFifo.pushSamples (buffer);
+            averageSyncError = 0.0;
+        }
+        else if (error > hardSyncSeconds * outputRate || (seeked && error > 0))
+        {
+            // the stream has a gap. The few samples still buffered in the resampler will follow
+            // after the silence, which is negligible compared to the gap itself.
+            // Keep the space for the frame, any remaining gap is filled before the next frame.
+            const auto space   = audioFifo.getFreeSpace() - swr_get_out_samples (audioConverterContext, numInput) - 1;
+            const auto silence = int (std::min (error, int64_t (space)));
+            if (silence > 0)
+            {
+                audioFifo.pushSilence (silence);
+                if (! seeked)
+                    syncInsertedSamples.fetch_add (silence);
             }
+
+            averageSyncError = 0.0;
+        }
+        else
+        {
+            compensateDrift (error, numInput);
+        }
+
+        seeked = false;
+        convertIntoFifo (audioFifo, input, numInput);
+    }
+
+    /** Averages the small errors and lets the converter add or drop a few samples over the next frame */
+    void compensateDrift (int64_t error, int numInput)
+    {
+        const auto outputRate = juce::roundToInt (outputSampleRate);
+
+        averageSyncError = averageSyncError * syncErrorSmoothing + double (error) * (1.0 - syncErrorSmoothing);
+        if (std::abs (averageSyncError) < softSyncSeconds * outputRate)
+            return;
+
+        const auto distance = int (av_rescale (numInput, outputRate, audioContext->sample_rate));
+        const auto maxDelta = std::max (1, int (distance * maxCompensation));
+        const auto delta    = juce::jlimit (-maxDelta, maxDelta, int (averageSyncError));
+
+        auto response = swr_set_compensation (audioConverterContext, delta, distance);
+        if (response < 0)
+        {
+            FOLEYS_LOG ("Error setting the audio drift compensation: " << getErrorString (response));
+            return;
+        }
+
+        syncCompensatedSamples.fetch_add (std::abs (delta));
+    }
+
+    /** Returns the input pointers advanced by numToTrim samples */
+    const uint8_t** trimInput (const uint8_t** input, int numToTrim)
+    {
+        const auto format = audioContext->sample_fmt;
+        const auto bytesPerSample = av_get_bytes_per_sample (format);
+
+        if (av_sample_fmt_is_planar (format))
+        {
+            for (size_t channel = 0; channel < trimmedInput.size(); ++channel)
+                trimmedInput [channel] = input [channel] + numToTrim * bytesPerSample;
+        }
+        else
+        {
+            trimmedInput [0] = input [0] + numToTrim * bytesPerSample * audioContext->channels;
+        }
+
+        return trimmedInput.data();
+    }
+
+    void updateSyncError (double seconds)
+    {
+        syncError.store (seconds);
+        if (std::abs (seconds) > maxSyncError.load())
+            maxSyncError.store (std::abs (seconds));
+    }
+
+
+    /**
+     The converter writes straight into the free space of the fifo. If that space wraps around
+     the end of the ring, the converter buffers the remainder, which is fetched in a second call.
+     */
+    void convertIntoFifo (AudioFifo& audioFifo, const uint8_t** input, int numInput)
+    {
+        FOLEYS_MEASURE_STAGE (Conversion);
+
+        jassert (swr_get_out_samples (audioConverterContext, numInput) <= audioFifo.getFreeSpace());
+
+        while (true)
+        {
+            int space = 0;
+            auto* const* output = audioFifo.getWritePointers (space);
+            if (space <= 0)
+                break;
+
+            const auto written = swr_convert (audioConverterContext, (uint8_t**)output, space, input, numInput);
+            if (written < 0)
+            {
+                FOLEYS_LOG ("Error converting audio: " << getErrorString (written));
+                break;
+            }
+
+            audioFifo.finishedWrite (written);
+
+            // the remaining input is now buffered inside the converter
+            numInput = 0;
+
+            if (written < space)
+                break;
         }
     }
 
@@ -523,7 +857,40 @@ private:
     uint64_t  channelLayout = AV_CH_LAYOUT_STEREO;
     double    outputSampleRate = {};
 
-    juce::AudioBuffer<float>  audioConvertBuffer;
+    CatchUpMode         catchUpMode     = CatchUpMode::Off;
+    double              skipUntil       = 0.0;
+    bool                waitForKeyFrame = false;
+    double              playbackRate    = 1.0;
+    double              nextFrameToConvert = std::numeric_limits<double>::lowest();
+    std::atomic<double> lastDecodedVideoTime { -1.0 };
+    std::atomic<bool>   planarFrames { false };
+    std::atomic<bool>   endOfStream  { false };
+
+    // from these playback rates on the decoder drops non reference frames, and only decodes key frames
+    static constexpr double skipNonReferenceRate = 1.5;
+    static constexpr double keyFrameOnlyRate     = 3.0;
+
+    // errors above this are corrected at once, below it the audio is stretched
+    static constexpr double hardSyncSeconds      = 0.02;
+    // errors below this are considered timestamp jitter
+    static constexpr double softSyncSeconds      = 0.002;
+    // timestamp jumps above this are not filled, the stream is resynchronised instead
+    static constexpr double discontinuitySeconds = 10.0;
+    // the most the converter may stretch the audio to compensate drift, inaudible at 0.5 %
+    static constexpr double maxCompensation      = 0.005;
+    static constexpr double syncErrorSmoothing   = 0.9;
+
+    int64_t                     timestampOffset  = 0;
+    double                      averageSyncError = 0.0;
+    bool                        seeked           = true;
+    std::vector<const uint8_t*> trimmedInput;
+
+    std::atomic<double>  syncError              { 0.0 };
+    std::atomic<double>  maxSyncError           { 0.0 };
+    std::atomic<int64_t> syncInsertedSamples    { 0 };
+    std::atomic<int64_t> syncTrimmedSamples     { 0 };
+    std::atomic<int64_t> syncCompensatedSamples { 0 };
+    std::atomic<int>     syncDiscontinuities    { 0 };
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (Pimpl)
 };
@@ -566,6 +933,36 @@ void FFmpegReader::readNewData (VideoFifo& videoFifo, AudioFifo& audioFifo)
     pimpl->processPacket (videoFifo, audioFifo);
 }
 
+bool FFmpegReader::isEndOfStream() const
+{
+    return pimpl->isEndOfStream();
+}
+
+void FFmpegReader::setCatchUpMode (CatchUpMode mode, double playheadSeconds)
+{
+    pimpl->setCatchUpMode (mode, playheadSeconds);
+}
+
+void FFmpegReader::setPlaybackRate (double rate)
+{
+    pimpl->setPlaybackRate (rate);
+}
+
+double FFmpegReader::getLastDecodedVideoTime() const
+{
+    return pimpl->getLastDecodedVideoTime();
+}
+
+AudioSyncStatistics FFmpegReader::getAudioSyncStatistics() const
+{
+    return pimpl->getAudioSyncStatistics();
+}
+
+void FFmpegReader::setPlanarFramesEnabled (bool shouldProvideYUV)
+{
+    pimpl->setPlanarFramesEnabled (shouldProvideYUV);
+}
+
 void FFmpegReader::setOutputSampleRate (double sr)
 {
     pimpl->setOutputSampleRate (sr);
@@ -40,6 +40,15 @@ public:
     juce::Image getStillImage (double seconds, Size size) override;
 
     void readNewData (VideoFifo&, AudioFifo&) override;
+    bool isEndOfStream() const override;
+
+    void setCatchUpMode (CatchUpMode mode, double playheadSeconds) override;
+    void setPlaybackRate (double rate) override;
+    double getLastDecodedVideoTime() const override;
+
+    AudioSyncStatistics getAudioSyncStatistics() const override;
+
+    void setPlanarFramesEnabled (bool shouldProvideYUV) override;
 
     void setOutputSampleRate (double sampleRate) override;
 
@@ -29,34 +29,53 @@ struct FFmpegWriter::Pimpl
 {
     Pimpl(FFmpegWriter& owner) : writer (owner)
     {
-        packet = av_packet_alloc();
         openContainer (writer.mediaFile, writer.formatName);
     }
 
     ~Pimpl()
     {
+        stopPipeline();
+
+        videoStreams.clear();
+        audioStreams.clear();
+        videoCopy.reset();
         closeContainer();
-        av_packet_free (&packet);
     }
 
-    int addVideoStream (const VideoStreamSettings& settings, AVCodecID codec)
+    void setMultiThreaded (bool shouldBeMultiThreaded, int numThreads)
+    {
+        multiThreaded = shouldBeMultiThreaded;
+        numConverterThreads = numThreads;
+    }
+
+    int addVideoStream (const VideoStreamSettings& settings, const VideoEncoderSettings& encoderSettings, AVCodecID codec)
     {
         if (formatContext == nullptr)
             return -1;
 
-        if (codec == AV_CODEC_ID_PROBE)
-            codec = av_guess_codec (formatContext->oformat,
-                                    nullptr, writer.mediaFile.getFullPathName().toRawUTF8(),
-                                    nullptr,
-                                    AVMEDIA_TYPE_VIDEO);
+        const AVCodec* encoder = nullptr;
 
-        if (codec <= AV_CODEC_ID_NONE)
-            return -1;
+        if (encoderSettings.codec.isNotEmpty())
+        {
+            encoder = avcodec_find_encoder_by_name (encoderSettings.codec.toRawUTF8());
+        }
+        else
+        {
+            if (codec == AV_CODEC_ID_PROBE)
+                codec = av_guess_codec (formatContext->oformat,
+                                        nullptr, writer.mediaFile.getFullPathName().toRawUTF8(),
+                                        nullptr,
+                                        AVMEDIA_TYPE_VIDEO);
+
+            if (codec <= AV_CODEC_ID_NONE)
+                return -1;
+
+            encoder = avcodec_find_encoder (codec);
+        }
 
-        auto* encoder = avcodec_find_encoder (codec);
         if (encoder == nullptr)
         {
-            FOLEYS_LOG ("No encoder found for codec: " << codec);
+            FOLEYS_LOG ("No encoder found for codec: " << codec << " " << encoderSettings.codec);
             return -1;
         }
 
@@ -72,37 +91,76 @@ struct FFmpegWriter::Pimpl
         auto* context = avcodec_alloc_context3 (encoder);
         context->width = settings.frameSize.width;
         context->height = settings.frameSize.height;
-        context->pix_fmt = AV_PIX_FMT_YUV420P;
+        // the frames arrive as YUV420P, if the encoder can't take that, use its closest format, e.g. 4:2:2 for ProRes
+        context->pix_fmt = encoder->pix_fmts != nullptr ? avcodec_find_best_pix_fmt_of_list (encoder->pix_fmts, AV_PIX_FMT_YUV420P, 0, nullptr)
+                                                        : AV_PIX_FMT_YUV420P;
         context->sample_aspect_ratio = av_make_q (1, 1);
         context->color_range = AVCOL_RANGE_MPEG;
-        context->bit_rate  = 480000;
-        context->gop_size  = 16;
         context->time_base = av_make_q (1, settings.timebase);
 
+        if (encoderSettings.bitRate > 0)
+            context->bit_rate = encoderSettings.bitRate;
+
+        if (encoderSettings.gopSize > 0)
+            context->gop_size = encoderSettings.gopSize;
+
+        context->thread_count = encoderSettings.threadCount;
+        switch (encoderSettings.threading)
+        {
+            case VideoEncoderSettings::Threading::Frame: context->thread_type = FF_THREAD_FRAME; break;
+            case VideoEncoderSettings::Threading::Slice: context->thread_type = FF_THREAD_SLICE; break;
+            case VideoEncoderSettings::Threading::Auto:
+            default: context->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE; break;
+        }
+
         if (encoder->id == AV_CODEC_ID_H264)
             context->ticks_per_frame = 2;
 
-        avcodec_parameters_from_context (stream->codecpar, context);
-
         AVDictionary* options = nullptr;
 
-        if (encoder->id == AV_CODEC_ID_H264) {
-            av_dict_set (&options, "preset", "slow", 0);
-            av_dict_set (&options, "tune", "film", 0);
-            av_opt_set (context->priv_data, "profile", "baseline", AV_OPT_SEARCH_CHILDREN);
-        }
+        // preset, tune and crf are private options of some encoders only, e.g. ProRes or DNxHD would reject them
+        auto hasPrivateOption = [context] (const char* name)
+        {
+            return context->priv_data != nullptr && av_opt_find (context->priv_data, name, nullptr, 0, 0) != nullptr;
+        };
+
+        if (encoderSettings.preset.isNotEmpty() && hasPrivateOption ("preset"))
+            av_dict_set (&options, "preset", encoderSettings.preset.toRawUTF8(), 0);
+
+        if (encoderSettings.tune.isNotEmpty() && hasPrivateOption ("tune"))
+            av_dict_set (&options, "tune", encoderSettings.tune.toRawUTF8(), 0);
+
+        if (encoderSettings.profile.isNotEmpty())
+            av_dict_set (&options, "profile", encoderSettings.profile.toRawUTF8(), 0);
+
+        if (encoderSettings.crf >= 0 && encoderSettings.bitRate <= 0 && hasPrivateOption ("crf"))
+            av_dict_set (&options, "crf", juce::String (encoderSettings.crf).toRawUTF8(), 0);
+
+        for (const auto& key : encoderSettings.options.getAllKeys())
+            av_dict_set (&options, key.toRawUTF8(), encoderSettings.options [key].toRawUTF8(), 0);
 
         int ret = avcodec_open2 (context, encoder, &options);
         if (ret < 0) {
-            DBG ("Cannot open video encoder: " << codec);
+            FOLEYS_LOG ("Cannot open video encoder: " << encoder->name);
+            av_dict_free (&options);
+            avcodec_free_context (&context);
             return -1;
         }
+
+        // the encoder removes the options it consumed
+        AVDictionaryEntry* unused = nullptr;
+        while ((unused = av_dict_get (options, "", unused, AV_DICT_IGNORE_SUFFIX)) != nullptr)
+            FOLEYS_LOG ("Encoder option not used: " << unused->key);
+
         av_dict_free (&options);
 
+        avcodec_parameters_from_context (stream->codecpar, context);
+
         auto descriptor = std::make_unique<VideoStreamDescriptor>();
         descriptor->streamIndex = int (formatContext->nb_streams - 1);
         descriptor->context = context;
         descriptor->settings = settings;
+        descriptor->framePool.setupVideo (context->width, context->height, context->pix_fmt);
 
         videoStreams.push_back (std::move (descriptor));
         return int (videoStreams.size() - 1);
@@ -133,7 +191,8 @@ struct FFmpegWriter::Pimpl
             return -1;
         }
 
-        auto channelLayout = uint64_t (AV_CH_LAYOUT_STEREO);
+        // the default layout for the number of channels, e.g. 5.1 for 6 channels
+        auto channelLayout = uint64_t (av_get_default_channel_layout (std::max (settings.numChannels, 1)));
 
         stream->time_base = av_make_q (1, settings.timebase);
         auto* context = avcodec_alloc_context3 (encoder);
@@ -141,22 +200,34 @@ struct FFmpegWriter::Pimpl
         context->sample_fmt = AV_SAMPLE_FMT_FLTP;
         context->channel_layout = channelLayout;
         context->channels = av_get_channel_layout_nb_channels (channelLayout);
-        context->bit_rate = 64000;
+        context->bit_rate = 32000 * context->channels;
         context->frame_size = settings.defaultNumSamples;
         context->bits_per_raw_sample = 32;
         context->time_base = av_make_q (1, settings.timebase);
-        avcodec_parameters_from_context (stream->codecpar, context);
 
         int ret = avcodec_open2 (context, encoder, nullptr);
         if (ret < 0) {
             FOLEYS_LOG ("Cannot open audio encoder: " << codec);
+            avcodec_free_context (&context);
+            return -1;
         }
 
+        avcodec_parameters_from_context (stream->codecpar, context);
+
         auto descriptor = std::make_unique<AudioStreamDescriptor>();
         descriptor->streamIndex = int (formatContext->nb_streams - 1);
         descriptor->context = context;
         descriptor->settings = settings;
 
+        // most encoders insist on their own frame size, e.g. 1024 for AAC
+        if (context->frame_size > 0 && (encoder->capabilities & AV_CODEC_CAP_VARIABLE_FRAME_SIZE) == 0)
+            descriptor->frameSize = context->frame_size;
+        else
+            descriptor->frameSize = settings.defaultNumSamples;
+
+        descriptor->sampleBuffer.setNumChannels (context->channels);
+        descriptor->framePool.setupAudio (descriptor->frameSize, context->sample_fmt, channelLayout);
+
         audioStreams.push_back (std::move (descriptor));
         return int (audioStreams.size() - 1);
     }
@@ -166,123 +237,129 @@ struct FFmpegWriter::Pimpl
         if (juce::isPositiveAndBelow (stream, audioStreams.size()) == false)
             return;
 
-        auto& descriptor = audioStreams [size_t (stream)];
-        descriptor->sampleBuffer.pushSamples (input);
+        auto& descriptor = *audioStreams [size_t (stream)];
+        updatePerformanceCounters();
 
-        if (multiThreaded == false)
-            while (processStreams());
-    }
+        if (multiThreaded)
+        {
+            auto& encoder = *audioEncoders [size_t (stream)];
+
+            // a block as large as the fifo would never fit, so it is pushed in pieces
+            const auto maxChunk = std::max (1, descriptor.sampleBuffer.getSize() / 2);
+            for (int start = 0; start < input.getNumSamples(); start += maxChunk)
+            {
+                const auto numSamples = std::min (maxChunk, input.getNumSamples() - start);
+                if (! waitForPipeline (encoder, [&] { return descriptor.sampleBuffer.getFreeSpace() > numSamples; }))
+                    return;
+
+                descriptor.sampleBuffer.pushSamples (juce::AudioBuffer<float> (const_cast<float* const*> (input.getArrayOfReadPointers()),
+                                                                               input.getNumChannels(), start, numSamples));
+                encoder.notify();
+            }
 
-    void pushImage (int64_t pos, juce::Image image, int stream)
-    {
-        if (juce::isPositiveAndBelow (stream, videoStreams.size()) == false)
             return;
+        }
 
-        auto& descriptor = videoStreams [size_t (stream)];
-        auto& target = descriptor->videoBuffer.getWritingFrame();
-        target.timecode = pos;
-        target.image = image;
-        descriptor->videoBuffer.finishWriting();
+        descriptor.sampleBuffer.pushSamples (input);
 
-        if (multiThreaded == false)
-            while (processStreams());
+        while (descriptor.sampleBuffer.getAvailableSamples() >= descriptor.frameSize)
+            encodeAudioFrame (descriptor, descriptor.frameSize);
     }
 
-    void encodeVideoFrame (VideoStreamDescriptor& descriptor, juce::Image& image, int64_t timestamp)
+    void pushImage (int64_t pos, juce::Image image, int stream)
     {
-        FOLEYS_LOG ("encodeVideoFrame: " << timestamp << " size: " << image.getWidth() << "x" << image.getHeight());
-
-        jassert (formatContext != nullptr);
-        jassert (descriptor.context != nullptr);
-
-//        {
-//            auto folder = juce::File::getSpecialLocation (juce::File::userDesktopDirectory).getChildFile ("debug");
-//            juce::JPEGImageFormat format;
-//            format.setQuality (0.8);
-//            juce::FileOutputStream stream (folder.getChildFile ("frame" + juce::String (timestamp).paddedLeft ('0', 8) + ".jpg"));
-//            format.writeImageToStream (image, stream);
-//        }
-
-        descriptor.scaler.setupScaler (image.getWidth(),
-                                       image.getHeight(),
-                                       FFmpegVideoScaler::juceInternalFormat,
-                                       descriptor.context->width,
-                                       descriptor.context->height,
-                                       descriptor.context->pix_fmt);
-
-        auto* context = descriptor.context;
+        if (juce::isPositiveAndBelow (stream, videoStreams.size()) == false || image.isNull())
+            return;
 
-        FFmpegFrame frame;
+        auto& descriptor = *videoStreams [size_t (stream)];
+        updatePerformanceCounters();
 
-        frame.frame->width = context->width;
-        frame.frame->height = context->height;
-        frame.frame->format = context->pix_fmt;
-        frame.frame->pts = timestamp;
+        if (multiThreaded)
+        {
+            auto& encoder = *videoEncoders [size_t (stream)];
+            if (! waitForPipeline (encoder, [&] { return encoder.getNumFramesInFlight() < maxFramesInFlight; }))
+                return;
 
-        FOLEYS_LOG ("Start writing video frame, pts: " << timestamp);
+            // the caller draws the next frame into the same image, so a pooled copy is converted
+            converterPool->addJob (new ConvertJob (*this, encoder, encoder.addFrame(), pos, descriptor.imagePool.copyOf (image), {}), true);
+            return;
+        }
 
-        auto ret = av_frame_get_buffer (frame.frame, 1);
-        if (ret < 0)
+        if (auto* frame = convertImage (descriptor, image, pos))
         {
-            FOLEYS_LOG ("Cannot allocate buffers for video frame: " << juce::String (ret));
+            encodeFrame (descriptor.context, frame, descriptor.streamIndex);
+            descriptor.framePool.release (frame);
         }
+    }
 
-//        auto ret = av_frame_make_writable (frame.frame);
-//        if (ret < 0)
-//        {
-//            FOLEYS_LOG ("Error making video frame writeable: " << juce::String (ret));
-//            return;
-//        }
-
-        descriptor.scaler.convertImageToFrame (frame.frame, image);
-        encodeWriteFrame (descriptor.context, frame.frame, descriptor.streamIndex);
+    bool canWriteYUVFrames (int stream) const
+    {
+        return juce::isPositiveAndBelow (stream, videoStreams.size())
+            && videoStreams [size_t (stream)]->context->pix_fmt == AV_PIX_FMT_YUV420P;
     }
 
-    void encodeAudioFrame (AudioStreamDescriptor& descriptor, juce::AudioBuffer<float>& buffer, int64_t timestamp)
+    void pushYUVFrame (int64_t pos, std::shared_ptr<YUVFrame> yuv, int stream)
     {
-        FOLEYS_LOG ("encodeAudioFrame: " << timestamp << " num: " << buffer.getNumSamples());
-        jassert (descriptor.settings.numChannels == buffer.getNumChannels());
-        jassert (descriptor.settings.defaultNumSamples >= buffer.getNumSamples());
+        if (juce::isPositiveAndBelow (stream, videoStreams.size()) == false || yuv == nullptr)
+            return;
+
+        auto& descriptor = *videoStreams [size_t (stream)];
+        updatePerformanceCounters();
 
-        FFmpegFrame frame;
+        if (multiThreaded)
+        {
+            auto& encoder = *videoEncoders [size_t (stream)];
+            if (! waitForPipeline (encoder, [&] { return encoder.getNumFramesInFlight() < maxFramesInFlight; }))
+                return;
 
-        frame.frame->nb_samples   = buffer.getNumSamples();
-        frame.frame->format       = AV_SAMPLE_FMT_FLTP;
-        frame.frame->channel_layout = AV_CH_LAYOUT_STEREO;
-        frame.frame->channels     = av_get_channel_layout_nb_channels (frame.frame->channel_layout);
-        frame.frame->pts          = timestamp;
-        FOLEYS_LOG ("Start writing audio frame, pts: " << timestamp);
+            // YUVFrames are not altered once they are handed out, so no copy needed
+            converterPool->addJob (new ConvertJob (*this, encoder, encoder.addFrame(), pos, {}, yuv), true);
+            return;
+        }
 
-        auto  bufferSize = av_samples_get_buffer_size (nullptr, frame.frame->channels, frame.frame->nb_samples, AVSampleFormat (frame.frame->format), 0);
-        if (descriptor.converterBuffer.getData() == nullptr)
-            descriptor.converterBuffer.malloc (bufferSize);
+        if (auto* frame = convertYUVFrame (descriptor, *yuv, pos))
+        {
+            encodeFrame (descriptor.context, frame, descriptor.streamIndex);
+            descriptor.framePool.release (frame);
+        }
+    }
 
-        auto* samples = reinterpret_cast<float*> (descriptor.converterBuffer.getData());
+    bool addVideoStreamCopy (const std::vector<StreamCopySegment>& segments)
+    {
+        if (formatContext == nullptr || videoCopy != nullptr || segments.empty())
+            return false;
 
-        for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
-            juce::FloatVectorOperations::copy (samples + channel * frame.frame->nb_samples,
-                                               buffer.getReadPointer (channel),
-                                               buffer.getNumSamples());
+        auto copy = std::make_unique<VideoStreamCopy>();
+        if (! copy->prepare (segments, canHideLeadingFrames()))
+            return false;
 
-        if (auto ret = av_frame_get_buffer (frame.frame, 1))
+        auto* stream = avformat_new_stream (formatContext, nullptr);
+        if (stream == nullptr)
         {
-            FOLEYS_LOG ("Cannot allocate buffers for audio frame: " << juce::String (ret));
+            FOLEYS_LOG ("Failed allocating video output stream");
+            return false;
         }
 
-        if (auto ret = av_frame_make_writable (frame.frame))
-        {
-            FOLEYS_LOG ("Error making audio frame writeable: " << juce::String (ret));
+        avcodec_parameters_copy (stream->codecpar, copy->getCodecParameters());
+
+        // the tag of the source container might not be valid in this one, let the muxer choose
+        stream->codecpar->codec_tag = 0;
+        stream->time_base = copy->getTimeBase();
+
+        copy->setOutputStream (int (formatContext->nb_streams - 1));
+        videoCopy = std::move (copy);
+        return true;
+    }
+
+    void copyVideoPackets (double untilSeconds)
+    {
+        if (videoCopy == nullptr)
             return;
-        }
 
-        avcodec_fill_audio_frame (frame.frame,
-                                  frame.frame->channels,
-                                  AVSampleFormat (frame.frame->format),
-                                  descriptor.converterBuffer.getData(),
-                                  bufferSize,
-                                  0);
+        updatePerformanceCounters();
 
-        encodeWriteFrame (descriptor.context, frame.frame, descriptor.streamIndex);
+        const auto timeBase = formatContext->streams [videoCopy->getOutputStream()]->time_base;
+        videoCopy->copyUntil (untilSeconds, timeBase, [this](AVPacket* packet) { writePacket (packet); });
     }
 
     bool startWriting()
@@ -305,224 +382,1134 @@ struct FFmpegWriter::Pimpl
 
         av_dump_format (formatContext, 0, nullptr, 1);
 
+        startPipeline();
+
         writer.started = true;
         return true;
     }
 
     void finishWriting()
     {
-        if (formatContext == nullptr)
+        if (formatContext == nullptr || writer.started == false)
             return;
 
-        for (int idx=0; idx < int (formatContext->nb_streams); ++idx)
+        if (videoCopy != nullptr)
         {
-            auto it = std::find_if (videoStreams.begin(), videoStreams.end(), [idx](const auto& descriptor) { return descriptor->streamIndex == idx; });
-            if (it != videoStreams.end())
-            {
-                auto* context = (*it)->context;
-                if (context->codec != nullptr && context->codec->capabilities & AV_CODEC_CAP_DELAY)
-                {
-                    FOLEYS_LOG ("Flushing video encoder stream " << idx);
-                    while (encodeWriteFrame (context, nullptr, (*it)->streamIndex));
-                }
-            }
-            else
-            {
-                auto it2 = std::find_if (audioStreams.begin(), audioStreams.end(), [idx](const auto& descriptor) { return descriptor->streamIndex == idx; });
-                if (it2 != audioStreams.end())
-                {
-                    auto* context = (*it2)->context;
-                    if (context->codec != nullptr && context->codec->capabilities & AV_CODEC_CAP_DELAY)
-                    {
-                        FOLEYS_LOG ("Flushing audio encoder stream " << idx);
-                        while (encodeWriteFrame (context, nullptr, (*it2)->streamIndex));
-                    }
-                }
-            }
+            copyVideoPackets (std::numeric_limits<double>::max());
+
+            if (muxer != nullptr)
+                muxer->setStreamFinished (videoCopy->getOutputStream());
         }
 
-        if (av_write_trailer (formatContext) == 0)
+        if (muxer != nullptr)
         {
-            videoStreams.clear();
-            audioStreams.clear();
+            // the encoders flush once all frames are through, the muxer ends after the last packet
+            for (auto& encoder : videoEncoders)
+                encoder->finish();
+
+            for (auto& encoder : audioEncoders)
+                encoder->finish();
+
+            if (! muxer->waitForThreadToExit (pipelineTimeout))
+                FOLEYS_LOG ("The muxer didn't finish in time, the file might be incomplete");
+
+            stopPipeline();
         }
         else
         {
-            closeContainer();
+            for (auto& descriptor : videoStreams)
+                flushEncoder (descriptor->context, descriptor->streamIndex);
+
+            for (auto& descriptor : audioStreams)
+            {
+                encodeRemainingSamples (*descriptor);
+                flushEncoder (descriptor->context, descriptor->streamIndex);
+            }
         }
+
+        if (av_write_trailer (formatContext) != 0)
+            FOLEYS_LOG ("Error writing trailer");
+
+        videoStreams.clear();
+        audioStreams.clear();
+        videoCopy.reset();
+        closeContainer();
     }
 
-    class WriteThread : public juce::TimeSliceClient
+private:
+
+    /**
+     Stage 2 for video: puts the frames from the ConvertJobs back into order and encodes them.
+     There is one encoder thread per stream.
+     */
+    class VideoEncoderThread : public juce::Thread
     {
     public:
-        WriteThread (Pimpl& o) : owner (o) {}
-        int useTimeSlice() override
+        VideoEncoderThread (Pimpl& o, VideoStreamDescriptor& descriptorToUse)
+          : juce::Thread ("Video Encoder"),
+            owner (o),
+            descriptor (descriptorToUse)
         {
-            if (owner.multiThreaded == false)
-                return 1000;
+        }
 
-            if (owner.processStreams())
-                return 0;
+        ~VideoEncoderThread() override
+        {
+            stopThread (1000);
 
-            return 50;
+            for (auto& frame : convertedFrames)
+                av_frame_free (&frame.second);
         }
 
-    private:
-        Pimpl& owner;
-        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (WriteThread)
-    };
+        /** Called by the producer, returns the sequence number for the new frame */
+        int64_t addFrame()
+        {
+            ++numFramesInFlight;
+            return numFramesSubmitted++;
+        }
 
-private:
+        /** Called by the ConvertJob. A nullptr frame means the conversion failed and the frame is skipped */
+        void addConvertedFrame (int64_t sequence, AVFrame* frame)
+        {
+            {
+                const juce::ScopedLock sl (lock);
+                convertedFrames [sequence] = frame;
+            }
+            notify();
+        }
 
-    bool processStreams()
-    {
-        // find oldest stream
-        bool found = false;
-        size_t next = 0;
-        bool   video = false;
-        auto   pts = std::numeric_limits<double>::max();
+        void finish()
+        {
+            finishing.store (true);
+            notify();
+        }
+
+        int getNumFramesInFlight() const { return numFramesInFlight.load(); }
 
-        for (size_t s=0; s < audioStreams.size() && !found; ++s)
+        VideoStreamDescriptor& getDescriptor() { return descriptor; }
+
+        void run() override
         {
-            auto& descriptor = audioStreams [s];
-            auto  streamPTS  = double (descriptor->sampleBuffer.getReadPosition()) / descriptor->settings.timebase;
-            if (descriptor->sampleBuffer.getAvailableSamples() >= descriptor->settings.defaultNumSamples
-                && streamPTS < pts)
+            while (! threadShouldExit())
             {
-                next = s;
-                pts = streamPTS;
-                found = true;
+                bool     hasFrame = false;
+                AVFrame* frame = nullptr;
+
+                {
+                    const juce::ScopedLock sl (lock);
+                    auto it = convertedFrames.find (nextSequence);
+                    if (it != convertedFrames.end())
+                    {
+                        frame = it->second;
+                        convertedFrames.erase (it);
+                        ++nextSequence;
+                        hasFrame = true;
+                    }
+                }
+
+                if (hasFrame)
+                {
+                    if (frame != nullptr)
+                    {
+                        FOLEYS_PERFORMANCE_SOURCE (owner.performanceCounters.load());
+                        owner.encodeFrame (descriptor.context, frame, descriptor.streamIndex);
+                        descriptor.framePool.release (frame);
+                    }
+
+                    --numFramesInFlight;
+                    owner.pipelineProgress.signal();
+                    continue;
+                }
+
+                if (finishing.load() && nextSequence == numFramesSubmitted.load())
+                {
+                    owner.flushEncoder (descriptor.context, descriptor.streamIndex);
+                    owner.muxer->setStreamFinished (descriptor.streamIndex);
+                    return;
+                }
+
+                wait (20);
             }
         }
 
-        for (size_t s=0; s < videoStreams.size() && !found; ++s)
+    private:
+        Pimpl&                 owner;
+        VideoStreamDescriptor& descriptor;
+
+        juce::CriticalSection       lock;
+        std::map<int64_t, AVFrame*> convertedFrames;
+        int64_t                     nextSequence = 0;
+
+        std::atomic<int64_t> numFramesSubmitted { 0 };
+        std::atomic<int>     numFramesInFlight  { 0 };
+        std::atomic<bool>    finishing          { false };
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (VideoEncoderThread)
+    };
+
+    /**
+     Stage 1: converts a juce::Image or a YUVFrame into an AVFrame in the pixel format of the encoder.
+     Several of these jobs run in parallel in the converterPool. The image is a copy from the
+     stream's imagePool and is handed back after the conversion.
+     */
+    class ConvertJob : public juce::ThreadPoolJob
+    {
+    public:
+        ConvertJob (Pimpl& o, VideoEncoderThread& encoderToUse, int64_t sequenceNumber, int64_t timestampToUse,
+                    juce::Image imageToConvert, std::shared_ptr<YUVFrame> yuvToConvert)
+          : juce::ThreadPoolJob ("Convert video frame"),
+            owner (o),
+            encoder (encoderToUse),
+            sequence (sequenceNumber),
+            timestamp (timestampToUse),
+            image (std::move (imageToConvert)),
+            yuv (yuvToConvert),
+            counters (o.performanceCounters.load())
         {
-//            auto& descriptor = videoStreams [s];
-//            auto  streamPTS  = double (descriptor->videoBuffer.getLowestTimeCode()) / descriptor->settings.timebase;
-//            if (descriptor->videoBuffer.getNumAvailableFrames() > 0 && streamPTS < pts)
-//            {
-//                next = s;
-//                pts = streamPTS;
-//                video = true;
-//                found = true;
-//            }
         }
 
-        if (found)
+        juce::ThreadPoolJob::JobStatus runJob() override
         {
-            if (video)
+            FOLEYS_PERFORMANCE_SOURCE (counters);
+            auto& descriptor = encoder.getDescriptor();
+
+            if (yuv != nullptr)
             {
-                auto& stream = videoStreams [next];
-                auto& frame  = stream->videoBuffer.getWritingFrame();
-                encodeVideoFrame (*stream, frame.image, frame.timecode);
-                stream->videoBuffer.finishWriting();
+                encoder.addConvertedFrame (sequence, owner.convertYUVFrame (descriptor, *yuv, timestamp));
             }
             else
             {
-                auto& stream = audioStreams [next];
-                juce::AudioBuffer<float> buffer (stream->settings.numChannels, stream->settings.defaultNumSamples);
-                juce::AudioSourceChannelInfo info (&buffer, 0, buffer.getNumSamples());
-                stream->sampleBuffer.pullSamples (info);
-                encodeAudioFrame (*stream, buffer, stream->sampleBuffer.getReadPosition());
+                encoder.addConvertedFrame (sequence, owner.convertImage (descriptor, image, timestamp));
+                descriptor.imagePool.release (std::move (image));
             }
-            return true;
+
+            return juce::ThreadPoolJob::jobHasFinished;
         }
 
-        return false;
-    }
+    private:
+        Pimpl&                    owner;
+        VideoEncoderThread&       encoder;
+        const int64_t             sequence;
+        const int64_t             timestamp;
+        juce::Image               image;
+        std::shared_ptr<YUVFrame> yuv;
+        PerformanceCounters*      counters = nullptr;
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ConvertJob)
+    };
 
-    void openContainer (juce::File file, juce::String format)
+    /**
+     Stage 2 for audio: encodes the samples from the stream's AudioFifo, as soon as a
+     full frame is available.
+     */
+    class AudioEncoderThread : public juce::Thread
     {
-        if (format.isEmpty())
-            avformat_alloc_output_context2 (&formatContext, nullptr, nullptr, file.getFullPathName().toRawUTF8());
-        else
-            avformat_alloc_output_context2 (&formatContext, nullptr, format.toRawUTF8(), file.getFullPathName().toRawUTF8());
-
-        if (formatContext == nullptr)
+    public:
+        AudioEncoderThread (Pimpl& o, AudioStreamDescriptor& descriptorToUse)
+          : juce::Thread ("Audio Encoder"),
+            owner (o),
+            descriptor (descriptorToUse)
         {
-            FOLEYS_LOG ("Could not open output with format " + format);
-            return;
         }
 
-        writeFile = file;
-        writer.opened = true;
-    }
+        ~AudioEncoderThread() override
+        {
+            stopThread (1000);
+        }
 
-    void closeContainer()
-    {
-        writer.opened = false;
-        writer.started = false;
+        void finish()
+        {
+            finishing.store (true);
+            notify();
+        }
 
-        if (formatContext != nullptr)
+        void run() override
         {
-            avformat_free_context (formatContext);
-            formatContext = nullptr;
+            while (! threadShouldExit())
+            {
+                if (descriptor.sampleBuffer.getAvailableSamples() >= descriptor.frameSize)
+                {
+                    FOLEYS_PERFORMANCE_SOURCE (owner.performanceCounters.load());
+                    owner.encodeAudioFrame (descriptor, descriptor.frameSize);
+                    owner.pipelineProgress.signal();
+                    continue;
+                }
+
+                if (finishing.load())
+                {
+                    owner.encodeRemainingSamples (descriptor);
+                    owner.flushEncoder (descriptor.context, descriptor.streamIndex);
+                    owner.muxer->setStreamFinished (descriptor.streamIndex);
+                    return;
+                }
+
+                wait (20);
+            }
         }
-    }
 
-    bool encodeWriteFrame (AVCodecContext* codecContext, AVFrame* frame, int streamIndex)
-    {
-        jassert (formatContext != nullptr);
+    private:
+        Pimpl&                 owner;
+        AudioStreamDescriptor& descriptor;
+        std::atomic<bool>      finishing { false };
 
-        avcodec_send_frame (codecContext, frame);
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (AudioEncoderThread)
+    };
 
-        auto ret = avcodec_receive_packet (codecContext, packet);
-        packet->stream_index = streamIndex;
-        av_packet_rescale_ts (packet, codecContext->time_base, formatContext->streams [streamIndex]->time_base);
-        if (ret == AVERROR (EAGAIN) || ret == AVERROR_EOF)
+    /**
+     Stage 3: collects the packets of all encoders and writes them in DTS order. A packet
+     is only written, when every unfinished stream has a packet queued, unless one queue
+     is full. av_interleaved_write_frame takes care of the remaining reordering.
+     */
+    class MuxerThread : public juce::Thread
+    {
+    public:
+        MuxerThread (Pimpl& o, int numStreams)
+          : juce::Thread ("Muxer"),
+            owner (o),
+            streams (size_t (numStreams))
         {
-            av_packet_unref (packet);
-            return false;
         }
 
-        if (av_interleaved_write_frame (formatContext, packet) < 0)
-            FOLEYS_LOG ("Error muxing packet");
+        ~MuxerThread() override
+        {
+            stopThread (1000);
 
-        av_packet_unref (packet);
+            for (auto& stream : streams)
+                for (auto* packet : stream.packets)
+                    av_packet_free (&packet);
+        }
 
-        return true;
-    }
+        /** Takes ownership of the packet. Blocks while the queues are full */
+        void addPacket (AVPacket* packet)
+        {
+            {
+                FOLEYS_MEASURE_STAGE (Wait);
+                while (numQueuedPackets.load() >= maxPacketsPerStream * int (streams.size()) && isThreadRunning())
+                {
+                    if (juce::Thread::currentThreadShouldExit())
+                    {
+                        av_packet_free (&packet);
+                        return;
+                    }
 
+                    spaceAvailable.wait (20);
+                }
+            }
 
-    //==============================================================================
+            {
+                const juce::ScopedLock sl (lock);
+                streams [size_t (packet->stream_index)].packets.push_back (packet);
+                ++numQueuedPackets;
+            }
+            notify();
+        }
 
-    FFmpegWriter& writer;
-    juce::File    writeFile;
+        void setStreamFinished (int streamIndex)
+        {
+            {
+                const juce::ScopedLock sl (lock);
+                streams [size_t (streamIndex)].finished = true;
+            }
+            notify();
+        }
 
-    AVFormatContext* formatContext = nullptr;
-    AVPacket*        packet        = nullptr;
+        void run() override
+        {
+            while (! threadShouldExit())
+            {
+                AVPacket* packet = nullptr;
+                bool      allFinished = false;
 
-    std::vector<std::unique_ptr<VideoStreamDescriptor>> videoStreams;
-    std::vector<std::unique_ptr<AudioStreamDescriptor>> audioStreams;
+                {
+                    const juce::ScopedLock sl (lock);
+                    packet = popNextPacket();
+                    allFinished = packet == nullptr && std::all_of (streams.begin(), streams.end(), [](const auto& stream)
+                                                                    { return stream.finished && stream.packets.empty(); });
+                }
 
-    WriteThread writeThread { *this };
-    bool multiThreaded = false;
+                if (packet != nullptr)
+                {
+                    --numQueuedPackets;
+                    spaceAvailable.signal();
 
-    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (Pimpl)
-};
+                    if (av_interleaved_write_frame (owner.formatContext, packet) < 0)
+                        FOLEYS_LOG ("Error muxing packet");
 
-//==============================================================================
+                    av_packet_free (&packet);
+                    continue;
+                }
 
-FFmpegWriter::FFmpegWriter (juce::File file, juce::String format)
-  : mediaFile (file),
-    formatName (format)
-{
-    pimpl = std::make_unique<Pimpl> (*this);
-}
+                if (allFinished)
+                    return;
 
-juce::File FFmpegWriter::getMediaFile() const
-{
-    return mediaFile;
-}
+                wait (20);
+            }
+        }
 
-bool FFmpegWriter::isOpenedOk() const
-{
-    return opened;
-}
+    private:
+        struct StreamQueue
+        {
+            std::deque<AVPacket*> packets;
+            bool                  finished = false;
+        };
+
+        AVPacket* popNextPacket()
+        {
+            StreamQueue* next = nullptr;
+            bool waitingForStream = false;
+            bool queueFull = false;
+
+            for (auto& stream : streams)
+            {
+                if (stream.packets.empty())
+                {
+                    waitingForStream |= ! stream.finished;
+                    continue;
+                }
+
+                queueFull |= int (stream.packets.size()) >= maxPacketsPerStream;
+
+                if (next == nullptr || isEarlier (stream.packets.front(), next->packets.front()))
+                    next = &stream;
+            }
+
+            if (next == nullptr || (waitingForStream && ! queueFull))
+                return nullptr;
+
+            auto* packet = next->packets.front();
+            next->packets.pop_front();
+            return packet;
+        }
+
+        bool isEarlier (const AVPacket* a, const AVPacket* b) const
+        {
+            auto getTimestamp = [](const AVPacket* packet) { return packet->dts != AV_NOPTS_VALUE ? packet->dts : packet->pts; };
+
+            return av_compare_ts (getTimestamp (a), owner.formatContext->streams [a->stream_index]->time_base,
+                                  getTimestamp (b), owner.formatContext->streams [b->stream_index]->time_base) < 0;
+        }
+
+        static constexpr int maxPacketsPerStream = 64;
+
+        Pimpl&                   owner;
+        juce::CriticalSection    lock;
+        std::vector<StreamQueue> streams;
+        std::atomic<int>         numQueuedPackets { 0 };
+        juce::WaitableEvent      spaceAvailable;
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MuxerThread)
+    };
+
+    /**
+     Copies the compressed video of a list of cuts into one output stream. Each cut has to start
+     on a key frame. Only the first cut may start in between, if the container hides the leading
+     frames with an edit list. In streams with reordered frames (B-frames) the cuts also have to
+     end on a key frame, only the last one may end in between and shows the few frames, that were
+     decoded ahead.
+     */
+    class VideoStreamCopy
+    {
+    public:
+        VideoStreamCopy() = default;
+
+        ~VideoStreamCopy()
+        {
+            closeInput();
+            av_packet_free (&packet);
+            avcodec_parameters_free (&codecParameters);
+        }
+
+        /** Locates the key frames of all segments. Returns false, if a segment can't be copied exactly */
+        bool prepare (const std::vector<StreamCopySegment>& segmentsToCopy, bool canHideLeadingFrames)
+        {
+            for (size_t i = 0; i < segmentsToCopy.size(); ++i)
+            {
+                const auto& range = segmentsToCopy [i];
+                if (! openInput (range.source))
+                    return false;
+
+                auto* stream = input->streams [inputStream];
+
+                if (codecParameters == nullptr)
+                {
+                    codecParameters = avcodec_parameters_alloc();
+                    avcodec_parameters_copy (codecParameters, stream->codecpar);
+                    timeBase = stream->time_base;
+                }
+                else if (! isCompatible (*stream->codecpar))
+                {
+                    FOLEYS_LOG ("Stream copy: codec parameters of " << range.source.getFileName() << " don't match");
+                    return false;
+                }
+
+                Segment segment;
+                segment.source      = range.source;
+                segment.timeBase    = stream->time_base;
+                segment.tolerance   = getHalfFrame (stream);
+                segment.start       = toStreamTime (range.sourceStart, stream->time_base);
+                segment.end         = toStreamTime (range.sourceEnd, stream->time_base);
+                segment.targetStart = range.targetStart;
+                segment.keyFrame    = findKeyFrame (segment.start, segment.tolerance);
+
+                if (segment.keyFrame == AV_NOPTS_VALUE)
+                {
+                    FOLEYS_LOG ("Stream copy: no key frame found in " << range.source.getFileName());
+                    return false;
+                }
+
+                if (segment.start - segment.keyFrame <= segment.tolerance)
+                {
+                    segment.start = segment.keyFrame;
+                }
+                else if (i > 0 || range.targetStart > 0.0 || ! canHideLeadingFrames)
+                {
+                    FOLEYS_LOG ("Stream copy: cut at " << range.sourceStart << " in " << range.source.getFileName() << " is not on a key frame");
+                    return false;
+                }
+
+                // a cut to the end of the file has no frames, that were decoded ahead
+                if (segment.end + 2 * segment.tolerance >= getEndOfStream (stream))
+                {
+                    segment.end = std::numeric_limits<int64_t>::max();
+                }
+                else if (stream->codecpar->video_delay > 0 && i + 1 < segmentsToCopy.size())
+                {
+                    const auto endKeyFrame = findKeyFrame (segment.end, segment.tolerance);
+                    if (endKeyFrame == AV_NOPTS_VALUE || std::abs (endKeyFrame - segment.end) > segment.tolerance)
+                    {
+                        FOLEYS_LOG ("Stream copy: cut at " << range.sourceEnd << " in " << range.source.getFileName() << " is not on a key frame");
+                        return false;
+                    }
+
+                    segment.end = endKeyFrame;
+                }
+
+                segments.push_back (segment);
+            }
+
+            closeInput();
+            return codecParameters != nullptr;
+        }
+
+        const AVCodecParameters* getCodecParameters() const { return codecParameters; }
+        AVRational getTimeBase() const { return timeBase; }
+
+        void setOutputStream (int index) { outputStream = index; }
+        int getOutputStream() const { return outputStream; }
+
+        /** Hands all packets up to untilSeconds in the output to writePacket, which takes ownership */
+        template<typename WriteFunction>
+        void copyUntil (double untilSeconds, AVRational outputTimeBase, WriteFunction&& writePacket)
+        {
+            FOLEYS_MEASURE_STAGE (Demux);
+
+            while (currentSegment < segments.size())
+            {
+                auto& segment = segments [currentSegment];
+
+                if (input == nullptr && ! startSegment (segment))
+                {
+                    FOLEYS_LOG ("Stream copy: could not reopen " << segment.source.getFileName());
+                    ++currentSegment;
+                    continue;
+                }
+
+                if (! hasPendingPacket)
+                {
+                    if (av_read_frame (input, packet) < 0)
+                    {
+                        nextSegment();
+                        continue;
+                    }
+
+                    if (packet->stream_index != inputStream || ! belongsToSegment (segment))
+                    {
+                        av_packet_unref (packet);
+                        continue;
+                    }
+
+                    if (packet->dts >= segment.end || ((packet->flags & AV_PKT_FLAG_KEY) && packet->pts >= segment.end))
+                    {
+                        av_packet_unref (packet);
+                        nextSegment();
+                        continue;
+                    }
+
+                    hasPendingPacket = true;
+                }
+
+                const auto offset = llrint (segment.targetStart / av_q2d (outputTimeBase));
+                const auto dts    = av_rescale_q (packet->dts - segment.start, segment.timeBase, outputTimeBase) + offset;
+
+                if (dts * av_q2d (outputTimeBase) > untilSeconds)
+                    return;
+
+                auto* output = av_packet_alloc();
+                av_packet_move_ref (output, packet);
+                hasPendingPacket = false;
+
+                output->stream_index = outputStream;
+                output->pos          = -1;
+                output->dts          = dts;
+                output->pts          = av_rescale_q (output->pts - segment.start, segment.timeBase, outputTimeBase) + offset;
+                output->duration     = av_rescale_q (output->duration, segment.timeBase, outputTimeBase);
+
+                // cuts from different sources may disagree by a tick, the muxer insists on increasing DTS
+                if (lastDts != AV_NOPTS_VALUE && output->dts <= lastDts)
+                {
+                    output->dts = lastDts + 1;
+                    output->pts = std::max (output->pts, output->dts);
+                }
+
+                lastDts = output->dts;
+                writePacket (output);
+            }
+        }
+
+    private:
+        struct Segment
+        {
+            juce::File source;
+            AVRational timeBase  { 1, 1 };
+            int64_t    tolerance = 0;
+            int64_t    start     = 0;
+            int64_t    end       = 0;
+            int64_t    keyFrame  = AV_NOPTS_VALUE;
+            double     targetStart = 0.0;
+        };
+
+        bool openInput (const juce::File& file)
+        {
+            closeInput();
+
+            if (avformat_open_input (&input, file.getFullPathName().toRawUTF8(), nullptr, nullptr) < 0)
+            {
+                FOLEYS_LOG ("Stream copy: could not open " << file.getFullPathName());
+                return false;
+            }
+
+            if (avformat_find_stream_info (input, nullptr) < 0)
+            {
+                closeInput();
+                return false;
+            }
+
+            inputStream = av_find_best_stream (input, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+            if (inputStream < 0)
+            {
+                closeInput();
+                return false;
+            }
+
+            if (packet == nullptr)
+                packet = av_packet_alloc();
+
+            return true;
+        }
+
+        void closeInput()
+        {
+            if (hasPendingPacket)
+                av_packet_unref (packet);
+
+            hasPendingPacket = false;
+            avformat_close_input (&input);
+        }
+
+        bool startSegment (const Segment& segment)
+        {
+            if (! openInput (segment.source))
+                return false;
+
+            waitingForKeyFrame = true;
+            return av_seek_frame (input, inputStream, segment.keyFrame, AVSEEK_FLAG_BACKWARD) >= 0;
+        }
+
+        void nextSegment()
+        {
+            closeInput();
+            ++currentSegment;
+        }
+
+        /** Skips everything before the segment's key frame, including the leading frames, that reference the previous GOP */
+        bool belongsToSegment (const Segment& segment)
+        {
+            if (packet->pts == AV_NOPTS_VALUE)
+                packet->pts = packet->dts;
+
+            if (packet->dts == AV_NOPTS_VALUE)
+                packet->dts = packet->pts;
+
+            if (packet->pts == AV_NOPTS_VALUE)
+                return false;
+
+            if (waitingForKeyFrame)
+            {
+                if ((packet->flags & AV_PKT_FLAG_KEY) == 0 || packet->pts < segment.keyFrame)
+                    return false;
+
+                waitingForKeyFrame = false;
+            }
+
+            return packet->pts >= segment.keyFrame;
+        }
+
+        /** Returns the presentation time of the last key frame at or before position, or AV_NOPTS_VALUE */
+        int64_t findKeyFrame (int64_t position, int64_t tolerance)
+        {
+            const auto limit = position + tolerance;
+            auto seekTarget  = position;
+            auto* probe      = av_packet_alloc();
+
+            // the demuxer seeks by DTS, so a key frame might be presented later than expected. Then try a bit earlier
+            for (int attempt = 0; attempt < 3; ++attempt)
+            {
+                if (av_seek_frame (input, inputStream, seekTarget, AVSEEK_FLAG_BACKWARD) < 0)
+                    break;
+
+                auto keyFrame = int64_t (AV_NOPTS_VALUE);
+                while (av_read_frame (input, probe) >= 0)
+                {
+                    if (probe->stream_index == inputStream)
+                    {
+                        const auto pts = probe->pts != AV_NOPTS_VALUE ? probe->pts : probe->dts;
+                        const auto dts = probe->dts != AV_NOPTS_VALUE ? probe->dts : probe->pts;
+
+                        if ((probe->flags & AV_PKT_FLAG_KEY) && pts != AV_NOPTS_VALUE && pts <= limit)
+                            keyFrame = pts;
+
+                        if (dts != AV_NOPTS_VALUE && dts > limit)
+                        {
+                            av_packet_unref (probe);
+                            break;
+                        }
+                    }
+
+                    av_packet_unref (probe);
+                }
+
+                if (keyFrame != AV_NOPTS_VALUE)
+                {
+                    av_packet_free (&probe);
+                    return keyFrame;
+                }
+
+                seekTarget -= av_rescale_q (1, av_make_q (1, 1), input->streams [inputStream]->time_base);
+            }
+
+            av_packet_free (&probe);
+            return AV_NOPTS_VALUE;
+        }
+
+        bool isCompatible (const AVCodecParameters& other) const
+        {
+            return other.codec_id == codecParameters->codec_id
+                && other.width    == codecParameters->width
+                && other.height   == codecParameters->height
+                && other.format   == codecParameters->format
+                && other.extradata_size == codecParameters->extradata_size
+                && (other.extradata_size == 0 || std::memcmp (other.extradata, codecParameters->extradata, size_t (other.extradata_size)) == 0);
+        }
+
+        int64_t getHalfFrame (AVStream* stream) const
+        {
+            const auto frameRate = av_guess_frame_rate (input, stream, nullptr);
+            if (frameRate.num > 0 && frameRate.den > 0)
+                return std::max (int64_t (1), av_rescale_q (1, av_inv_q (frameRate), stream->time_base) / 2);
+
+            return av_rescale_q (1, av_make_q (1, 1000), stream->time_base);
+        }
+
+        int64_t getEndOfStream (AVStream* stream) const
+        {
+            const auto start = stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0;
+
+            if (stream->duration != AV_NOPTS_VALUE)
+                return start + stream->duration;
+
+            if (input->duration != AV_NOPTS_VALUE)
+                return start + av_rescale_q (input->duration, AV_TIME_BASE_Q, stream->time_base);
+
+            return std::numeric_limits<int64_t>::max();
+        }
+
+        static int64_t toStreamTime (double seconds, AVRational streamTimeBase)
+        {
+            return llrint (seconds / av_q2d (streamTimeBase));
+        }
+
+        std::vector<Segment> segments;
+        size_t               currentSegment = 0;
+
+        AVCodecParameters* codecParameters = nullptr;
+        AVRational         timeBase { 1, 1 };
+        int                outputStream = -1;
+
+        AVFormatContext* input       = nullptr;
+        int              inputStream = -1;
+        AVPacket*        packet      = nullptr;
+        bool             hasPendingPacket   = false;
+        bool             waitingForKeyFrame = false;
+        int64_t          lastDts = AV_NOPTS_VALUE;
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (VideoStreamCopy)
+    };
+
+    //==============================================================================
+
+    void startPipeline()
+    {
+        if (multiThreaded == false)
+            return;
+
+        muxer = std::make_unique<MuxerThread> (*this, int (formatContext->nb_streams));
+        muxer->startThread();
+
+        // the encoders bring their own threads, so leave some cores for them
+        const auto numThreads = numConverterThreads > 0 ? numConverterThreads
+                                                        : juce::jlimit (1, 4, juce::SystemStats::getNumCpus() / 2);
+        converterPool = std::make_unique<juce::ThreadPool> (numThreads);
+        maxFramesInFlight = 2 * numThreads + 2;
+
+        for (auto& descriptor : videoStreams)
+        {
+            videoEncoders.push_back (std::make_unique<VideoEncoderThread> (*this, *descriptor));
+            videoEncoders.back()->startThread();
+        }
+
+        for (auto& descriptor : audioStreams)
+        {
+            audioEncoders.push_back (std::make_unique<AudioEncoderThread> (*this, *descriptor));
+            audioEncoders.back()->startThread();
+        }
+    }
+
+    void stopPipeline()
+    {
+        // the jobs reference the encoders and the encoders the muxer, so tear down in this order
+        if (converterPool != nullptr)
+            converterPool->removeAllJobs (true, 2000);
+
+        converterPool.reset();
+        videoEncoders.clear();
+        audioEncoders.clear();
+        muxer.reset();
+    }
+
+    /** Blocks the producer while the next stage is busy. Returns false, if the stage stopped working */
+    template<typename Predicate>
+    bool waitForPipeline (juce::Thread& stage, Predicate&& canContinue)
+    {
+        FOLEYS_MEASURE_STAGE (Wait);
+
+        const auto start = juce::Time::getMillisecondCounter();
+
+        while (! canContinue())
+        {
+            if (! stage.isThreadRunning())
+                return false;
+
+            if (juce::Time::getMillisecondCounter() - start > juce::uint32 (pipelineTimeout))
+            {
+                FOLEYS_LOG ("The " << stage.getThreadName() << " stopped making progress, dropping data");
+                return false;
+            }
+
+            pipelineProgress.wait (20);
+        }
+
+        return true;
+    }
+
+    void updatePerformanceCounters()
+    {
+        if (auto* counters = PerformanceCounters::getCurrent())
+            performanceCounters.store (counters);
+    }
+
+    AVFrame* convertImage (VideoStreamDescriptor& descriptor, const juce::Image& image, int64_t timestamp)
+    {
+        FOLEYS_LOG ("convertImage: " << timestamp << " size: " << image.getWidth() << "x" << image.getHeight());
+
+        auto* context = descriptor.context;
+        auto* frame = descriptor.framePool.acquire();
+        if (frame == nullptr)
+            return nullptr;
+
+        frame->pts = timestamp;
+
+        auto scaler = getScaler();
+        scaler->setupScaler (image.getWidth(),
+                             image.getHeight(),
+                             FFmpegVideoScaler::juceInternalFormat,
+                             context->width,
+                             context->height,
+                             context->pix_fmt);
+
+        {
+            FOLEYS_MEASURE_STAGE (Conversion);
+            scaler->convertImageToFrame (frame, image);
+        }
+
+        releaseScaler (std::move (scaler));
+        return frame;
+    }
+
+    /** Copies the planes, if the size matches, otherwise the frame is scaled */
+    AVFrame* convertYUVFrame (VideoStreamDescriptor& descriptor, const YUVFrame& yuv, int64_t timestamp)
+    {
+        auto* context = descriptor.context;
+        auto* frame = descriptor.framePool.acquire();
+        if (frame == nullptr)
+            return nullptr;
+
+        frame->pts = timestamp;
+
+        FOLEYS_MEASURE_STAGE (Conversion);
+
+        const uint8_t* planes [4] = { yuv.planes [0], yuv.planes [1], yuv.planes [2], nullptr };
+        const int lineSizes [4]   = { yuv.lineSizes [0], yuv.lineSizes [1], yuv.lineSizes [2], 0 };
+
+        if (yuv.size.width == context->width && yuv.size.height == context->height && context->pix_fmt == AV_PIX_FMT_YUV420P)
+        {
+            av_image_copy (frame->data, frame->linesize, planes, lineSizes, AV_PIX_FMT_YUV420P, context->width, context->height);
+            return frame;
+        }
+
+        auto scaler = getScaler();
+        scaler->setupScaler (yuv.size.width,
+                             yuv.size.height,
+                             AV_PIX_FMT_YUV420P,
+                             context->width,
+                             context->height,
+                             context->pix_fmt);
+
+        scaler->convertPlanesToFrame (frame, planes, lineSizes, yuv.size.height);
+
+        releaseScaler (std::move (scaler));
+        return frame;
+    }
+
+    /** The SwsContext is not thread safe, so each conversion borrows a scaler from this pool */
+    std::unique_ptr<FFmpegVideoScaler> getScaler()
+    {
+        const juce::ScopedLock sl (scalerLock);
+        if (idleScalers.empty())
+            return std::make_unique<FFmpegVideoScaler>();
+
+        auto scaler = std::move (idleScalers.back());
+        idleScalers.pop_back();
+        return scaler;
+    }
+
+    void releaseScaler (std::unique_ptr<FFmpegVideoScaler> scaler)
+    {
+        const juce::ScopedLock sl (scalerLock);
+        idleScalers.push_back (std::move (scaler));
+    }
+
+    void encodeAudioFrame (AudioStreamDescriptor& descriptor, int numSamples)
+    {
+        jassert (numSamples <= descriptor.frameSize);
+
+        auto* frame = descriptor.framePool.acquire();
+        if (frame == nullptr)
+        {
+            // skipping advances the read position, so the following frames keep their timestamps
+            descriptor.sampleBuffer.skipSamples (numSamples);
+            return;
+        }
+
+        const auto timestamp = descriptor.sampleBuffer.getReadPosition();
+        FOLEYS_LOG ("encodeAudioFrame: " << timestamp << " num: " << numSamples);
+
+        frame->nb_samples = numSamples;
+        frame->pts        = timestamp;
+
+        // the fifo copies the samples straight into the planes of the frame
+        juce::AudioBuffer<float> planes (reinterpret_cast<float* const*> (frame->extended_data), frame->channels, numSamples);
+        descriptor.sampleBuffer.pullSamples (juce::AudioSourceChannelInfo (&planes, 0, numSamples));
+
+        encodeFrame (descriptor.context, frame, descriptor.streamIndex);
+        descriptor.framePool.release (frame);
+    }
+
+    /** Encodes the last incomplete frame. Encoders, that don't accept a short frame, get it padded with silence */
+    void encodeRemainingSamples (AudioStreamDescriptor& descriptor)
+    {
+        auto remaining = descriptor.sampleBuffer.getAvailableSamples();
+        if (remaining <= 0)
+            return;
+
+        jassert (remaining < descriptor.frameSize);
+
+        if ((descriptor.context->codec->capabilities & (AV_CODEC_CAP_SMALL_LAST_FRAME | AV_CODEC_CAP_VARIABLE_FRAME_SIZE)) == 0)
+        {
+            descriptor.sampleBuffer.pushSilence (descriptor.frameSize - remaining);
+            remaining = descriptor.frameSize;
+        }
+
+        encodeAudioFrame (descriptor, remaining);
+    }
+
+    /** Sends a frame to the encoder and writes all packets it returns. A nullptr frame drains the encoder */
+    void encodeFrame (AVCodecContext* codecContext, AVFrame* frame, int streamIndex)
+    {
+        jassert (formatContext != nullptr);
+
+        int ret = 0;
+
+        {
+            FOLEYS_MEASURE_STAGE (Encode);
+            ret = avcodec_send_frame (codecContext, frame);
+        }
+
+        if (ret < 0)
+        {
+            FOLEYS_LOG ("Error sending frame to the encoder: " << juce::String (ret));
+            return;
+        }
+
+        for (;;)
+        {
+            auto* packet = av_packet_alloc();
+
+            {
+                FOLEYS_MEASURE_STAGE (Encode);
+                ret = avcodec_receive_packet (codecContext, packet);
+            }
+
+            if (ret < 0)
+            {
+                if (ret != AVERROR (EAGAIN) && ret != AVERROR_EOF)
+                    FOLEYS_LOG ("Error receiving packet from the encoder: " << juce::String (ret));
+
+                av_packet_free (&packet);
+                return;
+            }
+
+            packet->stream_index = streamIndex;
+            av_packet_rescale_ts (packet, codecContext->time_base, formatContext->streams [streamIndex]->time_base);
+            writePacket (packet);
+        }
+    }
+
+    void flushEncoder (AVCodecContext* codecContext, int streamIndex)
+    {
+        FOLEYS_LOG ("Flushing encoder stream " << streamIndex);
+        encodeFrame (codecContext, nullptr, streamIndex);
+    }
+
+    /** Takes ownership of the packet */
+    void writePacket (AVPacket* packet)
+    {
+        if (muxer != nullptr)
+        {
+            muxer->addPacket (packet);
+            return;
+        }
+
+        if (av_interleaved_write_frame (formatContext, packet) < 0)
+            FOLEYS_LOG ("Error muxing packet");
+
+        av_packet_free (&packet);
+    }
+
+    /** MP4 and MOV write an edit list, so a copied stream may start with frames before the first cut */
+    bool canHideLeadingFrames() const
+    {
+        return juce::StringArray::fromTokens ("mp4 mov ipod 3gp 3g2 psp", false).contains (formatContext->oformat->name);
+    }
+
+    void openContainer (juce::File file, juce::String format)
+    {
+        if (format.isEmpty())
+            avformat_alloc_output_context2 (&formatContext, nullptr, nullptr, file.getFullPathName().toRawUTF8());
+        else
+            avformat_alloc_output_context2 (&formatContext, nullptr, format.toRawUTF8(), file.getFullPathName().toRawUTF8());
+
+        if (formatContext == nullptr)
+        {
+            FOLEYS_LOG ("Could not open output with format " + format);
+            return;
+        }
+
+        writeFile = file;
+        writer.opened = true;
+    }
+
+    void closeContainer()
+    {
+        writer.opened = false;
+        writer.started = false;
+
+        if (formatContext != nullptr)
+        {
+            if (!(formatContext->oformat->flags & AVFMT_NOFILE))
+                avio_closep (&formatContext->pb);
+
+            avformat_free_context (formatContext);
+            formatContext = nullptr;
+        }
+    }
+
+
+    //==============================================================================
+
+    FFmpegWriter& writer;
+    juce::File    writeFile;
+
+    AVFormatContext* formatContext = nullptr;
+
+    std::vector<std::unique_ptr<VideoStreamDescriptor>> videoStreams;
+    std::vector<std::unique_ptr<AudioStreamDescriptor>> audioStreams;
+    std::unique_ptr<VideoStreamCopy>                    videoCopy;
+
+    bool multiThreaded       = true;
+    int  numConverterThreads = 0;
+    int  maxFramesInFlight   = 4;
+
+    // milliseconds a stage of the pipeline may not make any progress, before it is given up
+    static constexpr int pipelineTimeout = 30000;
+
+    juce::CriticalSection                           scalerLock;
+    std::vector<std::unique_ptr<FFmpegVideoScaler>> idleScalers;
+
+    std::unique_ptr<MuxerThread>                     muxer;
+    std::unique_ptr<juce::ThreadPool>                converterPool;
+    std::vector<std::unique_ptr<VideoEncoderThread>> videoEncoders;
+    std::vector<std::unique_ptr<AudioEncoderThread>> audioEncoders;
+    juce::WaitableEvent                              pipelineProgress;
+
+    std::atomic<PerformanceCounters*> performanceCounters { nullptr };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (Pimpl)
+};
+
+//==============================================================================
+
+FFmpegWriter::FFmpegWriter (juce::File file, juce::String format)
+  : mediaFile (file),
+    formatName (format)
+{
+    pimpl = std::make_unique<Pimpl> (*this);
+}
+
+juce::File FFmpegWriter::getMediaFile() const
+{
+    return mediaFile;
+}
+
+bool FFmpegWriter::isOpenedOk() const
+{
+    return opened;
+}
 
 void FFmpegWriter::pushSamples (const juce::AudioBuffer<float>& input, int stream)
 {
-    if (!opened)
+    // You need to call startWriting() before sending frames or samples
+    jassert (started);
+
+    if (!opened || !started)
         return;
 
     pimpl->pushSamples (input, stream);
@@ -530,12 +1517,39 @@ void FFmpegWriter::pushSamples (const juce::AudioBuffer<float>& input, int strea
 
 void FFmpegWriter::pushImage (int64_t pos, juce::Image image, int stream)
 {
-    if (!opened)
+    // You need to call startWriting() before sending frames or samples
+    jassert (started);
+
+    if (!opened || !started)
         return;
 
     pimpl->pushImage (pos, image, stream);
 }
 
+void FFmpegWriter::setMultiThreaded (bool shouldRunMultiThreaded, int numConverterThreads)
+{
+    // The pipeline is set up in startWriting()
+    jassert (started == false);
+
+    pimpl->setMultiThreaded (shouldRunMultiThreaded, numConverterThreads);
+}
+
+bool FFmpegWriter::canWriteYUVFrames (int stream) const
+{
+    return opened && pimpl->canWriteYUVFrames (stream);
+}
+
+void FFmpegWriter::pushYUVFrame (int64_t pos, std::shared_ptr<YUVFrame> frame, int stream)
+{
+    // You need to call startWriting() before sending frames or samples
+    jassert (started);
+
+    if (!opened || !started)
+        return;
+
+    pimpl->pushYUVFrame (pos, frame, stream);
+}
+
 bool FFmpegWriter::startWriting()
 {
     return pimpl->startWriting();
@@ -554,7 +1568,18 @@ int FFmpegWriter::addVideoStream (const VideoStreamSettings& settings)
     if (opened == false || started == true)
         return -1;
 
-    return pimpl->addVideoStream (settings, AV_CODEC_ID_PROBE);
+    return pimpl->addVideoStream (settings, {}, AV_CODEC_ID_PROBE);
+}
+
+int FFmpegWriter::addVideoStream (const VideoStreamSettings& settings, const VideoEncoderSettings& encoderSettings)
+{
+    // You should have set up the streams before you started sending frames or samples
+    jassert (started == false);
+
+    if (opened == false || started == true)
+        return -1;
+
+    return pimpl->addVideoStream (settings, encoderSettings, AV_CODEC_ID_PROBE);
 }
 
 int FFmpegWriter::addAudioStream (const AudioStreamSettings& settings)
@@ -568,6 +1593,28 @@ int FFmpegWriter::addAudioStream (const AudioStreamSettings& settings)
     return pimpl->addAudioStream (settings, AV_CODEC_ID_PROBE);
 }
 
+bool FFmpegWriter::addVideoStreamCopy (const std::vector<StreamCopySegment>& segments)
+{
+    // You should have set up the streams before you started sending frames or samples
+    jassert (started == false);
+
+    if (opened == false || started == true)
+        return false;
+
+    return pimpl->addVideoStreamCopy (segments);
+}
+
+void FFmpegWriter::copyVideoPackets (double untilSeconds)
+{
+    // You need to call startWriting() before copying packets
+    jassert (started);
+
+    if (!opened || !started)
+        return;
+
+    pimpl->copyVideoPackets (untilSeconds);
+}
+
 juce::StringArray FFmpegWriter::getMuxers()
 {
     return {
@@ -37,10 +37,33 @@ public:
 
     void pushImage (int64_t pos, juce::Image image, int stream = 0) override;
 
+    bool canWriteYUVFrames (int stream = 0) const override;
+
+    void pushYUVFrame (int64_t pos, std::shared_ptr<YUVFrame> frame, int stream = 0) override;
+
     int addVideoStream (const VideoStreamSettings& settings) override;
 
+    int addVideoStream (const VideoStreamSettings& settings, const VideoEncoderSettings& encoderSettings) override;
+
     int addAudioStream (const AudioStreamSettings& settings) override;
 
+    /**
+     Copies the compressed video of the segments instead of encoding. MP4 and MOV allow the first
+     cut to start between key frames, they hide the leading frames with an edit list.
+     */
+    bool addVideoStreamCopy (const std::vector<StreamCopySegment>& segments) override;
+
+    void copyVideoPackets (double untilSeconds) override;
+
+    /**
+     By default the images are converted on a pool of threads, each stream is encoded
+     on its own thread and a muxer thread interleaves the packets. Switch this off to
+     encode synchronously in pushImage and pushSamples.
+     @param shouldRunMultiThreaded  run the pipeline on background threads
+     @param numConverterThreads     threads to convert images, 0 chooses by the number of cores
+     */
+    void setMultiThreaded (bool shouldRunMultiThreaded, int numConverterThreads = 0);
+
     bool startWriting() override;
 
     void finishWriting() override;
@@ -61,6 +61,32 @@ public:
 
     virtual void readNewData (VideoFifo&, AudioFifo&) = 0;
 
+    /** Returns true once all packets were read and the decoders were drained, i.e. readNewData won't produce any more data until the next setPosition */
+    virtual bool isEndOfStream() const { return false; }
+
+    /**
+     Allows the reader to skip work on video frames, if the decoding falls behind the playhead.
+     @param mode how far the reader may go to catch up
+     @param playheadSeconds frames that end before this time are not converted
+     */
+    virtual void setCatchUpMode (CatchUpMode mode, double playheadSeconds) { juce::ignoreUnused (mode, playheadSeconds); }
+
+    /**
+     Allows the reader to decode only the video frames needed at a playback rate. Faster than
+     realtime only every n-th frame is converted, and from keyframe-only rates on only key
+     frames are decoded. Negative rates are played backwards in chunks, they only thin out the frames.
+     */
+    virtual void setPlaybackRate (double rate) { juce::ignoreUnused (rate); }
+
+    /** Returns the presentation time in seconds of the last decoded video frame, or a negative value if unknown */
+    virtual double getLastDecodedVideoTime() const { return -1.0; }
+
+    /** Returns how well the decoded audio follows the timestamps of the stream, see AudioSyncStatistics */
+    virtual AudioSyncStatistics getAudioSyncStatistics() const { return {}; }
+
+    /** If enabled, the reader attaches the decoded YUVFrame to the VideoFrame, if the stream is 8 bit YUV 4:2:0 */
+    virtual void setPlanarFramesEnabled (bool shouldProvideYUV) { juce::ignoreUnused (shouldProvideYUV); }
+
     virtual bool hasVideo() const = 0;
     virtual bool hasAudio() const = 0;
     virtual bool hasSubtitle() const = 0;
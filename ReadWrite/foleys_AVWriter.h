@@ -23,6 +23,15 @@
 namespace foleys
 {
 
+/** A cut from a media file, whose compressed video can be copied into the output without re-encoding */
+struct StreamCopySegment final
+{
+    juce::File source;
+    double     sourceStart = 0.0;  /**< Start of the cut in the source in seconds */
+    double     sourceEnd   = 0.0;  /**< End of the cut in the source in seconds */
+    double     targetStart = 0.0;  /**< Position of the cut in the output in seconds */
+};
+
 /**
  @class AVWriter
 
@@ -46,8 +55,50 @@ public:
 
     virtual int addVideoStream (const VideoStreamSettings& settings) = 0;
 
+    /** Add a video stream with specific encoder settings. Writers, that don't support the
+        settings ignore them */
+    virtual int addVideoStream (const VideoStreamSettings& settings, const VideoEncoderSettings& encoderSettings)
+    {
+        juce::ignoreUnused (encoderSettings);
+        return addVideoStream (settings);
+    }
+
     virtual int addAudioStream (const AudioStreamSettings& settings) = 0;
 
+    /** Returns true, if the stream can encode YUVFrames without converting them from RGB */
+    virtual bool canWriteYUVFrames (int stream = 0) const
+    {
+        juce::ignoreUnused (stream);
+        return false;
+    }
+
+    /** Push a frame in planar YUV. Only call this, if canWriteYUVFrames() returned true */
+    virtual void pushYUVFrame (int64_t pos, std::shared_ptr<YUVFrame> frame, int stream = 0)
+    {
+        juce::ignoreUnused (pos, frame, stream);
+        jassertfalse;
+    }
+
+    /**
+     Add a video stream, that copies the compressed packets of the segments instead of encoding images.
+     Call this instead of addVideoStream(). It returns false, if the writer can't copy the segments
+     exactly, e.g. when the codecs differ or a cut doesn't fall on a key frame. In that case
+     nothing was added and the video needs to be encoded as usual.
+     */
+    virtual bool addVideoStreamCopy (const std::vector<StreamCopySegment>& segments)
+    {
+        juce::ignoreUnused (segments);
+        return false;
+    }
+
+    /** Copies the packets of the segments up to the given time in the output. The rest
+        is copied in finishWriting() */
+    virtual void copyVideoPackets (double untilSeconds)
+    {
+        juce::ignoreUnused (untilSeconds);
+        jassertfalse;
+    }
+
     virtual bool startWriting() = 0;
 
     virtual void finishWriting() = 0;
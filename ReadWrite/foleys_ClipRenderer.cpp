@@ -52,41 +52,159 @@ void ClipRenderer::setAudioSettings (const AudioStreamSettings& settings)
     audioSettings = settings;
 }
 
-void ClipRenderer::startRendering (bool cancelRunningJob)
+void ClipRenderer::setVideoEncoderSettings (const VideoEncoderSettings& settings)
+{
+    videoEncoderSettings = settings;
+}
+
+const VideoEncoderSettings& ClipRenderer::getVideoEncoderSettings() const
+{
+    return videoEncoderSettings;
+}
+
+void ClipRenderer::setLoudnessMeter (std::shared_ptr<LoudnessMeter> meter)
+{
+    loudnessMeter = meter;
+}
+
+std::shared_ptr<LoudnessMeter> ClipRenderer::getLoudnessMeter() const
+{
+    return loudnessMeter;
+}
+
+void ClipRenderer::setSmartRenderEnabled (bool shouldCopyUnprocessedVideo)
+{
+    smartRender = shouldCopyUnprocessedVideo;
+}
+
+bool ClipRenderer::isSmartRenderEnabled() const
+{
+    return smartRender;
+}
+
+void ClipRenderer::setNumParallelSegments (int numSegmentsToUse)
+{
+    numParallelSegments = std::max (1, numSegmentsToUse);
+}
+
+int ClipRenderer::getNumParallelSegments() const
+{
+    return numParallelSegments;
+}
+
+void ClipRenderer::setOfflineModeEnabled (bool shouldRenderOffline)
+{
+    offlineMode = shouldRenderOffline;
+}
+
+bool ClipRenderer::isOfflineModeEnabled() const
+{
+    return offlineMode;
+}
+
+void ClipRenderer::setRenderBlockSize (int numSamples)
+{
+    renderBlockSize = std::max (0, numSamples);
+}
+
+int ClipRenderer::getRenderBlockSize() const
+{
+    return renderBlockSize;
+}
+
+void ClipRenderer::addRendition (const Rendition& rendition)
+{
+    renditions.push_back (rendition);
+}
+
+void ClipRenderer::clearRenditions()
+{
+    renditions.clear();
+}
+
+const std::vector<ClipRenderer::Rendition>& ClipRenderer::getRenditions() const
+{
+    return renditions;
+}
+
+void ClipRenderer::setThreadPool (juce::ThreadPool* poolToUse)
+{
+    jassert (! renderJob.isRunning());
+    threadPool = poolToUse;
+}
+
+juce::ThreadPool& ClipRenderer::getThreadPool()
+{
+    return threadPool != nullptr ? *threadPool : videoEngine.getThreadPool();
+}
+
+bool ClipRenderer::startRendering (bool cancelRunningJob)
 {
     if (clip == nullptr || mediaFile.getFileName().isEmpty())
-        return;
+        return false;
 
     if (renderJob.isRunning())
     {
-        if (cancelRunningJob)
-            videoEngine.getThreadPool().removeJob (&renderJob, true, 1000);
-        else
-            return;
+        if (! cancelRunningJob)
+            return false;
+
+        // the job releases its writers when it exits, until then they must not be touched
+        cancelRendering();
+        if (! getThreadPool().waitForJobToFinish (&renderJob, 5000))
+            return false;
     }
 
+    cancelled.store (false);
     progress.store (0.0);
 
     clip->prepareToPlay (audioSettings.defaultNumSamples, audioSettings.timebase);
 
-    writer = videoEngine.getFormatManager().createClipWriter (mediaFile);
-    if (clip->hasVideo())
-        writer->addVideoStream (videoSettings);
+    if (loudnessMeter != nullptr)
+        loudnessMeter->prepare (audioSettings.timebase, audioSettings.numChannels);
 
-    if (clip->hasAudio())
-        writer->addAudioStream (audioSettings);
+    writer.reset();
+    renditionWriters.clear();
+    copyVideo = false;
+    audioClip.reset();
+    segmentClips.clear();
 
-    if (writer->startWriting())
-        videoEngine.getThreadPool().addJob (&renderJob, false);
+    // the renditions need the composed frames, so the video is neither copied nor split into segments
+    const auto copyUnprocessed = smartRender && renditions.empty();
+    const auto segmented = numParallelSegments > 1 && clip->hasVideo() && renditions.empty();
+
+    if (copyUnprocessed || ! segmented)
+        createWriter (copyUnprocessed ? findStreamCopySegments() : std::vector<StreamCopySegment>());
+
+    // copying beats encoding in parallel. Otherwise the RenderJob creates the writer once the segments are encoded
+    if (segmented && ! copyVideo)
+        writer.reset();
+    else if (writer == nullptr || ! writer->startWriting())
+        return false;
+
+    if (! createRenditionWriters())
+    {
+        writer.reset();
+        renditionWriters.clear();
+        return false;
+    }
+
+    // the copies are created here, because the VideoEngine manages their life time on this thread
+    if (segmented && ! copyVideo)
+        for (int i = 0; i < numParallelSegments; ++i)
+            segmentClips.push_back (clip->createCopy (StreamTypes::video()));
+
+    // if the video is copied or joined from segments, the audio is rendered from a copy, that doesn't decode any video
+    if ((segmented || copyVideo) && clip->hasAudio())
+        audioClip = clip->createCopy (StreamTypes::audio());
+
+    getThreadPool().addJob (&renderJob, false);
+    return true;
 }
 
 void ClipRenderer::cancelRendering()
 {
-    videoEngine.getThreadPool().removeJob (&renderJob, true, 1000);
-    writer.reset();
-
-    if (onRenderingFinished)
-        onRenderingFinished (false);
+    // the job checks the flag, finishes its writers and calls onRenderingFinished
+    cancelled.store (true);
 }
 
 bool ClipRenderer::isRendering() const
@@ -94,83 +212,467 @@ bool ClipRenderer::isRendering() const
     return renderJob.isRunning();
 }
 
-//==============================================================================
+void ClipRenderer::createWriter (const std::vector<StreamCopySegment>& copySegments)
+{
+    writer = videoEngine.getFormatManager().createClipWriter (mediaFile);
+    copyVideo = false;
 
-ClipRenderer::RenderJob::RenderJob (ClipRenderer& owner)
-  : juce::ThreadPoolJob ("Bounce Job"),
-    bouncer (owner)
-{}
+    if (writer == nullptr)
+        return;
 
-juce::ThreadPoolJob::JobStatus ClipRenderer::RenderJob::runJob()
+    if (clip->hasVideo())
+    {
+        if (! copySegments.empty())
+            copyVideo = writer->addVideoStreamCopy (copySegments);
+
+        if (! copyVideo)
+            writer->addVideoStream (videoSettings, videoEncoderSettings);
+    }
+
+    if (clip->hasAudio())
+        writer->addAudioStream (audioSettings);
+}
+
+bool ClipRenderer::createRenditionWriters()
 {
-    if (bouncer.writer == nullptr || bouncer.clip == nullptr)
-        return juce::ThreadPoolJob::jobHasFinished;
+    for (const auto& rendition : renditions)
+    {
+        auto renditionWriter = videoEngine.getFormatManager().createClipWriter (rendition.file);
+        if (renditionWriter == nullptr)
+        {
+            FOLEYS_LOG ("Could not create a writer for " << rendition.file.getFullPathName());
+            return false;
+        }
 
-    const auto targetVideoSettings = bouncer.videoSettings;
-    const auto targetAudioSettings = bouncer.audioSettings;
+        // the frames are pushed with the timestamps of the main output, only the size differs
+        auto settings = videoSettings;
+        settings.frameSize = rendition.videoSettings.frameSize;
 
-    const auto totalDuration = bouncer.clip->getTotalLength();
-    int64_t    audioPosition = 0;
-    int64_t    videoPosition = - targetVideoSettings.defaultDuration;
+        if (clip->hasVideo())
+            renditionWriter->addVideoStream (settings, rendition.encoderSettings);
 
-    auto  targetClip = bouncer.clip;
+        if (clip->hasAudio())
+            renditionWriter->addAudioStream (audioSettings);
 
-    buffer.setSize (targetAudioSettings.numChannels, targetAudioSettings.defaultNumSamples);
-    targetClip->prepareToPlay (targetAudioSettings.defaultNumSamples, targetAudioSettings.timebase);
-    targetClip->setNextReadPosition (0);
+        if (! renditionWriter->startWriting())
+            return false;
+
+        renditionWriters.push_back (std::move (renditionWriter));
+    }
+
+    return true;
+}
 
-    while (! shouldExit() && audioPosition < totalDuration)
+std::vector<StreamCopySegment> ClipRenderer::findStreamCopySegments() const
+{
+    auto getSourceFile = [](const AVClip& source)
     {
-        juce::AudioSourceChannelInfo info (&buffer, 0, std::min (int (totalDuration - audioPosition),
-                                                                 targetAudioSettings.defaultNumSamples));
+        const auto url = source.getMediaFile();
+        if (dynamic_cast<const MovieClip*>(&source) == nullptr || url.isLocalFile() == false)
+            return juce::File();
+
+        return url.getLocalFile();
+    };
 
-        targetClip->waitForSamplesReady (info.numSamples);
-        targetClip->getNextAudioBlock (info);
-        juce::AudioBuffer<float> writeBuffer (buffer.getArrayOfWritePointers(),
-                                              buffer.getNumChannels(),
-                                              info.startSample,
-                                              info.numSamples);
-        bouncer.writer->pushSamples (writeBuffer);
+    // the copied video keeps the size and frame rate of the source
+    auto matchesSettings = [this](const AVClip& source)
+    {
+        const auto size = source.getVideoSize();
+        return size.width == videoSettings.frameSize.width
+            && size.height == videoSettings.frameSize.height
+            && std::abs (source.getFrameDurationInSeconds() - videoSettings.getFrameDurationSeconds()) < 1.0e-4;
+    };
 
-        audioPosition += writeBuffer.getNumSamples();
+    auto isUnprocessed = [](ClipDescriptor& descriptor)
+    {
+        if (! descriptor.getVideoProcessors()->empty())
+            return false;
+
+        auto& controller = descriptor.getVideoParameterController();
+        for (const auto& parameter : controller.getParameters())
+            if (! parameter.second->getKeyframes().empty())
+                return false;
+
+        const auto pts = descriptor.getOffset();
+        return controller.getValueAtTime (IDs::alpha, pts, 1.0) == 1.0
+            && controller.getValueAtTime (IDs::zoom, pts, 100.0) == 100.0
+            && controller.getValueAtTime (IDs::translateX, pts, 0.0) == 0.0
+            && controller.getValueAtTime (IDs::translateY, pts, 0.0) == 0.0
+            && controller.getValueAtTime (IDs::rotation, pts, 0.0) == 0.0;
+    };
+
+    if (auto* movie = dynamic_cast<MovieClip*>(clip.get()))
+    {
+        const auto file = getSourceFile (*movie);
+        if (! file.existsAsFile() || ! matchesSettings (*movie))
+            return {};
+
+        return { { file, 0.0, movie->getLengthInSeconds(), 0.0 } };
+    }
+
+    auto* composed = dynamic_cast<ComposedClip*>(clip.get());
+    if (composed == nullptr)
+        return {};
+
+    auto descriptors = composed->getClips();
+    std::sort (descriptors.begin(), descriptors.end(), [](const auto& a, const auto& b) { return a->getStart() < b->getStart(); });
+
+    const auto tolerance = videoSettings.getFrameDurationSeconds() / 2.0;
+
+    std::vector<StreamCopySegment> segments;
+    double end = 0.0;
+
+    for (auto& descriptor : descriptors)
+    {
+        if (! descriptor->clip->hasVideo() || ! descriptor->getVideoVisible())
+            continue;
+
+        const auto file = getSourceFile (*descriptor->clip);
+        if (! file.existsAsFile() || ! matchesSettings (*descriptor->clip) || ! isUnprocessed (*descriptor))
+            return {};
+
+        // gaps would need black frames and overlaps need blending
+        if (std::abs (descriptor->getStart() - end) > tolerance)
+            return {};
+
+        segments.push_back ({ file, descriptor->getOffset(), descriptor->getOffset() + descriptor->getLength(), descriptor->getStart() });
+        end = descriptor->getStart() + descriptor->getLength();
+    }
+
+    if (std::abs (composed->getLengthInSeconds() - end) > tolerance)
+        return {};
+
+    return segments;
+}
+
+bool ClipRenderer::renderRange (AVClip* source, const std::vector<AVWriter*>& targets, const RenderRange& range,
+                                LoudnessMeter* meter,
+                                const std::function<bool()>& shouldCancel,
+                                const std::function<void(double)>& reportProgress)
+{
+    const auto targetVideoSettings = videoSettings;
+    const auto targetAudioSettings = audioSettings;
+
+    auto blockSize = renderBlockSize > 0 ? renderBlockSize : targetAudioSettings.defaultNumSamples;
+
+    // reading ahead, the clips can only be waited for a limited number of samples
+    if (! offlineMode)
+        blockSize = std::min (blockSize, maximumRealtimeBlockSize);
+
+    int64_t audioPosition = range.startSample;
+    int64_t videoPosition = range.startVideo - targetVideoSettings.defaultDuration;
+
+    // if the writers accept YUV, frames that are only passed through or blended skip the conversion to RGB and back
+    const auto writeYUV = ! range.copyVideo && source != nullptr && source->hasVideo()
+                        && std::all_of (targets.begin(), targets.end(), [](auto* target) { return target->canWriteYUVFrames(); });
+
+    juce::AudioBuffer<float> buffer (targetAudioSettings.numChannels, blockSize);
+
+    if (source != nullptr)
+    {
+        source->prepareToPlay (blockSize, targetAudioSettings.timebase);
+        source->setPlanarFramesEnabled (writeYUV);
+        source->setOfflineMode (offlineMode);
+        source->setNextReadPosition (range.startSample);
+    }
+
+    auto cancelled = false;
+    auto failed    = false;
+
+    while (! cancelled && audioPosition < range.endSample)
+    {
+        if (shouldCancel())
+        {
+            cancelled = true;
+            break;
+        }
+
+        const auto numSamples = int (std::min (range.endSample - audioPosition, int64_t (blockSize)));
+
+        if (source != nullptr)
+        {
+            juce::AudioSourceChannelInfo info (&buffer, 0, numSamples);
+
+            if (! offlineMode)
+                source->waitForSamplesReady (info.numSamples);
+
+            source->getNextAudioBlock (info);
+
+            if (meter != nullptr)
+                meter->process (buffer, 0, numSamples);
+
+            // the writer's fifo is sized for blocks of the audio settings
+            for (int start = 0; start < numSamples; start += targetAudioSettings.defaultNumSamples)
+            {
+                juce::AudioBuffer<float> writeBuffer (buffer.getArrayOfWritePointers(),
+                                                      buffer.getNumChannels(),
+                                                      start,
+                                                      std::min (numSamples - start, targetAudioSettings.defaultNumSamples));
+                for (auto* target : targets)
+                    target->pushSamples (writeBuffer);
+            }
+        }
+
+        audioPosition += numSamples;
 
         const auto secs = audioPosition / double (targetAudioSettings.timebase);
         const auto videoCount = secs * targetVideoSettings.timebase;
-        if (videoCount >= videoPosition)
+        if (range.copyVideo)
+            targets.front()->copyVideoPackets (secs - range.startSample / double (targetAudioSettings.timebase));
+
+        // a large block can cover several frames
+        while (! range.copyVideo && videoCount >= videoPosition && videoPosition + targetVideoSettings.defaultDuration < range.endVideo)
         {
             videoPosition += targetVideoSettings.defaultDuration;
-            auto timestamp = videoCount / double (targetVideoSettings.timebase);
-            while (! targetClip->isFrameAvailable (timestamp))
+
+            // the middle of the frame is safe from rounding the timestamps of the sources
+            auto timestamp = (videoPosition + targetVideoSettings.defaultDuration / 2.0) / double (targetVideoSettings.timebase);
+
+            // offline the clip reads the frame in getFrame()
+            if (! offlineMode)
             {
-                if (shouldExit())
+                FOLEYS_MEASURE_STAGE (Wait);
+                while (! source->isFrameAvailable (timestamp))
                 {
-                    bouncer.writer->finishWriting();
-                    bouncer.writer.reset();
-
-                    if (bouncer.onRenderingFinished)
-                        bouncer.onRenderingFinished (false);
+                    if (shouldCancel())
+                    {
+                        cancelled = true;
+                        break;
+                    }
 
-                    return juce::ThreadPoolJob::jobHasFinished;
+                    juce::Thread::sleep (10);
                 }
+            }
+
+            if (cancelled)
+                break;
 
-                juce::Thread::sleep (10);
+            auto& frame = source->getFrame (timestamp);
+            const auto position = videoPosition - range.startVideo;
+
+            // the frame is composed once, the writers only copy it here and scale it on their converter pools
+            for (auto* target : targets)
+            {
+                if (frame.yuv != nullptr)
+                    target->pushYUVFrame (position, frame.yuv);
+                else
+                    target->pushImage (position, frame.image);
             }
+        }
 
-            auto& frame = targetClip->getFrame (timestamp);
+        // a stalled read left a gap, that output is not usable
+        if (offlineMode && source != nullptr && source->hasOfflineReadFailed())
+        {
+            FOLEYS_LOG ("Rendering failed, the source could not be read at " << secs << " s");
+            failed = true;
+            break;
+        }
 
-            bouncer.writer->pushImage (videoPosition, frame.image);
+        reportProgress (double (audioPosition - range.startSample) / double (range.endSample - range.startSample));
+    }
+
+    if (source != nullptr)
+    {
+        source->setPlanarFramesEnabled (false);
+        source->setOfflineMode (false);
+    }
+
+    return ! cancelled && ! failed;
+}
+
+bool ClipRenderer::renderSegments (const std::function<bool()>& shouldCancel)
+{
+    const auto frameDuration = int64_t (videoSettings.defaultDuration);
+    const auto timebase      = int64_t (videoSettings.timebase);
+    const auto sampleRate    = int64_t (audioSettings.timebase);
+    const auto totalSamples  = clip->getTotalLength();
+    const auto totalFrames   = (totalSamples * timebase / sampleRate + frameDuration - 1) / frameDuration;
+
+    // segments start on a multiple of the GOP size and every segment encoder uses it, so the key frames
+    // are where a linear render with that GOP puts them. The encoder's default is unknown, so it is set explicitly
+    segmentGopSize = videoEncoderSettings.gopSize > 0 ? videoEncoderSettings.gopSize
+                                                      : std::max (1, int (2 * timebase / std::max (frameDuration, int64_t (1))));
+
+    const auto gopSize    = int64_t (segmentGopSize);
+    const auto numGops    = (totalFrames + gopSize - 1) / gopSize;
+    const auto numSegments = std::min (int64_t (segmentClips.size()), numGops);
+
+    if (numSegments < 1)
+        return false;
+
+    auto toSamples = [&](int64_t frame) { return frame * frameDuration * sampleRate / timebase; };
+
+    std::vector<std::unique_ptr<SegmentJob>> jobs;
+    std::vector<StreamCopySegment> copySegments;
+
+    for (int64_t i = 0; i < numSegments; ++i)
+    {
+        const auto firstFrame = (numGops * i / numSegments) * gopSize;
+        const auto endFrame   = std::min (totalFrames, (numGops * (i + 1) / numSegments) * gopSize);
+
+        RenderRange range;
+        range.startSample = toSamples (firstFrame);
+        range.endSample   = i + 1 < numSegments ? toSamples (endFrame) : totalSamples;
+        range.startVideo  = firstFrame * frameDuration;
+        range.endVideo    = endFrame * frameDuration;
+
+        auto file = mediaFile.getParentDirectory().getNonexistentChildFile (mediaFile.getFileNameWithoutExtension() + "_segment" + juce::String (i),
+                                                                            mediaFile.getFileExtension(), false);
+        segmentFiles.push_back (file);
+        copySegments.push_back ({ file,
+                                  0.0,
+                                  (range.endVideo - range.startVideo) / double (timebase),
+                                  range.startVideo / double (timebase) });
+
+        jobs.push_back (std::make_unique<SegmentJob> (*this, segmentClips [size_t (i)], file, range));
+    }
+
+    {
+        juce::ThreadPool pool (int (numSegments));
+
+        for (auto& job : jobs)
+            pool.addJob (job.get(), false);
+
+        while (pool.getNumJobs() > 0)
+        {
+            if (shouldCancel())
+            {
+                // the jobs check the cancelled flag themselves, so waiting for them doesn't block
+                pool.removeAllJobs (true, -1);
+                return false;
+            }
+
+            double sum = 0.0;
+            for (auto& job : jobs)
+                sum += job->getProgress();
+
+            // the final pass, that renders the audio and joins the segments, gets the last 10 percent
+            progress.store (0.9 * sum / double (jobs.size()));
+            juce::Thread::sleep (50);
         }
+    }
 
-        bouncer.progress.store (double (audioPosition) / totalDuration);
+    for (auto& job : jobs)
+        if (! job->wasSuccessful())
+            return false;
+
+    createWriter (copySegments);
+
+    if (! copyVideo)
+        FOLEYS_LOG ("Could not join the segments, encoding the clip in one pass");
+
+    return writer != nullptr && writer->startWriting();
+}
+
+void ClipRenderer::finishRendering (bool success)
+{
+    if (writer != nullptr)
+    {
+        writer->finishWriting();
+        writer.reset();
     }
 
-    bouncer.writer->finishWriting();
-    bouncer.writer.reset();
+    for (auto& renditionWriter : renditionWriters)
+        renditionWriter->finishWriting();
+
+    renditionWriters.clear();
+
+    audioClip.reset();
+    segmentClips.clear();
+
+    for (auto& file : segmentFiles)
+        file.deleteFile();
+
+    segmentFiles.clear();
+
+    if (success)
+        progress.store (1.0);
+
+    if (onRenderingFinished)
+        onRenderingFinished (success);
+}
+
+//==============================================================================
+
+ClipRenderer::RenderJob::RenderJob (ClipRenderer& owner)
+  : juce::ThreadPoolJob ("Bounce Job"),
+    bouncer (owner)
+{}
+
+juce::ThreadPoolJob::JobStatus ClipRenderer::RenderJob::runJob()
+{
+    if (bouncer.clip == nullptr)
+        return juce::ThreadPoolJob::jobHasFinished;
+
+    FOLEYS_PERFORMANCE_SOURCE (bouncer.clip->getPerformanceCounters());
+
+    auto shouldCancel = [this] { return shouldExit() || bouncer.cancelled.load(); };
+
+    // without a writer the video is encoded in segments first, that are joined by the final pass
+    const auto segmented = bouncer.writer == nullptr;
+    if (segmented && ! bouncer.renderSegments (shouldCancel))
+    {
+        bouncer.finishRendering (false);
+        return juce::ThreadPoolJob::jobHasFinished;
+    }
+
+    RenderRange range;
+    range.endSample = bouncer.clip->getTotalLength();
+    range.copyVideo = bouncer.copyVideo;
+
+    // when the video is copied, the clip is only needed for the audio, if there is any
+    auto* source = range.copyVideo ? bouncer.audioClip.get() : bouncer.clip.get();
+
+    const auto progressStart = segmented ? bouncer.progress.load() : 0.0;
+    std::vector<AVWriter*> targets { bouncer.writer.get() };
+    for (auto& renditionWriter : bouncer.renditionWriters)
+        targets.push_back (renditionWriter.get());
+
+    const auto success = bouncer.renderRange (source, targets, range, bouncer.loudnessMeter.get(), shouldCancel, [&](double done)
+    {
+        bouncer.progress.store (progressStart + (1.0 - progressStart) * done);
+    });
+
+    bouncer.finishRendering (success);
+    return juce::ThreadPoolJob::jobHasFinished;
+}
+
+//==============================================================================
+
+ClipRenderer::SegmentJob::SegmentJob (ClipRenderer& owner, std::shared_ptr<AVClip> clipToRender, juce::File file, RenderRange rangeToRender)
+  : juce::ThreadPoolJob ("Segment Job"),
+    bouncer (owner),
+    segmentClip (clipToRender),
+    segmentFile (file),
+    range (rangeToRender)
+{}
+
+juce::ThreadPoolJob::JobStatus ClipRenderer::SegmentJob::runJob()
+{
+    auto writer = bouncer.videoEngine.getFormatManager().createClipWriter (segmentFile);
+
+    if (segmentClip == nullptr || writer == nullptr)
+        return juce::ThreadPoolJob::jobHasFinished;
+
+    FOLEYS_PERFORMANCE_SOURCE (bouncer.clip->getPerformanceCounters());
+
+    // the segments run in parallel, so the cores are split between their encoders
+    auto encoderSettings = bouncer.videoEncoderSettings;
+    if (encoderSettings.threadCount == 0)
+        encoderSettings.threadCount = std::max (1, juce::SystemStats::getNumCpus() / bouncer.numParallelSegments);
+
+    encoderSettings.gopSize = bouncer.segmentGopSize;
+
+    if (writer->addVideoStream (bouncer.videoSettings, encoderSettings) < 0 || ! writer->startWriting())
+        return juce::ThreadPoolJob::jobHasFinished;
 
-    bouncer.progress.store (1.0);
+    const auto done = bouncer.renderRange (segmentClip.get(), { writer.get() }, range,
+                                           nullptr,
+                                           [this] { return shouldExit() || bouncer.cancelled.load(); },
+                                           [this](double p) { progress.store (p); });
 
-    if (bouncer.onRenderingFinished)
-        bouncer.onRenderingFinished (shouldExit() == false);
+    writer->finishWriting();
+    success.store (done);
 
     return juce::ThreadPoolJob::jobHasFinished;
 }
@@ -36,7 +36,81 @@ public:
     void setVideoSettings (const VideoStreamSettings& settings);
     void setAudioSettings (const AudioStreamSettings& settings);
 
-    void startRendering (bool cancelRunningJob);
+    /** Set the codec, quality and threading options for the video encoder */
+    void setVideoEncoderSettings (const VideoEncoderSettings& settings);
+    const VideoEncoderSettings& getVideoEncoderSettings() const;
+
+    /**
+     With smart rendering enabled, the video of cuts from movie files without processors, fades or
+     transformations is copied without re-encoding, if the cuts start on key frames and the source
+     matches the video settings in size and frame rate. The audio is rendered as usual. If any cut
+     doesn't qualify, the whole video is encoded.
+     */
+    void setSmartRenderEnabled (bool shouldCopyUnprocessedVideo);
+    bool isSmartRenderEnabled() const;
+
+    /**
+     Split the timeline into this many segments, that are encoded in parallel, each from its
+     own copy of the clip. The segments start on multiples of the GOP size from the encoder
+     settings, or two seconds if that is 0, and are joined without re-encoding. The audio is
+     rendered in one pass afterwards, so there are no seams in the audio. 1 renders linearly.
+     */
+    void setNumParallelSegments (int numSegmentsToUse);
+    int getNumParallelSegments() const;
+
+    /**
+     In offline mode the clip decodes synchronously while it is rendered, instead of reading
+     ahead on background threads. Nothing is dropped or skipped under load, so the result is
+     deterministic. Enabled by default.
+     */
+    void setOfflineModeEnabled (bool shouldRenderOffline);
+    bool isOfflineModeEnabled() const;
+
+    /**
+     The number of samples pulled from the clip at once. Large blocks reduce the overhead per
+     block, ideally use them together with the offline mode. 0 uses the defaultNumSamples of
+     the audio settings. Without offline mode the blocks are limited to maximumRealtimeBlockSize.
+     */
+    void setRenderBlockSize (int numSamples);
+    int getRenderBlockSize() const;
+
+    /**
+     Measures the loudness of the rendered audio while it is written, so checking the
+     compliance doesn't need a second pass. The meter is prepared and reset when the
+     rendering starts, read its report e.g. in onRenderingFinished.
+     */
+    void setLoudnessMeter (std::shared_ptr<LoudnessMeter> meter);
+    std::shared_ptr<LoudnessMeter> getLoudnessMeter() const;
+
+    /** An additional output of the same clip, see addRendition() */
+    struct Rendition
+    {
+        juce::File           file;
+        VideoStreamSettings  videoSettings;
+        VideoEncoderSettings encoderSettings;
+    };
+
+    /**
+     Adds an output, that is fed with the same composed frames as the main output, e.g. to render
+     a ladder of resolutions in one pass. Each writer takes a copy of the frame and scales it to the
+     frame size of the rendition on its own converter pool, so the renditions are converted in parallel
+     while the next frame is composed. The frame rate and the audio are the same as in the main output.
+     While renditions are set, the clip is rendered linearly without smart rendering.
+     */
+    void addRendition (const Rendition& rendition);
+    void clearRenditions();
+    const std::vector<Rendition>& getRenditions() const;
+
+    /** Runs the render job on this pool instead of the VideoEngine's, e.g. the RenderQueue's.
+        nullptr uses the VideoEngine's thread pool. */
+    void setThreadPool (juce::ThreadPool* poolToUse);
+
+    /** Starts rendering on the thread pool. Returns false, if the output file couldn't be set up,
+        or if a running job didn't stop in time */
+    bool startRendering (bool cancelRunningJob);
+
+    /** Asks the running job to stop. It returns immediately, the job finishes its writers and
+        calls onRenderingFinished with false, once it stopped */
     void cancelRendering();
     bool isRendering() const;
 
@@ -45,6 +119,16 @@ public:
 
 private:
 
+    /** A part of the timeline. The video is measured in the time base of the video settings */
+    struct RenderRange
+    {
+        int64_t startSample = 0;
+        int64_t endSample   = 0;
+        int64_t startVideo  = 0;
+        int64_t endVideo    = std::numeric_limits<int64_t>::max();
+        bool    copyVideo   = false;
+    };
+
     class RenderJob : public juce::ThreadPoolJob
     {
     public:
@@ -53,22 +137,90 @@ private:
 
     private:
         ClipRenderer& bouncer;
-        juce::AudioBuffer<float> buffer;
 
         JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (RenderJob)
     };
 
+    /** Encodes the video of one segment into its own file */
+    class SegmentJob : public juce::ThreadPoolJob
+    {
+    public:
+        SegmentJob (ClipRenderer& owner, std::shared_ptr<AVClip> clip, juce::File file, RenderRange range);
+        juce::ThreadPoolJob::JobStatus runJob() override;
+
+        bool wasSuccessful() const { return success.load(); }
+        double getProgress() const { return progress.load(); }
+
+    private:
+        ClipRenderer&           bouncer;
+        std::shared_ptr<AVClip> segmentClip;
+        juce::File              segmentFile;
+        RenderRange             range;
+        std::atomic<bool>       success  { false };
+        std::atomic<double>     progress { 0.0 };
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SegmentJob)
+    };
+
+    /** Returns the cuts of the clip, if its video can be copied from the source files, otherwise an empty vector */
+    std::vector<StreamCopySegment> findStreamCopySegments() const;
+
+    /** Creates the writer and adds the streams, copying the segments' video if possible */
+    void createWriter (const std::vector<StreamCopySegment>& copySegments);
+
+    /** Creates and starts a writer for each rendition. Returns false, if one of them failed */
+    bool createRenditionWriters();
+
+    /**
+     Pulls the audio of source in blocks and pushes it into the targets. All video frames that are due
+     are pushed, or the compressed video of the first target is copied up to that time. The timestamps
+     are written relative to the start of the range. The audio is measured by meter, if it is not nullptr.
+     Returns false, if the rendering was cancelled or the source stalled in offline mode.
+     */
+    bool renderRange (AVClip* source, const std::vector<AVWriter*>& targets, const RenderRange& range,
+                      LoudnessMeter* meter,
+                      const std::function<bool()>& shouldCancel,
+                      const std::function<void(double)>& reportProgress);
+
+    /** Encodes the segments in parallel and sets up the writer to join them. Returns false if cancelled or failed */
+    bool renderSegments (const std::function<bool()>& shouldCancel);
+
+    void finishRendering (bool success);
+
+    juce::ThreadPool& getThreadPool();
+
     VideoEngine&              videoEngine;
+    juce::ThreadPool*         threadPool = nullptr;
 
     VideoStreamSettings videoSettings;
     AudioStreamSettings audioSettings;
+    VideoEncoderSettings videoEncoderSettings;
 
     juce::File                mediaFile;
     std::unique_ptr<AVWriter> writer;
     std::shared_ptr<AVClip>   clip;
 
+    bool                      smartRender = false;
+    bool                      offlineMode = true;
+    int                       renderBlockSize = 0;
+    bool                      copyVideo   = false;
+    std::shared_ptr<AVClip>   audioClip;
+    std::shared_ptr<LoudnessMeter> loudnessMeter;
+
+    std::vector<Rendition>                 renditions;
+    std::vector<std::unique_ptr<AVWriter>> renditionWriters;
+
+    int                                  numParallelSegments = 1;
+    int                                  segmentGopSize      = 0;
+    std::vector<std::shared_ptr<AVClip>> segmentClips;
+    std::vector<juce::File>              segmentFiles;
+
+    std::atomic<bool> cancelled { false };
     RenderJob renderJob;
 
+    /** The most samples the clips can be waited for, when they read ahead in the background */
+    static constexpr int maximumRealtimeBlockSize = 4800;
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ClipRenderer)
 };
 
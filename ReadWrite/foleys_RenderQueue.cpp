@@ -0,0 +1,331 @@
+/*
+ ==============================================================================
+
+ Copyright (c) 2019 - 2021, Foleys Finest Audio - Daniel Walz
+ All rights reserved.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ ==============================================================================
+ */
+
+
+namespace foleys
+{
+
+RenderQueue::~RenderQueue()
+{
+    stopTimer();
+
+    onJobFinished = nullptr;
+    onQueueFinished = nullptr;
+
+    cancelAllJobs();
+
+    // the cancelled renderers stop asynchronously, they must have finished their writers before they are destroyed
+    if (threadPool != nullptr)
+        threadPool->removeAllJobs (true, -1);
+
+    threadPool.reset();
+}
+
+int RenderQueue::addJob (std::unique_ptr<ClipRenderer> renderer, int priority)
+{
+    if (renderer == nullptr)
+        return 0;
+
+    auto job = std::make_unique<Job>();
+    job->renderer = std::move (renderer);
+    job->priority = priority;
+
+    int jobID = 0;
+
+    {
+        juce::ScopedLock sl (jobsLock);
+        jobID = nextJobID++;
+        job->jobID = jobID;
+        jobs.push_back (std::move (job));
+    }
+
+    queueActive = true;
+    updateJobs();
+
+    return jobID;
+}
+
+void RenderQueue::setPriority (int jobID, int priority)
+{
+    juce::ScopedLock sl (jobsLock);
+    if (auto* job = findJob (jobID))
+        job->priority = priority;
+}
+
+bool RenderQueue::cancelJob (int jobID)
+{
+    {
+        juce::ScopedLock sl (jobsLock);
+        auto* job = findJob (jobID);
+        if (job == nullptr || ! cancel (*job))
+            return false;
+    }
+
+    if (onJobFinished)
+        onJobFinished (jobID, false);
+
+    updateJobs();
+    return true;
+}
+
+void RenderQueue::cancelAllJobs()
+{
+    std::vector<int> cancelled;
+
+    {
+        juce::ScopedLock sl (jobsLock);
+
+        // the queued jobs first, so none of them starts when a running job is cancelled
+        for (auto& job : jobs)
+            if (job->status == Status::Queued && cancel (*job))
+                cancelled.push_back (job->jobID);
+
+        for (auto& job : jobs)
+            if (job->status == Status::Rendering && cancel (*job))
+                cancelled.push_back (job->jobID);
+    }
+
+    if (onJobFinished)
+        for (auto jobID : cancelled)
+            onJobFinished (jobID, false);
+
+    updateJobs();
+}
+
+bool RenderQueue::cancel (Job& job)
+{
+    // a job that ended meanwhile is collected by updateJobs()
+    if (job.status == Status::Rendering && ! job.ended.load())
+        job.renderer->cancelRendering();
+    else if (job.status != Status::Queued)
+        return false;
+
+    job.status  = Status::Cancelled;
+    job.endTime = juce::Time::getMillisecondCounterHiRes() * 0.001;
+    return true;
+}
+
+void RenderQueue::removeEndedJobs()
+{
+    juce::ScopedLock sl (jobsLock);
+
+    jobs.erase (std::remove_if (jobs.begin(), jobs.end(), [](const auto& job)
+    {
+        return (job->status == Status::Finished || job->status == Status::Failed || job->status == Status::Cancelled)
+            && ! job->renderer->isRendering();
+    }), jobs.end());
+}
+
+std::vector<RenderQueue::JobInfo> RenderQueue::getJobs() const
+{
+    juce::ScopedLock sl (jobsLock);
+
+    std::vector<JobInfo> infos;
+    for (const auto& job : jobs)
+        infos.push_back (createJobInfo (*job));
+
+    return infos;
+}
+
+RenderQueue::JobInfo RenderQueue::getJobInfo (int jobID) const
+{
+    juce::ScopedLock sl (jobsLock);
+
+    if (auto* job = findJob (jobID))
+        return createJobInfo (*job);
+
+    return {};
+}
+
+int RenderQueue::getNumPendingJobs() const
+{
+    juce::ScopedLock sl (jobsLock);
+
+    return int (std::count_if (jobs.begin(), jobs.end(), [](const auto& job)
+    {
+        return job->status == Status::Queued || job->status == Status::Rendering;
+    }));
+}
+
+void RenderQueue::setMaximumConcurrentRenders (int numRenders)
+{
+    maxConcurrentRenders = std::max (1, numRenders);
+    updateJobs();
+}
+
+int RenderQueue::getMaximumConcurrentRenders() const
+{
+    return maxConcurrentRenders;
+}
+
+void RenderQueue::setThreadsPerRender (int numThreads)
+{
+    threadsPerRender = std::max (0, numThreads);
+}
+
+int RenderQueue::getThreadsPerRender() const
+{
+    return threadsPerRender;
+}
+
+void RenderQueue::timerCallback()
+{
+    updateJobs();
+}
+
+void RenderQueue::updateJobs()
+{
+    std::vector<std::pair<int, bool>> ended;
+
+    {
+        juce::ScopedLock sl (jobsLock);
+
+        int numRendering = 0;
+        for (auto& job : jobs)
+        {
+            if (job->status == Status::Rendering && job->ended.load())
+            {
+                job->status  = job->success.load() ? Status::Finished : Status::Failed;
+                job->endTime = juce::Time::getMillisecondCounterHiRes() * 0.001;
+                ended.push_back ({ job->jobID, job->success.load() });
+            }
+
+            if (job->status == Status::Rendering)
+                ++numRendering;
+        }
+
+        while (numRendering < maxConcurrentRenders)
+        {
+            // the highest priority first, the same priorities in the order they were added
+            Job* next = nullptr;
+            for (auto& job : jobs)
+                if (job->status == Status::Queued && (next == nullptr || job->priority > next->priority))
+                    next = job.get();
+
+            if (next == nullptr)
+                break;
+
+            // the pool can only grow once cancelled jobs have left it, so replacing it never waits for
+            // them on the message thread. Until then it limits the number of renders
+            if (threadPool == nullptr || (threadPool->getNumJobs() == 0 && threadPool->getNumThreads() < maxConcurrentRenders))
+                threadPool = std::make_unique<juce::ThreadPool> (maxConcurrentRenders);
+
+            if (numRendering >= threadPool->getNumThreads())
+                break;
+
+            startJob (*next);
+
+            if (next->status == Status::Rendering)
+                ++numRendering;
+            else
+                ended.push_back ({ next->jobID, false });
+        }
+    }
+
+    if (onJobFinished)
+        for (const auto& job : ended)
+            onJobFinished (job.first, job.second);
+
+    if (getNumPendingJobs() > 0)
+    {
+        if (! isTimerRunning())
+            startTimer (100);
+
+        return;
+    }
+
+    stopTimer();
+
+    if (queueActive)
+    {
+        queueActive = false;
+
+        if (onQueueFinished)
+            onQueueFinished();
+    }
+}
+
+void RenderQueue::startJob (Job& job)
+{
+    auto& renderer = *job.renderer;
+
+    // the encoders of the concurrent renders share the cores, unless the job asks for a number of threads
+    auto settings = renderer.getVideoEncoderSettings();
+    if (settings.threadCount == 0)
+    {
+        settings.threadCount = threadsPerRender > 0 ? threadsPerRender
+                                                    : std::max (1, juce::SystemStats::getNumCpus() / maxConcurrentRenders);
+        renderer.setVideoEncoderSettings (settings);
+    }
+
+    renderer.setThreadPool (threadPool.get());
+    renderer.onRenderingFinished = [&job, previous = renderer.onRenderingFinished](bool success)
+    {
+        job.success.store (success);
+        job.ended.store (true);
+
+        if (previous)
+            previous (success);
+    };
+
+    job.startTime = juce::Time::getMillisecondCounterHiRes() * 0.001;
+
+    if (renderer.startRendering (false))
+    {
+        job.status = Status::Rendering;
+    }
+    else
+    {
+        FOLEYS_LOG ("Could not start rendering " << renderer.getOutputFile().getFullPathName());
+        job.status  = Status::Failed;
+        job.endTime = job.startTime;
+    }
+}
+
+RenderQueue::JobInfo RenderQueue::createJobInfo (const Job& job) const
+{
+    JobInfo info;
+    info.jobID      = job.jobID;
+    info.priority   = job.priority;
+    info.status     = job.status;
+    info.outputFile = job.renderer->getOutputFile();
+
+    if (job.status == Status::Queued)
+        return info;
+
+    const auto now = job.status == Status::Rendering ? juce::Time::getMillisecondCounterHiRes() * 0.001 : job.endTime;
+    info.secondsElapsed = now - job.startTime;
+    info.progress = job.status == Status::Finished ? 1.0 : job.renderer->progress.load();
+
+    if (job.status != Status::Rendering)
+        info.secondsRemaining = 0.0;
+    else if (info.progress > 0.0)
+        info.secondsRemaining = info.secondsElapsed * (1.0 - info.progress) / info.progress;
+
+    return info;
+}
+
+RenderQueue::Job* RenderQueue::findJob (int jobID) const
+{
+    auto it = std::find_if (jobs.begin(), jobs.end(), [jobID](const auto& job) { return job->jobID == jobID; });
+    return it != jobs.end() ? it->get() : nullptr;
+}
+
+} // foleys
@@ -0,0 +1,147 @@
+/*
+ ==============================================================================
+
+ Copyright (c) 2019 - 2021, Foleys Finest Audio - Daniel Walz
+ All rights reserved.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ ==============================================================================
+ */
+
+#pragma once
+
+namespace foleys
+{
+
+/**
+ @class RenderQueue
+
+ The RenderQueue renders a batch of ClipRenderer jobs on its own thread pool, so exports
+ don't compete with thumbnails and other jobs on the VideoEngine's thread pool.
+ Jobs with a higher priority start first, jobs with the same priority in the order they
+ were added. At most getMaximumConcurrentRenders() jobs are rendered at the same time.
+
+ Add, cancel and query the jobs from the message thread. The VideoEngine owns an instance,
+ see VideoEngine::getRenderQueue().
+ */
+class RenderQueue  : private juce::Timer
+{
+public:
+    enum class Status
+    {
+        Queued = 0, /**< The job waits for a free slot */
+        Rendering,  /**< The job is currently rendered */
+        Finished,   /**< The job was rendered successfully */
+        Failed,     /**< The output couldn't be written */
+        Cancelled   /**< The job was cancelled */
+    };
+
+    /** A snapshot of a job's state */
+    struct JobInfo
+    {
+        int        jobID            = 0;
+        int        priority         = 0;
+        Status     status           = Status::Queued;
+        double     progress         = 0.0;
+        double     secondsElapsed   = 0.0;
+        double     secondsRemaining = -1.0;   /**< Estimated from the progress so far, negative if unknown */
+        juce::File outputFile;
+    };
+
+    RenderQueue() = default;
+    ~RenderQueue() override;
+
+    /**
+     Adds a ClipRenderer, that is set up with clip, output file and settings.
+     The queue takes ownership and starts it, as soon as a slot is free.
+     @returns the jobID to refer to the job
+     */
+    int addJob (std::unique_ptr<ClipRenderer> renderer, int priority = 0);
+
+    /** Changes the priority of a job, that didn't start yet */
+    void setPriority (int jobID, int priority);
+
+    /** Cancels a queued or running job. Returns false, if the job doesn't exist or has already ended */
+    bool cancelJob (int jobID);
+    void cancelAllJobs();
+
+    /** Removes the jobs, that finished, failed or were cancelled, from the list */
+    void removeEndedJobs();
+
+    std::vector<JobInfo> getJobs() const;
+    JobInfo getJobInfo (int jobID) const;
+
+    /** The number of jobs, that are queued or rendering */
+    int getNumPendingJobs() const;
+
+    /** The number of jobs rendered at the same time */
+    void setMaximumConcurrentRenders (int numRenders);
+    int getMaximumConcurrentRenders() const;
+
+    /**
+     The number of encoder threads a job gets, unless its VideoEncoderSettings set a threadCount.
+     0 splits the cores evenly between the concurrent renders.
+     */
+    void setThreadsPerRender (int numThreads);
+    int getThreadsPerRender() const;
+
+    /** Called on the message thread when a job ended, with success false if it failed or was cancelled */
+    std::function<void(int jobID, bool success)> onJobFinished;
+
+    /** Called on the message thread when the last pending job ended */
+    std::function<void()> onQueueFinished;
+
+private:
+    struct Job
+    {
+        std::unique_ptr<ClipRenderer> renderer;
+        int    jobID    = 0;
+        int    priority = 0;
+        Status status   = Status::Queued;
+        double startTime = 0.0;
+        double endTime   = 0.0;
+
+        // set by the ClipRenderer's callback on the rendering thread
+        std::atomic<bool> ended   { false };
+        std::atomic<bool> success { false };
+    };
+
+    void timerCallback() override;
+
+    /** Collects the jobs, that ended since the last call, and starts queued jobs into free slots */
+    void updateJobs();
+
+    void startJob (Job& job);
+
+    /** Cancels a queued or rendering job without notifying. Returns false, if the job already ended */
+    bool cancel (Job& job);
+
+    JobInfo createJobInfo (const Job& job) const;
+
+    Job* findJob (int jobID) const;
+
+    juce::CriticalSection             jobsLock;
+    std::vector<std::unique_ptr<Job>> jobs;
+    int                               nextJobID = 1;
+    bool                              queueActive = false;
+
+    int maxConcurrentRenders = 2;
+    int threadsPerRender     = 0;
+
+    // declared after the jobs, so the pool finishes the running jobs before their renderers are destroyed
+    std::unique_ptr<juce::ThreadPool> threadPool;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (RenderQueue)
+};
+
+} // foleys
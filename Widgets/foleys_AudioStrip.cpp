@@ -25,14 +25,16 @@ AudioStrip::AudioStrip()
 {
     clipAudioParameters = juce::ValueTree (IDs::audioParameters);
 
-    formatManager.registerBasicFormats();
-    thumbnail.addChangeListener (this);
+    setColour (waveformColourId, juce::Colours::silver.withAlpha (0.7f));
+    setColour (rmsColourId, juce::Colours::white.withAlpha (0.8f));
     setOpaque (false);
     setInterceptsMouseClicks (false, true);
 }
 
 AudioStrip::~AudioStrip()
 {
+    clipAudioParameters.removeListener (this);
+
     if (thumbnailJob != nullptr)
         if (auto* threadPool = getThreadPool())
             threadPool->removeJob (thumbnailJob.get(), true, 1000);
@@ -40,28 +42,101 @@ AudioStrip::~AudioStrip()
 
 void AudioStrip::setClip (std::shared_ptr<ClipDescriptor> descriptor)
 {
+    clipAudioParameters.removeListener (this);
     clipAudioParameters = descriptor->getStatusTree().getChildWithName (IDs::audioParameters);
+    clipAudioParameters.addListener (this);
+
     setClip (descriptor->clip);
 }
 
 void AudioStrip::setClip (std::shared_ptr<AVClip> clipToUse)
 {
-    clip = clipToUse;
-
-    if (clip.get() == nullptr)
+    if (clip == clipToUse)
         return;
 
+    if (thumbnailJob != nullptr)
+        if (auto* threadPool = getThreadPool())
+            threadPool->removeJob (thumbnailJob.get(), true, 1000);
+
+    thumbnailJob.reset();
+    peaks.reset();
+    clip = clipToUse;
+
     update();
+    repaint();
 }
 
 void AudioStrip::paint (juce::Graphics& g)
 {
-    thumbnail.drawChannels (g, getLocalBounds(), startTime, endTime, 2.0);
+    if (peaks == nullptr || clip == nullptr || endTime <= startTime || getWidth() <= 0)
+        return;
+
+    const auto numChannels = peaks->getNumChannels();
+    if (numChannels <= 0)
+        return;
+
+    const ProcessorParameter* gainParameter = nullptr;
+    const auto& audioParameters = clip->getAudioParameters();
+    auto parameter = audioParameters.find (IDs::gain);
+    if (parameter != audioParameters.end())
+        gainParameter = parameter->second.get();
+
+    std::map<double, double> keyframes;
+    auto gainValue = gainParameter != nullptr ? gainParameter->getNormalisedValue() : 1.0;
+
+    if (gainParameter != nullptr)
+    {
+        auto node = clipAudioParameters.getChildWithProperty (IDs::name, gainParameter->getName());
+        if (node.isValid())
+        {
+            gainValue = node.getProperty (IDs::value, gainValue);
+            for (const auto& keyframe : node)
+                if (keyframe.hasType (IDs::keyframe))
+                    keyframes [double (keyframe.getProperty (IDs::time))] = double (keyframe.getProperty (IDs::value));
+        }
+    }
+
+    const auto width = getWidth();
+    const auto channelHeight = getHeight() / float (numChannels);
+    const auto secondsPerPixel = (endTime - startTime) / width;
+
+    juce::RectangleList<float> waveform;
+    juce::RectangleList<float> rms;
+    WaveformPeaks::Peak peak;
+
+    for (int x = 0; x < width; ++x)
+    {
+        const auto time = startTime + x * secondsPerPixel;
+        const auto gain = gainParameter != nullptr ? getGainAt (*gainParameter, time, keyframes, gainValue) : 1.0f;
+        const auto scale = 0.5f * channelHeight * gain;
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            if (! peaks->getPeak (channel, time, time + secondsPerPixel, peak))
+                continue;
+
+            const auto centre = (channel + 0.5f) * channelHeight;
+            const auto top    = juce::jlimit (0.0f, getHeight() - 1.0f, centre - peak.maximum * scale);
+            const auto bottom = juce::jlimit (0.0f, float (getHeight()), centre - peak.minimum * scale);
+            waveform.addWithoutMerging ({ float (x), top, 1.0f, std::max (1.0f, bottom - top) });
+
+            const auto rmsHeight = std::min (peak.rms * scale, channelHeight * 0.5f);
+            if (rmsHeight > 0.5f)
+                rms.addWithoutMerging ({ float (x), centre - rmsHeight, 1.0f, 2.0f * rmsHeight });
+        }
+    }
+
+    g.setColour (findColour (waveformColourId));
+    g.fillRectList (waveform);
+    g.setColour (findColour (rmsColourId));
+    g.fillRectList (rms);
 }
 
-void AudioStrip::changeListenerCallback (juce::ChangeBroadcaster*)
+float AudioStrip::getGainAt (const ProcessorParameter& gainParameter, double time,
+                              const std::map<double, double>& keyframes, double value) const
 {
-    repaint();
+    const auto normalised = ParameterAutomation::getValueForTime (keyframes, value, time);
+    return juce::Decibels::decibelsToGain (float (gainParameter.unNormaliseValue (normalised)));
 }
 
 void AudioStrip::setStartAndEnd (double start, double end)
@@ -69,27 +144,38 @@ void AudioStrip::setStartAndEnd (double start, double end)
     startTime = start;
     endTime = end;
 
-    update();
+    repaint();
 }
 
 void AudioStrip::update()
 {
-    if (clip == nullptr ||
-        endTime <= startTime ||
-        endTime <= rendered)
+    if (clip == nullptr || thumbnailJob != nullptr)
         return;
 
     auto* threadPool = getThreadPool();
     if (threadPool == nullptr)
         return;
 
-    if (thumbnailJob != nullptr)
-        threadPool->removeJob (thumbnailJob.get(), true, 1000);
+    thumbnailJob = std::make_unique<ThumbnailJob>(*this, clip);
+    threadPool->addJob (thumbnailJob.get(), false);
+}
+
+void AudioStrip::setPeaks (std::shared_ptr<WaveformPeaks> peaksToUse)
+{
+    peaks = peaksToUse;
 
-    thumbnailJob = std::make_unique<ThumbnailJob>(*this);
-    rendered = endTime;
+    if (peaks != nullptr && ! peaks->isComplete())
+        startTimerHz (5);
 
-    threadPool->addJob (thumbnailJob.get(), false);
+    repaint();
+}
+
+void AudioStrip::timerCallback()
+{
+    if (peaks == nullptr || peaks->isComplete())
+        stopTimer();
+
+    repaint();
 }
 
 juce::ThreadPool* AudioStrip::getThreadPool()
@@ -105,65 +191,174 @@ juce::ThreadPool* AudioStrip::getThreadPool()
 
 //==============================================================================
 
-AudioStrip::ThumbnailJob::ThumbnailJob (AudioStrip& ownerToUse)
+AudioStrip::ThumbnailJob::ThumbnailJob (AudioStrip& ownerToUse, std::shared_ptr<AVClip> clipToUse)
   : juce::ThreadPoolJob ("Audio Thumbnail Job"),
-    owner (ownerToUse)
+    owner (ownerToUse),
+    clipToRender (clipToUse)
+{
+}
+
+juce::ThreadPoolJob::JobStatus AudioStrip::ThumbnailJob::runJob()
 {
-    clipToRender = owner.clip->createCopy (StreamTypes::audio());
+    auto* engine = clipToRender->getVideoEngine();
+    if (engine == nullptr || shouldExit())
+        return juce::ThreadPoolJob::jobHasFinished;
+
+    auto media = clipToRender->getMediaFile();
+    if (media.isLocalFile())
+    {
+        auto file = media.getLocalFile();
+        auto key  = file.getFullPathName() + ":" + juce::String (file.getSize()) + ":" + juce::String (file.getLastModificationTime().toMilliseconds());
+        auto cacheFile = engine->getCacheDirectory().getChildFile ("peaks_" + juce::String::toHexString (key.hashCode64()) + ".peaks");
+
+        auto cached = std::make_shared<WaveformPeaks>();
+        if (cacheFile.existsAsFile() && cached->readFromFile (cacheFile))
+        {
+            publish (cached);
+            return juce::ThreadPoolJob::jobHasFinished;
+        }
+
+        const auto success = file.hasFileExtension ("wav;aif;aiff;mp3;wma;m4a") ? readFromAudioFile (file)
+                                                                                 : readFromMovieFile (file);
+        if (success)
+        {
+            if (peaks->isComplete() && cacheFile.getParentDirectory().createDirectory())
+                if (! peaks->writeToFile (cacheFile))
+                    FOLEYS_LOG ("Could not write waveform cache: " << cacheFile.getFullPathName());
+
+            return juce::ThreadPoolJob::jobHasFinished;
+        }
+    }
 
-    parameterController = std::make_unique<ClipDescriptor::ClipParameterController>(*this);
-    parameterController->setClip (clipToRender->getAudioParameters(), owner.clipAudioParameters, nullptr);
+    readFromClip();
+    return juce::ThreadPoolJob::jobHasFinished;
 }
 
-double AudioStrip::ThumbnailJob::getCurrentTimeInSeconds() const
+bool AudioStrip::ThumbnailJob::readFromAudioFile (const juce::File& file)
 {
-    return position / sampleRate;
+    auto* engine = clipToRender->getVideoEngine();
+    std::unique_ptr<juce::AudioFormatReader> reader (engine->getAudioFormatManager().createReaderFor (file));
+    if (reader == nullptr || reader->numChannels == 0)
+        return false;
+
+    peaks = std::make_shared<WaveformPeaks>();
+    peaks->prepare (int (reader->numChannels), reader->sampleRate, reader->lengthInSamples);
+    publish (peaks);
+
+    const auto blockSize = 65536;
+    juce::AudioBuffer<float> buffer (int (reader->numChannels), blockSize);
+
+    for (juce::int64 position = 0; position < reader->lengthInSamples; position += blockSize)
+    {
+        if (shouldExit())
+            return true;
+
+        const auto numSamples = int (std::min (juce::int64 (blockSize), reader->lengthInSamples - position));
+        reader->read (&buffer, 0, numSamples, position, true, true);
+        peaks->addSamples (buffer.getArrayOfReadPointers(), buffer.getNumChannels(), numSamples);
+    }
+
+    peaks->finish();
+    return true;
 }
 
-juce::ThreadPoolJob::JobStatus AudioStrip::ThumbnailJob::runJob()
+bool AudioStrip::ThumbnailJob::readFromMovieFile (const juce::File& file)
 {
-    const auto blockSize  = 1024;
-    const auto length = juce::int64 ((owner.startTime + owner.endTime) * sampleRate);
+    auto* engine = clipToRender->getVideoEngine();
+    auto reader = engine->createReaderFor (file, StreamTypes::audio());
+    if (reader == nullptr || ! reader->isOpenedOk() || ! reader->hasAudio() || reader->numChannels <= 0)
+        return false;
 
-    if (shouldExit())
-        return juce::ThreadPoolJob::jobHasFinished;
+    // decode at the native sample rate, the peaks don't need resampling
+    reader->setOutputSampleRate (reader->sampleRate);
+    reader->setPosition (0);
 
-    clipToRender->prepareToPlay (blockSize, sampleRate);
-    if (owner.thumbnail.getNumChannels() != 2)
-        owner.thumbnail.reset (2, sampleRate, 0);
+    peaks = std::make_shared<WaveformPeaks>();
+    peaks->prepare (reader->numChannels, reader->sampleRate, reader->numSamples);
+    publish (peaks);
 
-    position = juce::int64 (std::max (0.0, owner.thumbnail.getTotalLength() * sampleRate - blockSize));
+    VideoFifo videoFifo (1);
+    AudioFifo audioFifo (std::max (65536, int (reader->sampleRate)), reader->numChannels);
+    audioFifo.setPosition (0);
 
-    juce::AudioBuffer<float> buffer (2, blockSize);
-    juce::AudioSourceChannelInfo info (&buffer, 0, buffer.getNumSamples());
+    juce::AudioBuffer<float> buffer (reader->numChannels, audioFifo.getSize());
 
-    if (position >= blockSize)
-    {
-        // one to discard -> update automation state from potential smoothing
-        parameterController->updateAutomations (getCurrentTimeInSeconds());
-        clipToRender->getNextAudioBlock (info);
-        position += buffer.getNumSamples();
-    }
+    // a broken stream might never signal the end, stop if it doesn't produce samples anymore
+    int readsWithoutSamples = 0;
 
-    int retryCount = 0;
-    while (!shouldExit() && position < length)
+    while (! shouldExit() && ! reader->isEndOfStream() && readsWithoutSamples < 1000)
     {
-        parameterController->updateAutomations (getCurrentTimeInSeconds());
-        if (clipToRender->waitForSamplesReady (blockSize))
-        {
-            clipToRender->getNextAudioBlock (info);
-            owner.thumbnail.addBlock (position, buffer, 0, buffer.getNumSamples());
-            position += buffer.getNumSamples();
-            retryCount = 0;
-        }
-        else
+        reader->readNewData (videoFifo, audioFifo);
+
+        const auto available = audioFifo.getAvailableSamples();
+        if (available == 0)
         {
-            if (++retryCount > 10)
-                return juce::ThreadPoolJob::jobHasFinished;
+            ++readsWithoutSamples;
+            continue;
         }
+
+        readsWithoutSamples = 0;
+        juce::AudioSourceChannelInfo info (&buffer, 0, available);
+        audioFifo.pullSamples (info);
+        peaks->addSamples (buffer.getArrayOfReadPointers(), buffer.getNumChannels(), available);
     }
 
-    return juce::ThreadPoolJob::jobHasFinished;
+    if (! shouldExit())
+        peaks->finish();
+
+    return true;
+}
+
+bool AudioStrip::ThumbnailJob::readFromClip()
+{
+    // clips without a media file, e.g. a ComposedClip, are rendered with the clip's own audio chain
+    auto copy = clipToRender->createCopy (StreamTypes::audio());
+    if (copy == nullptr)
+        return false;
+
+    const auto& audioParameters = copy->getAudioParameters();
+    auto gain = audioParameters.find (IDs::gain);
+    if (gain != audioParameters.end())
+        gain->second->setRealValue (0.0);   // the gain is applied when drawing
+
+    const auto blockSize  = 4096;
+    const auto sampleRate = copy->getSampleRate() > 0 ? copy->getSampleRate() : 48000.0;
+    const auto length     = juce::int64 (copy->getLengthInSeconds() * sampleRate);
+    const auto numChannels = 2;
+
+    copy->setOfflineMode (true);
+    copy->prepareToPlay (blockSize, sampleRate);
+    copy->setNextReadPosition (0);
+
+    peaks = std::make_shared<WaveformPeaks>();
+    peaks->prepare (numChannels, sampleRate, length);
+    publish (peaks);
+
+    juce::AudioBuffer<float> buffer (numChannels, blockSize);
+
+    for (juce::int64 position = 0; position < length; position += blockSize)
+    {
+        if (shouldExit())
+            return true;
+
+        const auto numSamples = int (std::min (juce::int64 (blockSize), length - position));
+        juce::AudioSourceChannelInfo info (&buffer, 0, numSamples);
+        copy->getNextAudioBlock (info);
+        peaks->addSamples (buffer.getArrayOfReadPointers(), numChannels, numSamples);
+    }
+
+    peaks->finish();
+    return true;
+}
+
+void AudioStrip::ThumbnailJob::publish (std::shared_ptr<WaveformPeaks> peaksToPublish)
+{
+    juce::Component::SafePointer<AudioStrip> strip (&owner);
+    juce::MessageManager::callAsync ([strip, clip = clipToRender, peaksToPublish]() mutable
+                                     {
+                                         if (strip && strip->clip == clip)
+                                             strip->setPeaks (peaksToPublish);
+                                     });
 }
 
 } // foleys
@@ -26,16 +26,26 @@ namespace foleys
 /**
  @class AudioStrip
 
- This class displays the audio curves of the clip.
+ This class displays the audio curves of the clip. The peaks are generated once per clip
+ in a background job and cached next to the other render caches of the VideoEngine,
+ so zooming and scrolling only draws the stored peaks. The clip gain is applied when
+ drawing, so changing the gain doesn't need to read the audio again.
  */
 class AudioStrip  : public juce::Component,
-                    private juce::ChangeListener
+                    private juce::ValueTree::Listener,
+                    private juce::Timer
 {
 public:
     AudioStrip();
 
     ~AudioStrip() override;
 
+    enum ColourIds
+    {
+        waveformColourId = 0x2002000, /**< The min and max curves */
+        rmsColourId                   /**< The RMS in front of the min and max */
+    };
+
     /** Set the clip to be shown as thumbnail */
     void setClip (std::shared_ptr<AVClip> clip);
     void setClip (std::shared_ptr<ClipDescriptor> descriptor);
@@ -47,22 +57,26 @@ public:
         is used to allow only a subset of thumbnails to be shown. */
     void setStartAndEnd (double start, double end);
 
+    /** Returns the peaks of the current clip, or nullptr while they are not available */
+    std::shared_ptr<WaveformPeaks> getPeaks() const { return peaks; }
+
     /** @internal */
-    class ThumbnailJob : public juce::ThreadPoolJob,
-                         public TimeCodeAware
+    class ThumbnailJob : public juce::ThreadPoolJob
     {
     public:
-        ThumbnailJob (AudioStrip& owner);
-
-        double getCurrentTimeInSeconds() const override;
+        ThumbnailJob (AudioStrip& owner, std::shared_ptr<AVClip> clip);
 
         juce::ThreadPoolJob::JobStatus runJob() override;
     private:
+        bool readFromAudioFile (const juce::File& file);
+        bool readFromMovieFile (const juce::File& file);
+        bool readFromClip();
+
+        void publish (std::shared_ptr<WaveformPeaks> peaks);
+
         AudioStrip&  owner;
         std::shared_ptr<AVClip> clipToRender;
-        std::unique_ptr<ClipDescriptor::ClipParameterController> parameterController;
-        juce::int64  position = 0;
-        const double sampleRate = 48000.0;
+        std::shared_ptr<WaveformPeaks> peaks;
 
         JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ThumbnailJob)
     };
@@ -73,22 +87,31 @@ private:
 
     /** @internal */
     void update();
+
+    /** @internal */
+    void setPeaks (std::shared_ptr<WaveformPeaks> peaks);
+
     /** @internal */
-    void changeListenerCallback (juce::ChangeBroadcaster* sender) override;
+    void timerCallback() override;
 
     /** @internal */
     juce::ThreadPool* getThreadPool();
 
+    /** Returns the gain factor of the clip gain including automation at the time in seconds */
+    float getGainAt (const ProcessorParameter& gainParameter, double time,
+                     const std::map<double, double>& keyframes, double value) const;
+
+    void valueTreePropertyChanged (juce::ValueTree&, const juce::Identifier&) override { repaint(); }
+    void valueTreeChildAdded (juce::ValueTree&, juce::ValueTree&) override { repaint(); }
+    void valueTreeChildRemoved (juce::ValueTree&, juce::ValueTree&, int) override { repaint(); }
+
     std::shared_ptr<AVClip> clip;
     double startTime = {};
     double endTime   = {};
-    double rendered  = {};
     juce::ValueTree clipAudioParameters;
 
-    std::unique_ptr<ThumbnailJob> thumbnailJob;
-    juce::AudioThumbnailCache cache { 1 };
-    juce::AudioFormatManager  formatManager;
-    juce::AudioThumbnail      thumbnail { 64, formatManager, cache };
+    std::unique_ptr<ThumbnailJob>  thumbnailJob;
+    std::shared_ptr<WaveformPeaks> peaks;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (AudioStrip)
 };
@@ -0,0 +1,327 @@
+/*
+ ==============================================================================
+
+ Copyright (c) 2019 - 2021, Foleys Finest Audio - Daniel Walz
+ All rights reserved.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ ==============================================================================
+ */
+
+namespace foleys
+{
+
+namespace
+{
+    constexpr int peaksFileMagic   = 0x534b5046; // "FPKS"
+    constexpr int peaksFileVersion = 2;
+
+    int16_t toStoredSample (float value)
+    {
+        return int16_t (std::lround (juce::jlimit (-1.0f, 1.0f, value) * 32767.0f));
+    }
+
+    float fromStoredSample (int16_t value)
+    {
+        return value / 32767.0f;
+    }
+}
+
+void WaveformPeaks::prepare (int numChannelsToUse, double sampleRateToUse, int64_t expectedLengthInSamples)
+{
+    numChannels = std::max (numChannelsToUse, 0);
+    sampleRate  = sampleRateToUse;
+
+    accumulators.assign (size_t (numChannels), {});
+    accumulated = 0;
+    numSamplesAdded.store (0);
+    complete.store (false);
+
+    // the length of compressed streams is only an estimate, leave some headroom
+    allocateLevels (expectedLengthInSamples + expectedLengthInSamples / 100 + baseSamplesPerPeak);
+}
+
+void WaveformPeaks::allocateLevels (int64_t lengthInSamples)
+{
+    levels.clear();
+    capacity = std::max (lengthInSamples, int64_t (0));
+
+    int64_t samplesPerPeak = baseSamplesPerPeak;
+    while (true)
+    {
+        auto level = std::make_unique<Level>();
+        level->samplesPerPeak = samplesPerPeak;
+
+        const auto numPeaks = (capacity + samplesPerPeak - 1) / samplesPerPeak;
+        level->peaks.resize (size_t (numPeaks * numChannels));
+        levels.push_back (std::move (level));
+
+        if (numPeaks <= 1)
+            break;
+
+        samplesPerPeak *= levelFactor;
+    }
+}
+
+void WaveformPeaks::addSamples (const float* const* channels, int numChannelsToAdd, int numSamples)
+{
+    if (complete.load() || levels.empty())
+        return;
+
+    int offset = 0;
+    while (offset < numSamples)
+    {
+        const auto numToAdd = std::min (numSamples - offset, baseSamplesPerPeak - accumulated);
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            auto& accumulator = accumulators [size_t (channel)];
+
+            if (channel < numChannelsToAdd)
+            {
+                const auto* samples = channels [channel] + offset;
+                const auto  range   = juce::FloatVectorOperations::findMinAndMax (samples, numToAdd);
+
+                accumulator.minimum = std::min (accumulator.minimum, range.getStart());
+                accumulator.maximum = std::max (accumulator.maximum, range.getEnd());
+                accumulator.sumOfSquares += VectorMath::sumOfSquares (samples, numToAdd);
+            }
+            else
+            {
+                accumulator.minimum = std::min (accumulator.minimum, 0.0f);
+                accumulator.maximum = std::max (accumulator.maximum, 0.0f);
+            }
+        }
+
+        offset += numToAdd;
+        accumulated += numToAdd;
+        numSamplesAdded.fetch_add (numToAdd);
+
+        if (accumulated >= baseSamplesPerPeak)
+            finishPeak();
+    }
+}
+
+void WaveformPeaks::finishPeak()
+{
+    if (accumulated == 0)
+        return;
+
+    auto& level = *levels.front();
+    const auto index = level.numReady.load();
+
+    if (index * numChannels < int64_t (level.peaks.size()))
+    {
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            auto& accumulator = accumulators [size_t (channel)];
+            auto& stored = level.peaks [size_t (index * numChannels + channel)];
+
+            stored.minimum = toStoredSample (accumulator.minimum);
+            stored.maximum = toStoredSample (accumulator.maximum);
+            stored.rms     = toStoredSample (float (std::sqrt (accumulator.sumOfSquares / accumulated)));
+
+            accumulator = {};
+        }
+
+        level.numReady.store (index + 1, std::memory_order_release);
+    }
+
+    accumulated = 0;
+    updateLevels();
+}
+
+void WaveformPeaks::updateLevels()
+{
+    const auto isFinishing = numSamplesAdded.load() >= capacity || complete.load();
+
+    for (size_t l = 1; l < levels.size(); ++l)
+    {
+        const auto& source = *levels [l - 1];
+        auto& target = *levels [l];
+
+        const auto numSource = source.numReady.load();
+        auto index = target.numReady.load();
+
+        // combine full groups only, unless there are no more samples to come
+        while (index * numChannels < int64_t (target.peaks.size()) &&
+               ((index + 1) * levelFactor <= numSource || (isFinishing && index * levelFactor < numSource)))
+        {
+            const auto first = index * levelFactor;
+            const auto last  = std::min (first + levelFactor, numSource);
+
+            for (int channel = 0; channel < numChannels; ++channel)
+            {
+                int16_t minimum = std::numeric_limits<int16_t>::max();
+                int16_t maximum = std::numeric_limits<int16_t>::lowest();
+                double  sumOfSquares = 0.0;
+
+                for (auto i = first; i < last; ++i)
+                {
+                    const auto& peak = source.peaks [size_t (i * numChannels + channel)];
+                    minimum = std::min (minimum, peak.minimum);
+                    maximum = std::max (maximum, peak.maximum);
+                    sumOfSquares += double (peak.rms) * peak.rms;
+                }
+
+                auto& stored = target.peaks [size_t (index * numChannels + channel)];
+                stored.minimum = minimum;
+                stored.maximum = maximum;
+                stored.rms     = int16_t (std::lround (std::sqrt (sumOfSquares / double (last - first))));
+            }
+
+            ++index;
+            target.numReady.store (index, std::memory_order_release);
+        }
+    }
+}
+
+void WaveformPeaks::finish()
+{
+    if (complete.load() || levels.empty())
+        return;
+
+    finishPeak();
+    complete.store (true);
+    updateLevels();
+}
+
+bool WaveformPeaks::getPeak (int channel, double startTime, double endTime, Peak& peak) const
+{
+    if (channel < 0 || channel >= numChannels || sampleRate <= 0.0 || levels.empty())
+        return false;
+
+    const auto start = std::max (int64_t (0), int64_t (startTime * sampleRate));
+    const auto end   = std::max (start + 1, int64_t (endTime * sampleRate));
+
+    for (auto l = int (levels.size()) - 1; l >= 0; --l)
+    {
+        const auto& level = *levels [size_t (l)];
+        if (l > 0 && level.samplesPerPeak > end - start)
+            continue;
+
+        // coarser levels are filled later, so fall back to finer ones while generating
+        const auto numReady = level.numReady.load (std::memory_order_acquire);
+        const auto first = start / level.samplesPerPeak;
+        const auto last  = std::min (numReady, std::max (first + 1, (end + level.samplesPerPeak - 1) / level.samplesPerPeak));
+
+        if (first >= last)
+            continue;
+
+        int16_t minimum = std::numeric_limits<int16_t>::max();
+        int16_t maximum = std::numeric_limits<int16_t>::lowest();
+        double  sumOfSquares = 0.0;
+
+        for (auto i = first; i < last; ++i)
+        {
+            const auto& stored = level.peaks [size_t (i * numChannels + channel)];
+            minimum = std::min (minimum, stored.minimum);
+            maximum = std::max (maximum, stored.maximum);
+            sumOfSquares += double (stored.rms) * stored.rms;
+        }
+
+        peak.minimum = fromStoredSample (minimum);
+        peak.maximum = fromStoredSample (maximum);
+        peak.rms     = float (std::sqrt (sumOfSquares / double (last - first)) / 32767.0);
+        return true;
+    }
+
+    return false;
+}
+
+bool WaveformPeaks::writeToFile (const juce::File& file) const
+{
+    if (! complete.load())
+        return false;
+
+    juce::TemporaryFile temp (file);
+
+    {
+        juce::FileOutputStream stream (temp.getFile());
+        if (stream.failedToOpen())
+            return false;
+
+        stream.writeInt (peaksFileMagic);
+        stream.writeInt (peaksFileVersion);
+        stream.writeInt (numChannels);
+        stream.writeDouble (sampleRate);
+        stream.writeInt64 (numSamplesAdded.load());
+        stream.writeInt64 (capacity);
+        stream.writeInt (int (levels.size()));
+
+        for (const auto& level : levels)
+        {
+            const auto numReady = level->numReady.load();
+            stream.writeInt64 (level->samplesPerPeak);
+            stream.writeInt64 (numReady);
+            stream.write (level->peaks.data(), size_t (numReady * numChannels) * sizeof (StoredPeak));
+        }
+
+        stream.flush();
+        if (stream.getStatus().failed())
+            return false;
+    }
+
+    return temp.overwriteTargetFileWithTemporary();
+}
+
+bool WaveformPeaks::readFromFile (const juce::File& file)
+{
+    juce::FileInputStream stream (file);
+    if (stream.failedToOpen())
+        return false;
+
+    if (stream.readInt() != peaksFileMagic || stream.readInt() != peaksFileVersion)
+        return false;
+
+    const auto channels   = stream.readInt();
+    const auto rate       = stream.readDouble();
+    const auto length     = stream.readInt64();
+    const auto allocated  = stream.readInt64();
+    const auto numLevels  = stream.readInt();
+
+    if (channels <= 0 || channels > 64 || rate <= 0.0 || length < 0 || allocated < length || numLevels <= 0)
+        return false;
+
+    numChannels = channels;
+    sampleRate  = rate;
+
+    // the levels are allocated like they were written, the headroom of prepare() can add a level
+    allocateLevels (allocated);
+
+    if (int (levels.size()) != numLevels)
+        return false;
+
+    for (auto& level : levels)
+    {
+        const auto samplesPerPeak = stream.readInt64();
+        const auto numReady = stream.readInt64();
+
+        if (samplesPerPeak != level->samplesPerPeak || numReady < 0 || numReady * numChannels > int64_t (level->peaks.size()))
+            return false;
+
+        const auto numBytes = size_t (numReady * numChannels) * sizeof (StoredPeak);
+        if (stream.read (level->peaks.data(), int (numBytes)) != int (numBytes))
+            return false;
+
+        level->numReady.store (numReady);
+    }
+
+    accumulators.assign (size_t (numChannels), {});
+    accumulated = 0;
+    numSamplesAdded.store (length);
+    complete.store (true);
+    return true;
+}
+
+} // foleys
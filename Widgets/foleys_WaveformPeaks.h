@@ -0,0 +1,128 @@
+/*
+ ==============================================================================
+
+ Copyright (c) 2019 - 2021, Foleys Finest Audio - Daniel Walz
+ All rights reserved.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ ==============================================================================
+ */
+#pragma once
+
+namespace foleys
+{
+
+/**
+ @class WaveformPeaks
+
+ Holds the minimum, maximum and RMS of an audio stream in several resolutions to draw
+ waveforms at any zoom level without decoding the audio again. The finest level sums up
+ baseSamplesPerPeak samples, each further level combines levelFactor peaks of the level
+ below. The values are stored as 16 bit, so an hour of stereo audio needs about 8 MB.
+
+ The peaks are added progressively on one thread with addSamples(), while other threads
+ can already draw the peaks, that are finished.
+ */
+class WaveformPeaks final
+{
+public:
+    WaveformPeaks() = default;
+
+    /** The summary of a range of samples in one channel, normalised to -1..1 */
+    struct Peak
+    {
+        float minimum = 0.0f;
+        float maximum = 0.0f;
+        float rms     = 0.0f;
+    };
+
+    static constexpr int baseSamplesPerPeak = 256;
+    static constexpr int levelFactor        = 4;
+
+    /**
+     Allocates all levels for an estimated length. Call this before addSamples() and before
+     handing the peaks to another thread. Samples beyond the estimated length are ignored.
+     */
+    void prepare (int numChannels, double sampleRate, int64_t expectedLengthInSamples);
+
+    /** Adds the next samples. This must only be called from one thread */
+    void addSamples (const float* const* channels, int numChannels, int numSamples);
+
+    /** Adds the last incomplete peaks and marks the peaks as complete */
+    void finish();
+
+    /** Returns true, once all samples were added or the peaks were read from a file */
+    bool isComplete() const { return complete.load(); }
+
+    int getNumChannels() const  { return numChannels; }
+    double getSampleRate() const { return sampleRate; }
+
+    /** Returns the length in samples, that was added so far */
+    int64_t getNumSamples() const { return numSamplesAdded.load(); }
+
+    /**
+     Returns the summary of channel between the times in seconds. It uses the coarsest level,
+     that still has at least one peak in this range, so a waveform can be drawn by calling this
+     once per pixel. Returns false, if the range is not available (yet).
+     */
+    bool getPeak (int channel, double startTime, double endTime, Peak& peak) const;
+
+    /** Writes the peaks into a compact file. Only complete peaks are written */
+    bool writeToFile (const juce::File& file) const;
+
+    /** Reads the peaks from a file, that was written by writeToFile(). Call this instead of prepare() */
+    bool readFromFile (const juce::File& file);
+
+private:
+    struct StoredPeak
+    {
+        int16_t minimum = 0;
+        int16_t maximum = 0;
+        int16_t rms     = 0;
+    };
+
+    struct Level
+    {
+        int64_t                 samplesPerPeak = baseSamplesPerPeak;
+        std::vector<StoredPeak> peaks;  // interleaved by channel
+        std::atomic<int64_t>    numReady { 0 };
+    };
+
+    void finishPeak();
+    void updateLevels();
+    void allocateLevels (int64_t lengthInSamples);
+
+    int     numChannels = 0;
+    double  sampleRate  = 0.0;
+    int64_t capacity    = 0;
+
+    std::vector<std::unique_ptr<Level>> levels;
+
+    /** The peak of the finest level, that is currently summed up */
+    struct Accumulator
+    {
+        float  minimum      = std::numeric_limits<float>::max();
+        float  maximum      = std::numeric_limits<float>::lowest();
+        double sumOfSquares = 0.0;
+    };
+
+    std::vector<Accumulator> accumulators;
+    int                      accumulated = 0;
+
+    std::atomic<int64_t> numSamplesAdded { 0 };
+    std::atomic<bool>    complete        { false };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (WaveformPeaks)
+};
+
+} // foleys
@@ -21,8 +21,14 @@
 #include "foleys_video_engine.h"
 
 #include "Basics/foleys_Usage.cpp"
+#include "Basics/foleys_PerformanceCounters.cpp"
+#include "Basics/foleys_VideoFrame.cpp"
 #include "Basics/foleys_VideoFifo.cpp"
 #include "Basics/foleys_AudioFifo.cpp"
+#include "Basics/foleys_Resampler.cpp"
+#include "Basics/foleys_TimeStretcher.cpp"
+#include "Basics/foleys_BufferingManager.cpp"
+#include "Basics/foleys_ReaderScheduler.cpp"
 #include "Basics/foleys_VideoEngine.cpp"
 #include "Basics/foleys_TimeCodeAware.cpp"
 
@@ -32,6 +38,7 @@
 #include "Clips/foleys_MovieClip.cpp"
 #include "Clips/foleys_ComposedClip.cpp"
 #include "Clips/foleys_ClipDescriptor.cpp"
+#include "Clips/foleys_AudioFreezer.cpp"
 
 #include "Plugins/foleys_AudioPluginManager.cpp"
 #include "Plugins/foleys_VideoPluginManager.cpp"
@@ -41,9 +48,11 @@
 #include "Processing/foleys_ProcessorParameter.cpp"
 #include "Processing/foleys_ProcessorController.cpp"
 #include "Processing/foleys_DefaultAudioMixer.cpp"
+#include "Processing/foleys_LoudnessMeter.cpp"
 
 #include "ReadWrite/foleys_AVFormatManager.cpp"
 #include "ReadWrite/foleys_ClipRenderer.cpp"
+#include "ReadWrite/foleys_RenderQueue.cpp"
 
 #if FOLEYS_USE_FFMPEG
 #include "ReadWrite/FFmpeg/foleys_FFmpegReader.cpp"
@@ -53,5 +62,8 @@
 
 #include "Widgets/foleys_SoftwareView.cpp"
 #include "Widgets/foleys_FilmStrip.cpp"
+#include "Widgets/foleys_WaveformPeaks.cpp"
 #include "Widgets/foleys_AudioStrip.cpp"
 #include "Widgets/foleys_OpenGLView.cpp"
+
+#include "Basics/foleys_BenchmarkRunner.cpp"
@@ -76,6 +76,23 @@
 #define FOLEYS_DEBUG_LOGGING 0
 #endif
 
+/** Config: FOLEYS_ENABLE_PROFILING
+    Set this flag to measure the time spent in each stage of reading, processing
+    and writing. The counters are lock-free and cheap enough to stay enabled in
+    release builds. See PerformanceMonitor.
+ */
+#ifndef FOLEYS_ENABLE_PROFILING
+#define FOLEYS_ENABLE_PROFILING 1
+#endif
+
+/** Config: FOLEYS_ENABLE_BENCHMARKS
+    Set this flag to compile the BenchmarkRunner, that measures the throughput
+    of decoding, compositing, mixing and encoding with synthetic media.
+ */
+#ifndef FOLEYS_ENABLE_BENCHMARKS
+#define FOLEYS_ENABLE_BENCHMARKS 0
+#endif
+
 #define FOLEYS_ENGINE_VERSION "0.2.0"
 
 // foleys_video_addons is a proprietory module containing
@@ -109,9 +126,13 @@
 
 #include "Basics/foleys_Structures.h"
 #include "Basics/foleys_Usage.h"
+#include "Basics/foleys_VectorMath.h"
+#include "Basics/foleys_PerformanceCounters.h"
 #include "Basics/foleys_VideoFrame.h"
 #include "Basics/foleys_TimeCodeAware.h"
 #include "Basics/foleys_AudioFifo.h"
+#include "Basics/foleys_Resampler.h"
+#include "Basics/foleys_TimeStretcher.h"
 #include "Basics/foleys_VideoFifo.h"
 #include "Processing/foleys_ProcessorParameter.h"
 #include "Plugins/foleys_AudioPluginManager.h"
@@ -120,12 +141,15 @@
 #include "Processing/foleys_ControllableBase.h"
 #include "Processing/foleys_ProcessorController.h"
 #include "Processing/foleys_ParameterAutomation.h"
+#include "Processing/foleys_LoudnessMeter.h"
 #include "Clips/foleys_AVClip.h"
 #include "Clips/foleys_ClipDescriptor.h"
+#include "Clips/foleys_AudioFreezer.h"
 #include "ReadWrite/foleys_AVReader.h"
 #include "ReadWrite/foleys_AVWriter.h"
 #include "ReadWrite/foleys_AVFormatManager.h"
 #include "ReadWrite/foleys_ClipRenderer.h"
+#include "ReadWrite/foleys_RenderQueue.h"
 #include "Processing/foleys_AudioMixer.h"
 #include "Processing/foleys_VideoMixer.h"
 #include "Processing/foleys_DefaultAudioMixer.h"
@@ -136,10 +160,13 @@
 #include "Clips/foleys_MovieClip.h"
 #include "Clips/foleys_ComposedClip.h"
 
+#include "Basics/foleys_BufferingManager.h"
+#include "Basics/foleys_ReaderScheduler.h"
 #include "Basics/foleys_VideoEngine.h"
 #include "Widgets/foleys_VideoView.h"
 #include "Widgets/foleys_SoftwareView.h"
 #include "Widgets/foleys_FilmStrip.h"
+#include "Widgets/foleys_WaveformPeaks.h"
 #include "Widgets/foleys_AudioStrip.h"
 #include "Widgets/foleys_OpenGLDraw.h"
 #include "Widgets/foleys_OpenGLView.h"
@@ -151,3 +178,5 @@
 #endif
 
 #include "Plugins/foleys_ColourCurveVideoProcessor.h"
+
+#include "Basics/foleys_BenchmarkRunner.h"